@@ -0,0 +1,492 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Host-side stand-in for the Particle Device OS headers.
+//  It provides just enough of the firmware API (pins, time, cloud, String) for
+//   src/homeCommander.ino to compile unmodified on Linux against a virtual clock.
+//  Simulation controls (pin levels, clock, publish log) live in sim.h
+
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+/*******************************************************************************
+ pins
+*******************************************************************************/
+typedef uint16_t pin_t;
+typedef uint32_t system_tick_t;
+
+enum PinMode
+{
+  INPUT,
+  OUTPUT,
+  INPUT_PULLUP,
+  INPUT_PULLDOWN,
+};
+
+#define HIGH 1
+#define LOW 0
+
+const pin_t D0 = 0;
+const pin_t D1 = 1;
+const pin_t D2 = 2;
+const pin_t D3 = 3;
+const pin_t D4 = 4;
+const pin_t D5 = 5;
+const pin_t D6 = 6;
+const pin_t D7 = 7;
+const pin_t A0 = 10;
+const pin_t A1 = 11;
+const pin_t A2 = 12;
+const pin_t A3 = 13;
+const pin_t A4 = 14;
+const pin_t A5 = 15;
+const pin_t A6 = 16;
+const pin_t A7 = 17;
+#define TOTAL_PINS 24
+
+#define arraySize(a) (sizeof(a) / sizeof(*(a)))
+
+void pinMode(pin_t pin, PinMode mode);
+void digitalWrite(pin_t pin, uint8_t value);
+int32_t digitalRead(pin_t pin);
+int32_t analogRead(pin_t pin);
+
+/*******************************************************************************
+ interrupts: handlers run synchronously when sim::setDigital() produces a matching edge
+*******************************************************************************/
+enum InterruptMode
+{
+  CHANGE,
+  RISING,
+  FALLING,
+};
+
+typedef void (*raw_interrupt_handler_t)(void);
+
+bool attachInterrupt(pin_t pin, raw_interrupt_handler_t handler, InterruptMode mode);
+void detachInterrupt(pin_t pin);
+void noInterrupts();
+void interrupts();
+
+#define ATOMIC_BLOCK() for (bool __atomic_once = (noInterrupts(), true); __atomic_once; __atomic_once = (interrupts(), false))
+
+/*******************************************************************************
+ time
+*******************************************************************************/
+system_tick_t millis();
+system_tick_t micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/*******************************************************************************
+ software timers: on Device OS they run in the timer thread,
+  on the host they fire while the virtual clock moves (sim::advanceMicros(), delay())
+*******************************************************************************/
+class Timer
+{
+public:
+  typedef void (*timer_callback_fn)(void);
+
+  Timer(unsigned period, timer_callback_fn callback, bool one_shot = false);
+  ~Timer();
+
+  bool start();
+  bool stop();
+  bool reset() { return start(); }
+  bool changePeriod(unsigned period);
+  bool isActive() const { return active; }
+
+  // called by the simulation when the virtual clock reaches dueMicros
+  void fire();
+  uint64_t due() const { return dueMicros; }
+
+private:
+  unsigned periodMillis;
+  timer_callback_fn callback;
+  bool oneShot;
+  bool active;
+  uint64_t dueMicros;
+};
+
+/*******************************************************************************
+ threads: on Device OS the scheduler preempts a thread for one of higher priority.
+  On the host they are coroutines that run one at a time, in lock step with the virtual clock:
+  sim::runThreads() lets every thread whose delay() is over run until its next delay(), so a run
+  of the simulation is the same every time. Their delay() waits for the clock, it does not move it
+*******************************************************************************/
+typedef void (*os_thread_fn_t)(void *param);
+typedef uint8_t os_thread_prio_t;
+#define OS_THREAD_PRIORITY_DEFAULT 2
+#define OS_THREAD_STACK_SIZE_DEFAULT 3072
+
+class Thread
+{
+public:
+  Thread(const char *name, os_thread_fn_t function, void *function_param = nullptr,
+         os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT, size_t stack_size = OS_THREAD_STACK_SIZE_DEFAULT);
+};
+
+// no thread switch inside the block, only one thread runs at a time on the host anyway
+#define SINGLE_THREADED_BLOCK()
+
+/*******************************************************************************
+ String (Wiring compatible subset)
+  like the Wiring String, the characters live in a heap buffer that grows on demand
+  so every String built or grown by the firmware shows up in sim::allocationCount()
+*******************************************************************************/
+class String
+{
+public:
+  String() : buffer(nullptr), capacity(0), len(0) {}
+  String(const char *cstr);
+  String(const String &other);
+  String(String &&other);
+  explicit String(char c);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(float value, int decimalPlaces = 2);
+  explicit String(double value, int decimalPlaces = 2);
+  ~String();
+
+  String &operator=(const String &rhs);
+  String &operator=(String &&rhs);
+  String &operator=(const char *cstr);
+  String &operator+=(const String &rhs) { return concat(rhs.c_str(), rhs.len); }
+  String &operator+=(const char *cstr) { return concat(cstr, cstr ? strlen(cstr) : 0); }
+  String &operator+=(char c) { return concat(&c, 1); }
+
+  bool equals(const String &rhs) const { return len == rhs.len and strcmp(c_str(), rhs.c_str()) == 0; }
+  bool equals(const char *cstr) const { return strcmp(c_str(), cstr ? cstr : "") == 0; }
+  bool operator==(const String &rhs) const { return equals(rhs); }
+  bool operator==(const char *cstr) const { return equals(cstr); }
+  bool operator!=(const String &rhs) const { return !equals(rhs); }
+  bool operator!=(const char *cstr) const { return !equals(cstr); }
+
+  const char *c_str() const { return buffer ? buffer : ""; }
+  unsigned int length() const { return len; }
+  char operator[](unsigned int index) const { return index < len ? buffer[index] : 0; }
+  long toInt() const { return atol(c_str()); }
+  float toFloat() const { return atof(c_str()); }
+
+  friend String operator+(const String &lhs, const String &rhs);
+  friend String operator+(const String &lhs, const char *rhs);
+  friend String operator+(const char *lhs, const String &rhs);
+
+private:
+  bool reserve(unsigned int size);
+  String &copy(const char *cstr, unsigned int length);
+  String &concat(const char *cstr, unsigned int length);
+
+  char *buffer;
+  unsigned int capacity;
+  unsigned int len;
+};
+
+/*******************************************************************************
+ cloud
+*******************************************************************************/
+enum PublishFlag
+{
+  PUBLIC,
+  PRIVATE,
+  NO_ACK,
+  WITH_ACK,
+};
+
+enum CloudVariableType
+{
+  BOOLEAN = 1,
+  INT = 2,
+  STRING = 4,
+  DOUBLE = 9,
+};
+
+typedef int (*user_function_int_str_t)(String);
+typedef String (*user_variable_string_fn_t)();
+
+class CloudClass
+{
+public:
+  bool publish(const char *eventName, const char *eventData, int ttl, PublishFlag flag);
+  bool publish(const char *eventName, const String &eventData, int ttl, PublishFlag flag)
+  {
+    return publish(eventName, eventData.c_str(), ttl, flag);
+  }
+  bool publish(const String &eventName, const String &eventData, int ttl, PublishFlag flag)
+  {
+    return publish(eventName.c_str(), eventData.c_str(), ttl, flag);
+  }
+
+  bool variable(const char *name, const char *var, CloudVariableType type = STRING);
+  bool variable(const char *name, const String &var);
+  bool variable(const char *name, const int &var);
+  bool variable(const char *name, const double &var);
+  bool variable(const char *name, user_variable_string_fn_t fn);
+
+  bool function(const char *name, user_function_int_str_t fn);
+
+  bool connected();
+  void connect();
+  void disconnect();
+  void process() {}
+};
+
+extern CloudClass Particle;
+
+// wifi: always up on the host, the cloud connection is what the simulation plays with
+class WiFiClass
+{
+public:
+  bool ready() { return true; }
+};
+
+extern WiFiClass WiFi;
+
+/*******************************************************************************
+ TCP (Wiring compatible subset): real sockets, the server listens on 127.0.0.1 only
+  reads never block, copies of a TCPClient share its socket like on Device OS
+*******************************************************************************/
+class TCPClient
+{
+public:
+  TCPClient() : sock(-1) {}
+  explicit TCPClient(int sock) : sock(sock) {}
+
+  uint8_t connected();
+  int available();
+  int read();
+  int read(uint8_t *buffer, size_t size);
+  size_t write(uint8_t b) { return write(&b, 1); }
+  size_t write(const uint8_t *buffer, size_t size);
+  void stop();
+  explicit operator bool() { return connected(); }
+
+private:
+  int sock;
+};
+
+class TCPServer
+{
+public:
+  TCPServer(uint16_t port) : port(port), sock(-1) {}
+  ~TCPServer() { stop(); }
+
+  bool begin();
+  // a client that just connected, or one that is not connected
+  TCPClient available();
+  void stop();
+
+private:
+  uint16_t port;
+  int sock;
+};
+
+/*******************************************************************************
+ retained variables keep their value across a reset on the device, on the host they are plain globals
+*******************************************************************************/
+#define retained
+
+/*******************************************************************************
+ system
+*******************************************************************************/
+enum class SystemSleepMode
+{
+  NONE,
+  STOP,
+  ULTRA_LOW_POWER,
+  HIBERNATE,
+};
+
+enum class SystemSleepNetworkFlag
+{
+  NONE,
+  INACTIVE_STANDBY,
+};
+
+typedef int network_interface_t;
+#define NETWORK_INTERFACE_WIFI_STA 4
+#define SYSTEM_SLEEP_MAX_PINS 8
+
+// what System.sleep() gets, the simulation reads it back (sim::takeSleepRequest())
+class SystemSleepConfiguration
+{
+public:
+  SystemSleepConfiguration &mode(SystemSleepMode mode)
+  {
+    sleepMode = mode;
+    return *this;
+  }
+  SystemSleepConfiguration &duration(system_tick_t ms)
+  {
+    durationMillis = ms;
+    return *this;
+  }
+  SystemSleepConfiguration &gpio(pin_t pin, InterruptMode)
+  {
+    if (pinCount < SYSTEM_SLEEP_MAX_PINS)
+    {
+      pins[pinCount++] = pin;
+    }
+    return *this;
+  }
+  SystemSleepConfiguration &network(network_interface_t, SystemSleepNetworkFlag flag = SystemSleepNetworkFlag::NONE)
+  {
+    networkStandby = flag == SystemSleepNetworkFlag::INACTIVE_STANDBY;
+    return *this;
+  }
+
+  SystemSleepMode sleepMode = SystemSleepMode::NONE;
+  system_tick_t durationMillis = 0;
+  pin_t pins[SYSTEM_SLEEP_MAX_PINS];
+  uint8_t pinCount = 0;
+  bool networkStandby = false;
+};
+
+class SystemSleepResult
+{
+};
+
+enum HAL_Feature
+{
+  FEATURE_RETAINED_MEMORY,
+};
+
+// system events, only the firmware update ones
+typedef uint64_t system_event_t;
+#define firmware_update 0x20ULL
+#define firmware_update_begin 0
+#define firmware_update_complete 1
+#define firmware_update_failed -1
+typedef void (*system_event_handler_t)(system_event_t event, int param);
+
+// code that runs before the constructors of the globals on the device, nothing to do on the host
+#define STARTUP(code)
+
+// AUTOMATIC: the system connects to the cloud at boot, SEMI_AUTOMATIC: when the firmware calls
+//  Particle.connect(). Without the system thread, setup() and loop() wait for the connection.
+//  The simulation reads both back (sim::systemMode(), sim::systemThread())
+enum System_Mode_TypeDef
+{
+  AUTOMATIC,
+  SEMI_AUTOMATIC,
+  MANUAL,
+};
+
+enum SystemThreadState
+{
+  DISABLED,
+  ENABLED,
+};
+
+struct SystemModeSetting
+{
+  explicit SystemModeSetting(System_Mode_TypeDef mode);
+};
+
+struct SystemThreadSetting
+{
+  explicit SystemThreadSetting(SystemThreadState state);
+};
+
+#define SYSTEM_MODE(mode) SystemModeSetting systemModeSetting(mode)
+#define SYSTEM_THREAD(state) SystemThreadSetting systemThreadSetting(state)
+
+class SystemClass
+{
+public:
+  bool enableFeature(HAL_Feature) { return true; }
+  // the handler is kept, sim::systemEvent() raises the event
+  bool on(system_event_t events, system_event_handler_t handler);
+
+  // the simulation keeps the request and moves the clock itself, see sim::takeSleepRequest()
+  SystemSleepResult sleep(const SystemSleepConfiguration &config);
+
+  // cycle counter: on the host one tick is one nanosecond of virtual time (delay(), blocking reads)
+  //  plus one nanosecond of real time spent running the firmware
+  uint32_t ticks();
+  uint32_t ticksPerMicrosecond() { return 1000; }
+};
+
+extern SystemClass System;
+
+// hardware random number generator of the STM32
+uint32_t HAL_RNG_GetRandomNumber(void);
+
+/*******************************************************************************
+ emulated EEPROM, all 0xFF at start unless the simulation loads an image (sim::loadEeprom())
+*******************************************************************************/
+#define EEPROM_SIZE 2047
+
+class EEPROMClass
+{
+public:
+  uint8_t read(int address) const;
+  void write(int address, uint8_t value);
+  size_t length() const { return EEPROM_SIZE; }
+
+  template <typename T>
+  T &get(int address, T &value) const
+  {
+    uint8_t *bytes = (uint8_t *)&value;
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+      bytes[i] = read(address + i);
+    }
+    return value;
+  }
+
+  template <typename T>
+  const T &put(int address, const T &value)
+  {
+    const uint8_t *bytes = (const uint8_t *)&value;
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+      write(address + i, bytes[i]);
+    }
+    return value;
+  }
+};
+
+extern EEPROMClass EEPROM;
+
+/*******************************************************************************
+ USB serial, written to stdout
+*******************************************************************************/
+class USBSerial
+{
+public:
+  void begin(long) {}
+  size_t println(const char *text);
+};
+
+extern USBSerial Serial;
+
+/*******************************************************************************
+ wall clock
+*******************************************************************************/
+class TimeClass
+{
+public:
+  void zone(float offsetHours);
+  time_t now();
+  time_t local();
+  int hour();
+  int minute();
+  int second();
+  String format(time_t t, const char *formatSpec);
+  String timeStr();
+  bool isValid() { return true; }
+};
+
+extern TimeClass Time;
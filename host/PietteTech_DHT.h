@@ -0,0 +1,62 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Host-side stand-in for the PietteTech_DHT library.
+//  An acquisition completes sim::dhtAcquireMicros() after it was started and returns
+//   whatever sim::setDht() was last given (rounded to tenths, like the sensor) or queued with sim::queueDht(),
+//   so blocking and non-blocking use behave like the real sensor.
+//  Failures come from sim::queueDhtError() and sim::setDhtErrors(): a failed acquisition completes with
+//   the error status, one where the sensor does not answer stays acquiring until acquire() is called again.
+//  What an acquisition returns is decided when it completes, that is when it shows up in a trace.
+
+#pragma once
+
+#include "Particle.h"
+
+#define DHTLIB_OK 1
+#define DHTLIB_ERROR_CHECKSUM -1
+#define DHTLIB_ERROR_ISR_TIMEOUT -2
+#define DHTLIB_ERROR_RESPONSE_TIMEOUT -3
+#define DHTLIB_ERROR_DATA_TIMEOUT -4
+#define DHTLIB_ERROR_ACQUIRING -5
+#define DHTLIB_ERROR_DELTA -6
+#define DHTLIB_ERROR_NOTSTARTED -7
+
+#define DHT11 11
+#define DHT21 21
+#define AM2301 21
+#define DHT22 22
+#define AM2302 22
+
+class PietteTech_DHT
+{
+public:
+  PietteTech_DHT(uint8_t sigPin, uint8_t dht_type, void (*isrCallback_wrapper)());
+  void begin();
+  void isrCallback();
+  int acquire();
+  int acquireAndWait(uint32_t timeout = 0);
+  float getCelsius();
+  float getFahrenheit();
+  float getKelvin();
+  double getDewPoint();
+  float getHumidity();
+  bool acquiring();
+  int getStatus();
+
+private:
+  void update();
+
+  uint8_t _sigPin;
+  uint8_t _type;
+  void (*isrCallback_wrapper)();
+  bool _acquiring;
+  // the sensor did not answer, acquiring until the next acquire()
+  bool _hung;
+  uint64_t _acquireDoneMicros;
+  int _status;
+  float _celsius;
+  float _humidity;
+};
@@ -0,0 +1,505 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Host benchmark of the dryer cycle detection: the fixed thresholds dryer_status() used
+//   (start: humidity > 50 and temp > 30, end: 5 samples with humidity < 10 and temp > 50)
+//   against src/dryerDetector.h, both fed with DHT22 samples every 30 secs.
+//
+//  usage: dryerBench [--cycles N] [--seed S] [--set name=value]...
+//           replays N random dryer cycles (different loads, dryness floors, sensor or timed end) and
+//           a few days without the dryer (hot humid days, a shower next door, sun on the sensor),
+//           then prints start/end latency, false starts and the error of the time to dry
+//         dryerBench [--set name=value]... FILE.csv
+//           replays recorded samples, one "unix time,celsius,humidity" per line
+//           (what host/seriesDecode prints), and prints what both detectors saw
+//  --set changes a field of DryerDetectorConfig, e.g. --set drySamples=3 --set plateauSeconds=600
+
+#include "dryerDetector.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#define SAMPLE_SECONDS 30
+#define MAX_CYCLE_SECONDS 5940 // DRYER_MAX_TIMER of the firmware
+
+namespace
+{
+
+struct Sample
+{
+  uint32_t time;
+  float celsius;
+  float humidity;
+};
+
+// the thresholds of dryer_status() up to version 1.14
+class LegacyDetector
+{
+public:
+  DryerEvent update(uint32_t, float celsius, float humidity)
+  {
+    if (not on and humidity > 50 and celsius > 30)
+    {
+      on = true;
+      samplesBelow10 = 0;
+      return DRYER_EVENT_STARTED;
+    }
+    if (on and humidity < 10 and celsius > 50)
+    {
+      samplesBelow10++;
+    }
+    if (on and samplesBelow10 >= 5)
+    {
+      on = false;
+      return DRYER_EVENT_DRY;
+    }
+    return DRYER_EVENT_NONE;
+  }
+
+  void stop() { on = false; }
+  bool running() const { return on; }
+
+private:
+  bool on = false;
+  int samplesBelow10 = 0;
+};
+
+int16_t centi(float value) { return (int16_t)lroundf(value * 100); }
+
+// what the DHT22 reports: tenths, a little noise
+float dht22(float value, float noise)
+{
+  value += noise * ((rand() % 2001) - 1000) / 1000.0f;
+  return roundf(value * 10) / 10;
+}
+
+float uniform(float low, float high) { return low + (high - low) * (rand() % 10001) / 10000.0f; }
+
+struct Cycle
+{
+  std::vector<Sample> samples;
+  uint32_t heatStart; // the drum starts heating
+  uint32_t dry;       // the clothes are as dry as they will get
+  bool timed;         // stopped by its timer, maybe before that
+};
+
+// idle, then one cycle: heat up, humidity decays towards a floor that depends on the load,
+//  the dryer stops either with its moisture sensor shortly after the floor or on a timer, then cools down
+Cycle dryerCycle(uint32_t t0)
+{
+  Cycle cycle;
+  float ambientCelsius = uniform(15, 28);
+  float ambientHumidity = uniform(35, 65);
+  float peakHumidity = uniform(75, 90);
+  float floorHumidity = uniform(3, 14);
+  float peakCelsius = uniform(50, 65);
+  float heatUp = uniform(240, 420);
+  float drying = uniform(2400, 4800);
+  bool timed = rand() % 4 == 0;
+
+  // the humidity reaches floor + 1% at 80% of the drying time
+  float tau = 0.8f * drying / logf(peakHumidity - floorHumidity);
+  float dryLevel = std::max(10.0f, floorHumidity + 1);
+  float dryAfter = -tau * logf((dryLevel - floorHumidity) / (peakHumidity - floorHumidity));
+  float heating = timed ? drying : std::min(drying, dryAfter + 300);
+  float cooling = 1800;
+
+  uint32_t idle = 1800;
+  cycle.heatStart = t0 + idle;
+  cycle.timed = timed;
+  cycle.dry = cycle.heatStart + heatUp + std::min(dryAfter, heating);
+  float endCelsius = 0;
+  float endHumidity = 0;
+  uint32_t end = cycle.heatStart + heatUp + heating + cooling + 3600;
+  for (uint32_t t = t0; t < end; t += SAMPLE_SECONDS + rand() % 3 - 1)
+  {
+    float s = (float)t - cycle.heatStart;
+    float celsius = ambientCelsius;
+    float humidity = ambientHumidity;
+    if (s >= 0 and s < heatUp)
+    {
+      float k = s / heatUp;
+      celsius = ambientCelsius + k * (peakCelsius - 8 - ambientCelsius);
+      humidity = ambientHumidity + k * (peakHumidity - ambientHumidity);
+    }
+    else if (s >= heatUp and s < heatUp + heating)
+    {
+      float k = (s - heatUp) / drying;
+      celsius = peakCelsius - 8 + 8 * k;
+      humidity = floorHumidity + (peakHumidity - floorHumidity) * expf(-(s - heatUp) / tau);
+      endCelsius = celsius;
+      endHumidity = humidity;
+    }
+    else if (s >= heatUp + heating)
+    {
+      float k = std::min(1.0f, (s - heatUp - heating) / cooling);
+      celsius = endCelsius + k * (ambientCelsius - endCelsius);
+      humidity = endHumidity + k * (ambientHumidity - endHumidity);
+    }
+    cycle.samples.push_back({t, dht22(celsius, 0.1f), dht22(humidity, 0.3f)});
+  }
+  return cycle;
+}
+
+// half a day without the dryer running
+std::vector<Sample> noDryer(uint32_t t0, int kind)
+{
+  std::vector<Sample> samples;
+  for (uint32_t t = t0; t < t0 + 12 * 3600; t += SAMPLE_SECONDS)
+  {
+    float hours = (t - t0) / 3600.0f;
+    float celsius = 22;
+    float humidity = 45;
+    switch (kind)
+    {
+    case 0: // hot humid summer day in the laundry room
+      celsius = 33 + 3 * sinf(hours / 12 * 3.1416f);
+      humidity = 60 + 10 * sinf(hours / 4);
+      break;
+    case 1: // a shower next door every 3 hours: humidity up 4%/min for 8 minutes, a bit of heat
+    {
+      float minutes = fmodf(hours, 3) * 60;
+      float k = minutes < 8 ? minutes / 8 : std::max(0.0f, 1 - (minutes - 8) / 40);
+      celsius = 22 + 3 * k;
+      humidity = 50 + 32 * k;
+      break;
+    }
+    default: // morning sun on the sensor: 2 degrees/min for 5 minutes, humidity goes down
+    {
+      float minutes = fmodf(hours, 6) * 60;
+      float k = minutes < 5 ? minutes / 5 : std::max(0.0f, 1 - (minutes - 5) / 60);
+      celsius = 22 + 10 * k;
+      humidity = 45 - 10 * k;
+      break;
+    }
+    }
+    samples.push_back({t, dht22(celsius, 0.1f), dht22(humidity, 0.3f)});
+  }
+  return samples;
+}
+
+const char *noDryerNames[] = {"hot humid day", "shower next door", "sun on the sensor"};
+
+struct Stats
+{
+  std::vector<double> values;
+
+  void add(double value) { values.push_back(value); }
+  double mean() const
+  {
+    double sum = 0;
+    for (double value : values)
+    {
+      sum += value;
+    }
+    return values.empty() ? 0 : sum / values.size();
+  }
+  double percentile(double p)
+  {
+    if (values.empty())
+    {
+      return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p / 100 * values.size()))];
+  }
+};
+
+struct Result
+{
+  unsigned started = 0;
+  unsigned ended = 0;
+  unsigned early = 0;   // ended more than 5 minutes before the clothes were dry
+  unsigned timeout = 0; // only DRYER_MAX_TIMER ended it
+  Stats startLatency;   // seconds after the drum started heating
+  Stats endLatency;     // seconds after the clothes were dry
+};
+
+void report(const char *name, Result &result, unsigned cycles)
+{
+  printf("%-9s starts %3u/%u  latency mean %4.0fs p90 %4.0fs | ends %3u  latency mean %5.0fs p90 %5.0fs max %5.0fs"
+         "  early %u  max timer %u\n",
+         name, result.started, cycles, result.startLatency.mean(), result.startLatency.percentile(90), result.ended,
+         result.endLatency.mean(), result.endLatency.percentile(90), result.endLatency.percentile(100), result.early,
+         result.timeout);
+}
+
+bool setConfig(DryerDetectorConfig &config, const char *assignment)
+{
+  struct
+  {
+    const char *name;
+    void *field;
+    bool small;
+  } fields[] = {
+      {"startHumiditySlope", &config.startHumiditySlope, false},
+      {"startTemperatureSlope", &config.startTemperatureSlope, false},
+      {"dryHumidity", &config.dryHumidity, false},
+      {"dryTemperature", &config.dryTemperature, false},
+      {"plateauHumidity", &config.plateauHumidity, false},
+      {"plateauDrop", &config.plateauDrop, false},
+      {"stopTemperatureSlope", &config.stopTemperatureSlope, false},
+      {"drySamples", &config.drySamples, true},
+  };
+  const char *equals = strchr(assignment, '=');
+  if (equals == nullptr)
+  {
+    return false;
+  }
+  int value = atoi(equals + 1);
+  if (not strncmp(assignment, "minCycleSeconds", equals - assignment))
+  {
+    config.minCycleSeconds = value;
+    return true;
+  }
+  if (not strncmp(assignment, "plateauSeconds", equals - assignment))
+  {
+    config.plateauSeconds = value;
+    return true;
+  }
+  for (const auto &field : fields)
+  {
+    if (strlen(field.name) == (size_t)(equals - assignment) and not strncmp(assignment, field.name, equals - assignment))
+    {
+      if (field.small)
+      {
+        *(uint8_t *)field.field = value;
+      }
+      else
+      {
+        *(int16_t *)field.field = value;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+int simulate(unsigned cycles, const DryerDetectorConfig &config)
+{
+  Result legacy, streaming;
+  Stats etaError[3]; // minutes, at 25/50/75% of the drying
+  uint32_t t0 = 1700000000;
+
+  for (unsigned c = 0; c < cycles; c++)
+  {
+    Cycle cycle = dryerCycle(t0);
+    t0 = cycle.samples.back().time + SAMPLE_SECONDS;
+
+    LegacyDetector old;
+    DryerDetector detector;
+    detector.config = config;
+    bool oldStarted = false, oldEnded = false, newStarted = false, newEnded = false;
+    uint32_t oldStart = 0, newStart = 0;
+    bool etaChecked[3] = {false, false, false};
+
+    for (const Sample &sample : cycle.samples)
+    {
+      DryerEvent event = old.update(sample.time, sample.celsius, sample.humidity);
+      if (event == DRYER_EVENT_STARTED and not oldStarted)
+      {
+        oldStarted = true;
+        oldStart = sample.time;
+        legacy.started++;
+        legacy.startLatency.add((double)sample.time - cycle.heatStart);
+      }
+      else if (event == DRYER_EVENT_DRY and oldStarted and not oldEnded)
+      {
+        oldEnded = true;
+        legacy.ended++;
+        legacy.endLatency.add((double)sample.time - cycle.dry);
+        legacy.early += sample.time + 300 < cycle.dry;
+      }
+      if (old.running() and oldStarted and not oldEnded and sample.time - oldStart >= MAX_CYCLE_SECONDS)
+      {
+        old.stop();
+        oldEnded = true;
+        legacy.timeout++;
+      }
+
+      event = detector.update(sample.time, centi(sample.celsius), centi(sample.humidity));
+      if (event == DRYER_EVENT_STARTED and not newStarted)
+      {
+        newStarted = true;
+        newStart = sample.time;
+        streaming.started++;
+        streaming.startLatency.add((double)sample.time - cycle.heatStart);
+      }
+      else if ((event == DRYER_EVENT_DRY or event == DRYER_EVENT_STOPPED) and newStarted and not newEnded)
+      {
+        newEnded = true;
+        streaming.ended++;
+        streaming.endLatency.add((double)sample.time - cycle.dry);
+        streaming.early += sample.time + 300 < cycle.dry;
+      }
+      if (detector.running() and newStarted and not newEnded and sample.time - newStart >= MAX_CYCLE_SECONDS)
+      {
+        detector.setRunning(false, sample.time);
+        newEnded = true;
+        streaming.timeout++;
+      }
+
+      // how good the predicted time to dry is along the cycle, a timer can stop the dryer at any time
+      if (not cycle.timed and detector.running() and sample.time < cycle.dry)
+      {
+        double progress = (double)(sample.time - cycle.heatStart) / (cycle.dry - cycle.heatStart);
+        for (int q = 0; q < 3; q++)
+        {
+          if (not etaChecked[q] and progress >= 0.25 * (q + 1))
+          {
+            etaChecked[q] = true;
+            int32_t eta = detector.secondsToDry();
+            if (eta >= 0)
+            {
+              etaError[q].add(fabs((double)sample.time + eta - cycle.dry) / 60);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  printf("%u dryer cycles, samples every %d secs\n", cycles, SAMPLE_SECONDS);
+  report("legacy", legacy, cycles);
+  report("detector", streaming, cycles);
+  printf("time to dry error (cycles ended by the moisture sensor): ");
+  for (int q = 0; q < 3; q++)
+  {
+    printf("%s at %d%% mean %.1f min p90 %.1f min (%zu predictions)", q ? "," : "", 25 * (q + 1), etaError[q].mean(),
+           etaError[q].percentile(90), etaError[q].values.size());
+  }
+  printf("\n");
+
+  printf("false starts in 12 hours without the dryer:\n");
+  for (int kind = 0; kind < 3; kind++)
+  {
+    std::vector<Sample> samples = noDryer(t0, kind);
+    LegacyDetector old;
+    DryerDetector detector;
+    detector.config = config;
+    unsigned oldFalse = 0, newFalse = 0;
+    for (const Sample &sample : samples)
+    {
+      oldFalse += old.update(sample.time, sample.celsius, sample.humidity) == DRYER_EVENT_STARTED;
+      newFalse += detector.update(sample.time, centi(sample.celsius), centi(sample.humidity)) == DRYER_EVENT_STARTED;
+    }
+    printf("  %-18s legacy %3u  detector %3u\n", noDryerNames[kind], oldFalse, newFalse);
+  }
+  return 0;
+}
+
+const char *eventName(DryerEvent event)
+{
+  switch (event)
+  {
+  case DRYER_EVENT_STARTED:
+    return "started";
+  case DRYER_EVENT_DRY:
+    return "dry";
+  case DRYER_EVENT_STOPPED:
+    return "stopped";
+  default:
+    return "";
+  }
+}
+
+int replay(const char *path, const DryerDetectorConfig &config)
+{
+  FILE *file = fopen(path, "r");
+  if (file == nullptr)
+  {
+    perror(path);
+    return 2;
+  }
+  LegacyDetector old;
+  DryerDetector detector;
+  detector.config = config;
+  char line[256];
+  uint32_t first = 0;
+  uint32_t lastEta = 0;
+  unsigned long samples = 0;
+  while (fgets(line, sizeof(line), file))
+  {
+    unsigned long time;
+    float celsius, humidity;
+    if (sscanf(line, "%lu,%f,%f", &time, &celsius, &humidity) != 3)
+    {
+      continue;
+    }
+    if (samples++ == 0)
+    {
+      first = time;
+    }
+    DryerEvent oldEvent = old.update(time, celsius, humidity);
+    DryerEvent newEvent = detector.update(time, centi(celsius), centi(humidity));
+    if (oldEvent != DRYER_EVENT_NONE)
+    {
+      printf("%8.1f min  legacy    %s\n", (time - first) / 60.0, eventName(oldEvent));
+    }
+    if (newEvent != DRYER_EVENT_NONE)
+    {
+      printf("%8.1f min  detector  %s\n", (time - first) / 60.0, eventName(newEvent));
+    }
+    if (detector.running() and time - lastEta >= 600)
+    {
+      lastEta = time;
+      int32_t eta = detector.secondsToDry();
+      char prediction[16] = "?";
+      if (eta >= 0)
+      {
+        snprintf(prediction, sizeof(prediction), "%.0f min", eta / 60.0);
+      }
+      printf("%8.1f min  detector  %.2f C %.2f %% slope %+.2f %%/min, dry in %s\n", (time - first) / 60.0,
+             detector.temperature() / 100.0, detector.humidity() / 100.0, detector.humiditySlope() / 100.0, prediction);
+    }
+  }
+  fclose(file);
+  printf("%lu samples\n", samples);
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  unsigned cycles = 500;
+  unsigned seed = 1;
+  const char *csv = nullptr;
+  DryerDetectorConfig config;
+
+  for (int i = 1; i < argc; i++)
+  {
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--cycles") and hasValue)
+    {
+      cycles = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (!strcmp(argv[i], "--seed") and hasValue)
+    {
+      seed = strtoul(argv[++i], nullptr, 10);
+    }
+    else if (!strcmp(argv[i], "--set") and hasValue and setConfig(config, argv[i + 1]))
+    {
+      i++;
+    }
+    else if (argv[i][0] != '-' and csv == nullptr)
+    {
+      csv = argv[i];
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [--cycles N] [--seed S] [--set name=value]... [FILE.csv]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  srand(seed);
+  return csv ? replay(csv, config) : simulate(cycles, config);
+}
@@ -0,0 +1,93 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Host benchmark of src/fixedFormat against the sprintf calls the firmware used to format readings.
+//  Every value from -50.00 to 150.00 is formatted with:
+//    sprintf("%0d.%d")  what the firmware did (wrong for 20.05 and for -0.99..-0.01)
+//    snprintf("%.2f")   the correct output, used as the reference
+//    fixedFormat()      the replacement
+//
+//  usage: formatBench [rounds]   (default 200 sweeps)
+
+#include "fixedFormat.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+
+const int32_t firstCenti = -5000;
+const int32_t lastCenti = 15000;
+
+void oldFormat(char *buffer, size_t size, int32_t centi)
+{
+  (void)size;
+  sprintf(buffer, "%0d.%d", centi / 100, abs(centi % 100));
+}
+
+void printfFormat(char *buffer, size_t size, int32_t centi)
+{
+  snprintf(buffer, size, "%.2f", centi / 100.0);
+}
+
+void fixedFormatCenti(char *buffer, size_t size, int32_t centi)
+{
+  fixedFormat(buffer, size, centi, 2);
+}
+
+template <typename Format>
+double nanosPerValue(unsigned rounds, Format format)
+{
+  char buffer[32];
+  volatile char sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned round = 0; round < rounds; round++)
+  {
+    for (int32_t centi = firstCenti; centi <= lastCenti; centi++)
+    {
+      format(buffer, sizeof(buffer), centi);
+      sink = sink + buffer[0];
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return seconds * 1e9 / ((double)rounds * (lastCenti - firstCenti + 1));
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  unsigned rounds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200;
+
+  unsigned long values = 0, oldWrong = 0, fixedWrong = 0, floatWrong = 0;
+  char reference[32], old[32], fixed[32], fromFloat[32];
+  for (int32_t centi = firstCenti; centi <= lastCenti; centi++)
+  {
+    values++;
+    printfFormat(reference, sizeof(reference), centi);
+    oldFormat(old, sizeof(old), centi);
+    fixedFormatCenti(fixed, sizeof(fixed), centi);
+    fixedFormatFloat(fromFloat, sizeof(fromFloat), centi / 100.0f, 2);
+    oldWrong += strcmp(reference, old) != 0;
+    if (strcmp(reference, fixed) != 0)
+    {
+      fixedWrong++;
+      printf("fixedFormat(%d, 2) = %s, expected %s\n", (int)centi, fixed, reference);
+    }
+    floatWrong += strcmp(reference, fromFloat) != 0;
+  }
+
+  printf("values checked      : %lu (-50.00 to 150.00)\n", values);
+  printf("wrong outputs       : sprintf(\"%%0d.%%d\") %lu, fixedFormat %lu, fixedFormatFloat %lu\n", oldWrong, fixedWrong, floatWrong);
+  printf("sprintf(\"%%0d.%%d\")   : %.1f ns per value\n", nanosPerValue(rounds, oldFormat));
+  printf("snprintf(\"%%.2f\")    : %.1f ns per value\n", nanosPerValue(rounds, printfFormat));
+  printf("fixedFormat         : %.1f ns per value\n", nanosPerValue(rounds, fixedFormatCenti));
+
+  // checks fail the run, so the benchmark doubles as a sanity check of the formatter
+  return fixedWrong or floatWrong ? 1 : 0;
+}
@@ -0,0 +1,24 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Minimal Cortex-M3 program used by the formatSize target to compare the flash cost of
+//   formatting one reading with sprintf (build with -DUSE_SPRINTF) or with fixedFormat().
+
+#include "fixedFormat.h"
+
+#include <stdio.h>
+
+volatile int reading = 2005;
+char text[16];
+
+int main()
+{
+#ifdef USE_SPRINTF
+  sprintf(text, "%0d.%d", reading / 100, reading % 100);
+#else
+  fixedFormat(text, sizeof(text), reading, 2);
+#endif
+  return text[0];
+}
@@ -0,0 +1,64 @@
+# The MIT License (MIT)
+# Copyright (c) 2016 Gustavo Gonnet
+#
+#  github: https://github.com/gusgonnet/homeCommander
+#
+#  Turns the .ino into a compilable .cpp the same way the Particle preprocessor does:
+#   include Particle.h, then insert a prototype for every function defined in the file
+#   right after the first block of #includes, keeping #line directives pointing at the .ino.
+#
+#  usage: cmake -DINO=<file.ino> -DOUT=<file.cpp> -P ino2cpp.cmake
+
+if(NOT INO OR NOT OUT)
+  message(FATAL_ERROR "usage: cmake -DINO=<file.ino> -DOUT=<file.cpp> -P ino2cpp.cmake")
+endif()
+
+file(READ "${INO}" content)
+
+# function definitions: a signature starting on column 0 followed by a line with the opening brace
+set(signature "\n[A-Za-z_][A-Za-z0-9_:<>*& ]*[ *&][A-Za-z_][A-Za-z0-9_]*[ ]*\\([^;{}()\n]*\\)[ \t]*\n{")
+string(REGEX MATCHALL "${signature}" definitions "${content}")
+
+set(prototypes "")
+foreach(definition IN LISTS definitions)
+  string(REGEX REPLACE "^\n([^\n]*[^ \t\n])[ \t]*\n{$" "\\1" prototype "${definition}")
+  if(NOT prototype MATCHES "^(else|return|do|case)[ (]")
+    string(APPEND prototypes "${prototype};\n")
+  endif()
+endforeach()
+
+# insert the prototypes after the first block of #includes
+string(FIND "${content}" "\n#include" firstInclude)
+if(firstInclude EQUAL -1)
+  set(insertAt 0)
+else()
+  string(SUBSTRING "${content}" ${firstInclude} -1 fromInclude)
+  string(REGEX MATCH "^(\n#include[^\n]*)+\n+" includeBlock "${fromInclude}")
+  string(LENGTH "${includeBlock}" includeBlockLength)
+  math(EXPR insertAt "${firstInclude} + ${includeBlockLength}")
+endif()
+
+string(SUBSTRING "${content}" 0 ${insertAt} head)
+string(SUBSTRING "${content}" ${insertAt} -1 tail)
+string(REGEX MATCHALL "\n" headLines "${head}")
+list(LENGTH headLines headLineCount)
+math(EXPR tailLine "${headLineCount} + 1")
+
+set(generated "/******************************************************/\n")
+string(APPEND generated "//       THIS IS A GENERATED FILE - DO NOT EDIT       //\n")
+string(APPEND generated "/******************************************************/\n\n")
+string(APPEND generated "#include \"Particle.h\"\n")
+string(APPEND generated "#line 1 \"${INO}\"\n")
+string(APPEND generated "${head}")
+string(APPEND generated "${prototypes}")
+string(APPEND generated "#line ${tailLine} \"${INO}\"\n")
+string(APPEND generated "${tail}")
+
+# only touch the output when it changed so rebuilds stay incremental
+if(EXISTS "${OUT}")
+  file(READ "${OUT}" previous)
+  if(previous STREQUAL generated)
+    return()
+  endif()
+endif()
+file(WRITE "${OUT}" "${generated}")
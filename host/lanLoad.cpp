@@ -0,0 +1,308 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Load test of the LAN control server (src/lanControl.h) on the loopback interface.
+//  The server runs on the main thread in a pass loop, like loop() on the device. Clients connect
+//   from their own threads and send signed requests one after the other, timing every round trip.
+//  Handlers are stand-ins: garage_stat returns a number, status returns a json document the size of
+//   the firmware's one. With more clients than LAN_CONTROL_CLIENTS the extra ones get "ERR busy".
+//  Before the load, the protocol is checked: a wrong mac, a replayed seq and an unknown command.
+//
+//  usage: lanLoad [--port N] [--requests N]   (default 15050, 2000 per client)
+
+#include "Particle.h"
+#include "lanControl.h"
+#include "sipHash.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const char keyHex[] = "000102030405060708090a0b0c0d0e0f";
+const uint8_t key[SIP_HASH_KEY_SIZE] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+int garageStat(String argument) { return 2; }
+
+String status()
+{
+  return String("{\"garage\":\"closed\",\"pool\":24.99,\"temp\":22.00,\"hum\":45.00,\"dryer\":\"dryer_off\","
+                "\"eta\":-1,\"lowHum\":100.00,\"wet\":[]}");
+}
+
+const LanCommand commands[] = {
+    {"garage_stat", garageStat, nullptr},
+    {"status", nullptr, status},
+};
+
+// one connection to the server, blocking
+class Connection
+{
+public:
+  explicit Connection(uint16_t port) : seq(0)
+  {
+    sock = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(sock, (sockaddr *)&address, sizeof(address)) < 0)
+    {
+      ::close(sock);
+      sock = -1;
+    }
+  }
+  ~Connection()
+  {
+    if (sock >= 0)
+    {
+      ::close(sock);
+    }
+  }
+
+  // "hello <nonce>", false if the server said something else (busy)
+  bool hello()
+  {
+    std::string line;
+    if (not readLine(line) or line.compare(0, 6, "hello ") != 0)
+    {
+      return false;
+    }
+    nonce = line.substr(6);
+    return true;
+  }
+
+  // sends "<seq> <request> <mac>" and returns the answer, a wrong key makes a wrong mac
+  bool request(const std::string &request, std::string &answer, bool wrongKey = false, bool sameSeq = false)
+  {
+    if (not sameSeq)
+    {
+      seq++;
+    }
+    std::string body = std::to_string(seq) + " " + request;
+    std::string message = nonce + " " + body;
+    uint8_t signingKey[SIP_HASH_KEY_SIZE];
+    memcpy(signingKey, key, sizeof(signingKey));
+    signingKey[0] ^= wrongKey ? 1 : 0;
+    char mac[17];
+    snprintf(mac, sizeof(mac), "%016llx", (unsigned long long)sipHash24(signingKey, message.data(), message.size()));
+    std::string line = body + " " + mac + "\n";
+    if (send(sock, line.data(), line.size(), MSG_NOSIGNAL) != (ssize_t)line.size())
+    {
+      return false;
+    }
+    return readLine(answer);
+  }
+
+  // true once the server closed the connection
+  bool closedByServer()
+  {
+    char c;
+    return recv(sock, &c, 1, 0) == 0;
+  }
+
+private:
+  bool readLine(std::string &line)
+  {
+    line.clear();
+    while (true)
+    {
+      size_t end = pending.find('\n');
+      if (end != std::string::npos)
+      {
+        line = pending.substr(0, end);
+        pending.erase(0, end + 1);
+        return true;
+      }
+      char buffer[1024];
+      ssize_t received = recv(sock, buffer, sizeof(buffer), 0);
+      if (received <= 0)
+      {
+        return false;
+      }
+      pending.append(buffer, received);
+    }
+  }
+
+  int sock;
+  uint32_t seq;
+  std::string nonce;
+  std::string pending;
+};
+
+// the server loop publishes how many clients it has, the other threads only look at this
+std::atomic<unsigned> connectedClients(0);
+
+// the runs wait for the server to notice the clients of the last one are gone
+void waitForServer()
+{
+  while (connectedClients.load() > 0)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+bool check(const char *what, bool ok)
+{
+  printf("  %-34s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+bool checkProtocol(uint16_t port)
+{
+  bool ok = true;
+  std::string answer;
+
+  Connection good(port);
+  ok &= check("hello with a nonce", good.hello());
+  ok &= check("signed request answered", good.request("garage_stat", answer) and answer == "1 2");
+  ok &= check("variable answered", good.request("status", answer) and answer.compare(0, 3, "2 {") == 0);
+  ok &= check("replayed seq refused", good.request("garage_stat", answer, false, true) and answer == "2 ERR seq");
+  ok &= check("unknown command refused", good.request("open_sesame", answer) and answer == "3 ERR unknown");
+
+  Connection bad(port);
+  ok &= check("wrong key refused and closed",
+              bad.hello() and bad.request("garage_stat", answer, true) and answer == "ERR auth" and bad.closedByServer());
+  return ok;
+}
+
+struct Load
+{
+  std::vector<double> latencies;
+  unsigned long busy = 0;
+  unsigned long errors = 0;
+};
+
+void client(uint16_t port, unsigned long requests, const char *command, Load &load)
+{
+  Connection connection(port);
+  if (not connection.hello())
+  {
+    load.busy++;
+    return;
+  }
+  std::string answer;
+  load.latencies.reserve(requests);
+  for (unsigned long i = 0; i < requests; i++)
+  {
+    auto start = std::chrono::steady_clock::now();
+    if (not connection.request(command, answer) or answer.find("ERR") != std::string::npos)
+    {
+      load.errors++;
+      return;
+    }
+    load.latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+  }
+}
+
+void runLoad(uint16_t port, unsigned clients, unsigned long requests, const char *command)
+{
+  std::vector<Load> loads(clients);
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < clients; i++)
+  {
+    threads.emplace_back(client, port, requests, command, std::ref(loads[i]));
+  }
+  for (std::thread &thread : threads)
+  {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::vector<double> all;
+  unsigned long busy = 0;
+  unsigned long errors = 0;
+  for (const Load &load : loads)
+  {
+    all.insert(all.end(), load.latencies.begin(), load.latencies.end());
+    busy += load.busy;
+    errors += load.errors;
+  }
+  std::sort(all.begin(), all.end());
+  auto percentile = [&](double p) { return all.empty() ? 0.0 : all[(size_t)(p * (all.size() - 1))]; };
+  printf("%-12s %7u  %8.0f  %7.1f  %7.1f  %7.1f  %5lu  %6lu\n", command, clients, all.size() / seconds,
+         percentile(0.5), percentile(0.99), all.empty() ? 0.0 : all.back(), busy, errors);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  uint16_t port = 15050;
+  unsigned long requests = 2000;
+  for (int i = 1; i < argc; i++)
+  {
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--port") and hasValue)
+    {
+      port = atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--requests") and hasValue)
+    {
+      requests = strtoul(argv[++i], nullptr, 10);
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [--port N] [--requests N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  LanControl lan(port, commands, arraySize(commands));
+  lan.begin(keyHex);
+  lan.process();
+  if (not lan.listening())
+  {
+    fprintf(stderr, "cannot listen on 127.0.0.1:%u\n", port);
+    return 2;
+  }
+
+  std::atomic<bool> done(false);
+  bool ok = true;
+  std::thread driver([&]() {
+    printf("protocol:\n");
+    ok = checkProtocol(port);
+    waitForServer();
+
+    printf("\n%lu requests per client, round trip in microseconds\n", requests);
+    printf("command      clients     req/s      p50      p99      max   busy  errors\n");
+    for (const char *command : {"garage_stat", "status"})
+    {
+      for (unsigned clients : {1, 2, 4, LAN_CONTROL_CLIENTS * 2})
+      {
+        runLoad(port, clients, requests, command);
+        waitForServer();
+      }
+    }
+    done = true;
+  });
+
+  // the server runs here, in a pass loop like loop() on the device
+  while (not done.load(std::memory_order_relaxed))
+  {
+    lan.process();
+    connectedClients.store(lan.clients(), std::memory_order_relaxed);
+  }
+  driver.join();
+
+  printf("\nserved %lu requests, refused %lu\n", lan.requests(), lan.refused());
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,1133 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Implementation of the host-side Particle stand-in (see Particle.h and sim.h)
+
+#include "Particle.h"
+#include "PietteTech_DHT.h"
+#include "sim.h"
+
+#include <chrono>
+#include <deque>
+#include <math.h>
+#include <new>
+#include <random>
+#include <time.h>
+#include <ucontext.h>
+#include <vector>
+
+CloudClass Particle;
+WiFiClass WiFi;
+SystemClass System;
+EEPROMClass EEPROM;
+TimeClass Time;
+USBSerial Serial;
+
+namespace
+{
+
+uint64_t clockMicros = 0;
+time_t epochAtZero = 1700000000;
+float timeZoneHours = 0;
+
+int pinLevel[TOTAL_PINS];
+int pinAnalog[TOTAL_PINS];
+int pinAnalogNoise[TOTAL_PINS];
+uint32_t noiseState = 2463534242u;
+PinMode pinModes[TOTAL_PINS];
+raw_interrupt_handler_t pinHandler[TOTAL_PINS];
+InterruptMode pinInterruptMode[TOTAL_PINS];
+int interruptsDisabled = 0;
+bool pinWasRead[TOTAL_PINS];
+uint64_t pinFirstRead[TOTAL_PINS];
+
+float dhtCelsius = 20.0;
+float dhtHumidity = 40.0;
+uint32_t dhtMicros = 4000;
+// every dhtErrorEvery-th acquisition fails, a bad checksum and a sensor that never answers in turns
+unsigned dhtErrorEvery = 0;
+unsigned long dhtAcquisitions = 0;
+
+// replayed readings, they go before the levels above until they run out
+std::deque<int> analogQueue[TOTAL_PINS];
+struct DhtReading
+{
+  float celsius;
+  float humidity;
+  int status;
+};
+std::deque<DhtReading> dhtQueue;
+sim::InputHook inputHook = nullptr;
+
+// the system connects from boot (AUTOMATIC) or from Particle.connect(), connectDelayMicros later
+System_Mode_TypeDef systemModeSetting = AUTOMATIC;
+bool systemThreadSetting = false;
+bool cloudConnected = false;
+bool connecting = true;
+uint64_t connectStartMicros = 0;
+uint64_t connectDelayMicros = 0;
+unsigned long published = 0;
+unsigned long rateLimited = 0;
+sim::PublishHook publishHook = nullptr;
+
+uint8_t eepromBytes[EEPROM_SIZE];
+bool eepromErased = false;
+unsigned long eepromWrites = 0;
+
+struct SystemEventHandler
+{
+  system_event_t events;
+  system_event_handler_t handler;
+};
+std::vector<SystemEventHandler> systemEventHandlers;
+
+bool sleepRequested = false;
+SystemSleepConfiguration sleepRequest;
+
+bool countingAllocations = false;
+unsigned long allocations = 0;
+
+enum VariableKind
+{
+  VAR_CHARS,
+  VAR_STRING,
+  VAR_INT,
+  VAR_DOUBLE,
+  VAR_FUNCTION,
+};
+
+struct Variable
+{
+  std::string name;
+  VariableKind kind;
+  const void *ptr;
+};
+
+struct Function
+{
+  std::string name;
+  user_function_int_str_t fn;
+};
+
+std::vector<Variable> &variables()
+{
+  static std::vector<Variable> v;
+  return v;
+}
+
+std::vector<Function> &functions()
+{
+  static std::vector<Function> f;
+  return f;
+}
+
+std::vector<Timer *> &timers()
+{
+  static std::vector<Timer *> t;
+  return t;
+}
+
+// moves the virtual clock, firing every timer that comes due on the way in order
+void advanceClockTo(uint64_t target)
+{
+  while (true)
+  {
+    Timer *next = nullptr;
+    for (Timer *timer : timers())
+    {
+      if (timer->isActive() and timer->due() <= target and (next == nullptr or timer->due() < next->due()))
+      {
+        next = timer;
+      }
+    }
+    if (next == nullptr)
+    {
+      break;
+    }
+    if (next->due() > clockMicros)
+    {
+      clockMicros = next->due();
+    }
+    next->fire();
+  }
+  clockMicros = target;
+}
+
+// xorshift32, so runs are repeatable
+uint32_t noiseNext()
+{
+  noiseState ^= noiseState << 13;
+  noiseState ^= noiseState >> 17;
+  noiseState ^= noiseState << 5;
+  return noiseState;
+}
+
+bool validPin(pin_t pin) { return pin < TOTAL_PINS; }
+
+// the firmware threads are coroutines: the main thread switches to one in sim::runThreads() and the
+//  thread switches back in delay(), so only one of them runs at any time and always in the same order
+#define SIM_THREAD_STACK (256 * 1024)
+struct SimThread
+{
+  ucontext_t context;
+  uint64_t wakeMicros;
+  os_thread_fn_t function;
+  void *param;
+};
+std::vector<SimThread *> simThreads;
+ucontext_t mainContext;
+SimThread *currentThread = nullptr;
+
+void threadStart()
+{
+  currentThread->function(currentThread->param);
+  // a Device OS thread never returns from its function, this one is over: back to the main thread
+  currentThread->wakeMicros = UINT64_MAX;
+}
+
+// delay() of a firmware thread: back to the main thread until the clock gets there
+void threadDelay(uint64_t micros)
+{
+  SimThread *thread = currentThread;
+  thread->wakeMicros = clockMicros + micros;
+  currentThread = nullptr;
+  swapcontext(&thread->context, &mainContext);
+}
+
+bool registerVariable(const char *name, VariableKind kind, const void *ptr)
+{
+  // Device OS: up to 12 characters per name (64 in newer versions, keep the old limit to stay portable)
+  if (strlen(name) > 12)
+  {
+    return false;
+  }
+  variables().push_back(Variable{name, kind, ptr});
+  return true;
+}
+
+} // namespace
+
+/*******************************************************************************
+ pins
+*******************************************************************************/
+void pinMode(pin_t pin, PinMode mode)
+{
+  if (!validPin(pin))
+  {
+    return;
+  }
+  pinModes[pin] = mode;
+}
+
+void digitalWrite(pin_t pin, uint8_t value)
+{
+  if (!validPin(pin))
+  {
+    return;
+  }
+  pinLevel[pin] = value ? HIGH : LOW;
+}
+
+int32_t digitalRead(pin_t pin)
+{
+  if (!validPin(pin))
+  {
+    return LOW;
+  }
+  if (!pinWasRead[pin])
+  {
+    pinWasRead[pin] = true;
+    pinFirstRead[pin] = clockMicros;
+  }
+  return pinLevel[pin];
+}
+
+int32_t analogRead(pin_t pin)
+{
+  if (!validPin(pin))
+  {
+    return 0;
+  }
+  int value = pinAnalog[pin];
+  int amplitude = pinAnalogNoise[pin];
+  if (not analogQueue[pin].empty())
+  {
+    value = analogQueue[pin].front();
+    analogQueue[pin].pop_front();
+    amplitude = 0;
+  }
+  if (amplitude > 0)
+  {
+    uint32_t r = noiseNext();
+    // one reading in 50 is a spike to either rail, the rest are off by up to +-amplitude
+    if (r % 50 == 0)
+    {
+      value = (r & 0x100) ? 4095 : 0;
+    }
+    else
+    {
+      value += (int)((r >> 8) % (2 * amplitude + 1)) - amplitude;
+    }
+  }
+  value = value < 0 ? 0 : (value > 4095 ? 4095 : value);
+  if (inputHook)
+  {
+    inputHook(clockMicros, 'a', pin, value, 0);
+  }
+  return value;
+}
+
+/*******************************************************************************
+ interrupts
+*******************************************************************************/
+bool attachInterrupt(pin_t pin, raw_interrupt_handler_t handler, InterruptMode mode)
+{
+  if (!validPin(pin))
+  {
+    return false;
+  }
+  pinHandler[pin] = handler;
+  pinInterruptMode[pin] = mode;
+  return true;
+}
+
+void detachInterrupt(pin_t pin)
+{
+  if (validPin(pin))
+  {
+    pinHandler[pin] = nullptr;
+  }
+}
+
+void noInterrupts() { interruptsDisabled++; }
+void interrupts() { interruptsDisabled--; }
+
+/*******************************************************************************
+ time
+*******************************************************************************/
+system_tick_t millis() { return (system_tick_t)(clockMicros / 1000); }
+system_tick_t micros() { return (system_tick_t)clockMicros; }
+void delay(unsigned long ms)
+{
+  if (currentThread)
+  {
+    threadDelay((uint64_t)ms * 1000);
+    return;
+  }
+  advanceClockTo(clockMicros + (uint64_t)ms * 1000);
+}
+void delayMicroseconds(unsigned int us) { advanceClockTo(clockMicros + us); }
+
+/*******************************************************************************
+ threads
+*******************************************************************************/
+Thread::Thread(const char *name, os_thread_fn_t function, void *function_param, os_thread_prio_t priority,
+               size_t stack_size)
+{
+  // it runs for the first time at the next sim::runThreads()
+  SimThread *thread = new SimThread();
+  thread->wakeMicros = clockMicros;
+  thread->function = function;
+  thread->param = function_param;
+  getcontext(&thread->context);
+  thread->context.uc_stack.ss_sp = new char[SIM_THREAD_STACK];
+  thread->context.uc_stack.ss_size = SIM_THREAD_STACK;
+  thread->context.uc_link = &mainContext;
+  makecontext(&thread->context, threadStart, 0);
+  simThreads.push_back(thread);
+}
+
+/*******************************************************************************
+ software timers
+*******************************************************************************/
+Timer::Timer(unsigned period, timer_callback_fn callback, bool one_shot)
+    : periodMillis(period), callback(callback), oneShot(one_shot), active(false), dueMicros(0)
+{
+  timers().push_back(this);
+}
+
+Timer::~Timer()
+{
+  std::vector<Timer *> &all = timers();
+  for (size_t i = 0; i < all.size(); i++)
+  {
+    if (all[i] == this)
+    {
+      all.erase(all.begin() + i);
+      break;
+    }
+  }
+}
+
+bool Timer::start()
+{
+  active = true;
+  dueMicros = clockMicros + (uint64_t)periodMillis * 1000;
+  return true;
+}
+
+bool Timer::stop()
+{
+  active = false;
+  return true;
+}
+
+bool Timer::changePeriod(unsigned period)
+{
+  periodMillis = period;
+  return start();
+}
+
+void Timer::fire()
+{
+  if (oneShot)
+  {
+    active = false;
+  }
+  else
+  {
+    dueMicros += (uint64_t)periodMillis * 1000;
+  }
+  if (callback)
+  {
+    callback();
+  }
+}
+
+/*******************************************************************************
+ String
+*******************************************************************************/
+namespace
+{
+std::string integerToString(unsigned long long value, bool negative, unsigned char base)
+{
+  char buf[72];
+  char *p = buf + sizeof(buf);
+  *--p = 0;
+  if (base < 2 || base > 36)
+  {
+    base = 10;
+  }
+  do
+  {
+    unsigned digit = value % base;
+    *--p = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value);
+  if (negative)
+  {
+    *--p = '-';
+  }
+  return p;
+}
+
+std::string floatToString(double value, int decimalPlaces)
+{
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  return buf;
+}
+} // namespace
+
+String::String(const char *cstr) : String() { copy(cstr, cstr ? strlen(cstr) : 0); }
+String::String(const String &other) : String() { copy(other.c_str(), other.len); }
+String::String(String &&other) : buffer(other.buffer), capacity(other.capacity), len(other.len)
+{
+  other.buffer = nullptr;
+  other.capacity = 0;
+  other.len = 0;
+}
+String::String(char c) : String() { copy(&c, 1); }
+String::String(int value, unsigned char base) : String((long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String(integerToString(value, false, base).c_str()) {}
+String::String(long value, unsigned char base)
+    : String((base == 10 && value < 0 ? integerToString(0ULL - (unsigned long long)value, true, base)
+                                      : integerToString((unsigned long)value, false, base))
+                 .c_str())
+{
+}
+String::String(unsigned long value, unsigned char base) : String(integerToString(value, false, base).c_str()) {}
+String::String(float value, int decimalPlaces) : String(floatToString(value, decimalPlaces).c_str()) {}
+String::String(double value, int decimalPlaces) : String(floatToString(value, decimalPlaces).c_str()) {}
+
+String::~String() { delete[] buffer; }
+
+String &String::operator=(const String &rhs)
+{
+  if (this != &rhs)
+  {
+    copy(rhs.c_str(), rhs.len);
+  }
+  return *this;
+}
+
+String &String::operator=(String &&rhs)
+{
+  if (this != &rhs)
+  {
+    delete[] buffer;
+    buffer = rhs.buffer;
+    capacity = rhs.capacity;
+    len = rhs.len;
+    rhs.buffer = nullptr;
+    rhs.capacity = 0;
+    rhs.len = 0;
+  }
+  return *this;
+}
+
+String &String::operator=(const char *cstr) { return copy(cstr, cstr ? strlen(cstr) : 0); }
+
+// same policy as Wiring: keep the buffer if it's big enough, otherwise reallocate it to the exact size
+bool String::reserve(unsigned int size)
+{
+  if (buffer && capacity >= size)
+  {
+    return true;
+  }
+  char *bigger = new char[size + 1];
+  if (buffer)
+  {
+    memcpy(bigger, buffer, len + 1);
+    delete[] buffer;
+  }
+  buffer = bigger;
+  capacity = size;
+  return true;
+}
+
+String &String::copy(const char *cstr, unsigned int length)
+{
+  reserve(length);
+  memmove(buffer, cstr ? cstr : "", length);
+  buffer[length] = 0;
+  len = length;
+  return *this;
+}
+
+String &String::concat(const char *cstr, unsigned int length)
+{
+  if (length == 0)
+  {
+    return *this;
+  }
+  reserve(len + length);
+  memmove(buffer + len, cstr, length);
+  len += length;
+  buffer[len] = 0;
+  return *this;
+}
+
+String operator+(const String &lhs, const String &rhs)
+{
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+String operator+(const String &lhs, const char *rhs)
+{
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+String operator+(const char *lhs, const String &rhs)
+{
+  String result(lhs);
+  result += rhs;
+  return result;
+}
+
+/*******************************************************************************
+ cloud
+*******************************************************************************/
+bool CloudClass::publish(const char *eventName, const char *eventData, int ttl, PublishFlag flag)
+{
+  (void)ttl;
+  (void)flag;
+  if (!Particle.connected())
+  {
+    return false;
+  }
+
+  // the cloud accepts about 1 event per second with bursts of up to 4,
+  //  anything above that is silently lost even though publish() succeeded
+  static const uint64_t refillMicros = 1000000;
+  static const int burst = 4;
+  static int tokens = burst;
+  static uint64_t lastRefill = 0;
+  uint64_t refills = (clockMicros - lastRefill) / refillMicros;
+  if (refills > 0)
+  {
+    tokens = tokens + refills >= (uint64_t)burst ? burst : tokens + (int)refills;
+    lastRefill += refills * refillMicros;
+  }
+  if (tokens == 0)
+  {
+    rateLimited++;
+    return true;
+  }
+  tokens--;
+
+  published++;
+  if (publishHook)
+  {
+    // whatever the observer allocates is not the firmware's
+    bool counting = countingAllocations;
+    countingAllocations = false;
+    publishHook(clockMicros, eventName, eventData ? eventData : "");
+    countingAllocations = counting;
+  }
+  return true;
+}
+
+bool CloudClass::variable(const char *name, const char *var, CloudVariableType type)
+{
+  (void)type;
+  return registerVariable(name, VAR_CHARS, var);
+}
+
+bool CloudClass::variable(const char *name, const String &var) { return registerVariable(name, VAR_STRING, &var); }
+bool CloudClass::variable(const char *name, const int &var) { return registerVariable(name, VAR_INT, &var); }
+bool CloudClass::variable(const char *name, const double &var) { return registerVariable(name, VAR_DOUBLE, &var); }
+bool CloudClass::variable(const char *name, user_variable_string_fn_t fn) { return registerVariable(name, VAR_FUNCTION, (const void *)fn); }
+
+bool CloudClass::function(const char *name, user_function_int_str_t fn)
+{
+  if (strlen(name) > 12)
+  {
+    return false;
+  }
+  functions().push_back(Function{name, fn});
+  return true;
+}
+
+bool CloudClass::connected()
+{
+  // the handshake is over
+  if (connecting and clockMicros >= connectStartMicros + connectDelayMicros)
+  {
+    connecting = false;
+    sim::setConnected(true);
+  }
+  return cloudConnected;
+}
+
+void CloudClass::connect()
+{
+  if (!cloudConnected and !connecting)
+  {
+    connecting = true;
+    connectStartMicros = clockMicros;
+  }
+}
+
+void CloudClass::disconnect()
+{
+  connecting = false;
+  sim::setConnected(false);
+}
+
+/*******************************************************************************
+ system
+*******************************************************************************/
+uint32_t SystemClass::ticks()
+{
+  static const auto start = std::chrono::steady_clock::now();
+  uint64_t realNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  return (uint32_t)(clockMicros * 1000 + realNanos);
+}
+
+SystemModeSetting::SystemModeSetting(System_Mode_TypeDef mode)
+{
+  systemModeSetting = mode;
+  // only AUTOMATIC connects by itself
+  connecting = mode == AUTOMATIC;
+}
+
+SystemThreadSetting::SystemThreadSetting(SystemThreadState state) { systemThreadSetting = state == ENABLED; }
+
+bool SystemClass::on(system_event_t events, system_event_handler_t handler)
+{
+  systemEventHandlers.push_back(SystemEventHandler{events, handler});
+  return true;
+}
+
+SystemSleepResult SystemClass::sleep(const SystemSleepConfiguration &config)
+{
+  sleepRequest = config;
+  sleepRequested = true;
+  return SystemSleepResult();
+}
+
+uint32_t HAL_RNG_GetRandomNumber(void)
+{
+  static std::random_device device;
+  return device();
+}
+
+/*******************************************************************************
+ emulated EEPROM
+*******************************************************************************/
+namespace
+{
+
+void eraseEeprom()
+{
+  if (not eepromErased)
+  {
+    memset(eepromBytes, 0xFF, sizeof(eepromBytes));
+    eepromErased = true;
+  }
+}
+
+} // namespace
+
+uint8_t EEPROMClass::read(int address) const
+{
+  eraseEeprom();
+  return address >= 0 and address < EEPROM_SIZE ? eepromBytes[address] : 0xFF;
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+  eraseEeprom();
+  if (address >= 0 and address < EEPROM_SIZE and eepromBytes[address] != value)
+  {
+    eepromBytes[address] = value;
+    eepromWrites++;
+  }
+}
+
+/*******************************************************************************
+ wall clock
+*******************************************************************************/
+void TimeClass::zone(float offsetHours) { timeZoneHours = offsetHours; }
+time_t TimeClass::now() { return epochAtZero + (time_t)(clockMicros / 1000000); }
+time_t TimeClass::local() { return now() + (time_t)(timeZoneHours * 3600); }
+
+int TimeClass::hour()
+{
+  time_t t = local();
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  return tm.tm_hour;
+}
+
+int TimeClass::minute()
+{
+  time_t t = local();
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  return tm.tm_min;
+}
+
+int TimeClass::second()
+{
+  time_t t = local();
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  return tm.tm_sec;
+}
+
+String TimeClass::format(time_t t, const char *formatSpec)
+{
+  t += (time_t)(timeZoneHours * 3600);
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  char buf[64];
+  strftime(buf, sizeof(buf), formatSpec, &tm);
+  return String(buf);
+}
+
+String TimeClass::timeStr() { return format(now(), "%a %b %e %H:%M:%S %Y"); }
+
+/*******************************************************************************
+ serial
+*******************************************************************************/
+size_t USBSerial::println(const char *text)
+{
+  return printf("%s\n", text);
+}
+
+/*******************************************************************************
+ DHT
+*******************************************************************************/
+PietteTech_DHT::PietteTech_DHT(uint8_t sigPin, uint8_t dht_type, void (*wrapper)())
+    : _sigPin(sigPin), _type(dht_type), isrCallback_wrapper(wrapper), _acquiring(false),
+      _hung(false), _acquireDoneMicros(0), _status(DHTLIB_ERROR_NOTSTARTED), _celsius(0), _humidity(0)
+{
+}
+
+void PietteTech_DHT::begin() {}
+void PietteTech_DHT::isrCallback() {}
+
+void PietteTech_DHT::update()
+{
+  if (not _acquiring or _hung or clockMicros < _acquireDoneMicros)
+  {
+    return;
+  }
+
+  // the DHT22 reports tenths
+  float celsius = roundf(dhtCelsius * 10) / 10;
+  float humidity = roundf(dhtHumidity * 10) / 10;
+  int status = DHTLIB_OK;
+  dhtAcquisitions++;
+  if (not dhtQueue.empty())
+  {
+    celsius = dhtQueue.front().celsius;
+    humidity = dhtQueue.front().humidity;
+    status = dhtQueue.front().status;
+    dhtQueue.pop_front();
+  }
+  else if (dhtErrorEvery and dhtAcquisitions % dhtErrorEvery == 0)
+  {
+    status = (dhtAcquisitions / dhtErrorEvery) % 2 ? DHTLIB_ERROR_CHECKSUM : DHTLIB_ERROR_ACQUIRING;
+  }
+
+  if (status == DHTLIB_OK)
+  {
+    _celsius = celsius;
+    _humidity = humidity;
+  }
+  // the sensor did not answer: this acquisition never ends
+  _hung = status == DHTLIB_ERROR_ACQUIRING;
+  _acquiring = _hung;
+  _status = status;
+
+  if (inputHook)
+  {
+    if (status == DHTLIB_OK)
+    {
+      inputHook(_acquireDoneMicros, 'h', 0, lroundf(_celsius * 100), lroundf(_humidity * 100));
+    }
+    else
+    {
+      inputHook(_acquireDoneMicros, 'e', 0, status, 0);
+    }
+  }
+}
+
+int PietteTech_DHT::acquire()
+{
+  update();
+  // one that hung is dropped and started over
+  if (_acquiring and not _hung)
+  {
+    return DHTLIB_ERROR_ACQUIRING;
+  }
+  _acquiring = true;
+  _hung = false;
+  _status = DHTLIB_ERROR_ACQUIRING;
+  _acquireDoneMicros = clockMicros + dhtMicros;
+  return DHTLIB_ERROR_ACQUIRING;
+}
+
+int PietteTech_DHT::acquireAndWait(uint32_t timeout)
+{
+  acquire();
+  uint64_t giveUp = clockMicros + (uint64_t)(timeout ? timeout : 1000) * 1000;
+  uint64_t done = _acquireDoneMicros < giveUp ? _acquireDoneMicros : giveUp;
+  clockMicros = done;
+  update();
+  return _acquiring ? DHTLIB_ERROR_ACQUIRING : _status;
+}
+
+bool PietteTech_DHT::acquiring()
+{
+  update();
+  return _acquiring;
+}
+
+int PietteTech_DHT::getStatus()
+{
+  update();
+  return _status;
+}
+
+float PietteTech_DHT::getCelsius() { return _celsius; }
+float PietteTech_DHT::getFahrenheit() { return _celsius * 9 / 5 + 32; }
+float PietteTech_DHT::getKelvin() { return _celsius + 273.15; }
+float PietteTech_DHT::getHumidity() { return _humidity; }
+
+double PietteTech_DHT::getDewPoint()
+{
+  double a = 17.271;
+  double b = 237.7;
+  double temp = (a * _celsius) / (b + _celsius) + log(_humidity / 100);
+  return (b * temp) / (a - temp);
+}
+
+/*******************************************************************************
+ simulation controls
+*******************************************************************************/
+namespace sim
+{
+
+uint64_t nowMicros() { return clockMicros; }
+
+void runThreads()
+{
+  for (SimThread *thread : simThreads)
+  {
+    if (thread->wakeMicros > clockMicros)
+    {
+      continue;
+    }
+    currentThread = thread;
+    swapcontext(&mainContext, &thread->context);
+    currentThread = nullptr;
+  }
+}
+
+uint64_t nextThreadWakeMicros()
+{
+  uint64_t wake = UINT64_MAX;
+  for (SimThread *thread : simThreads)
+  {
+    if (thread->wakeMicros < wake)
+    {
+      wake = thread->wakeMicros;
+    }
+  }
+  return wake;
+}
+void advanceMicros(uint64_t us) { advanceClockTo(clockMicros + us); }
+void advanceMillis(uint64_t ms) { advanceClockTo(clockMicros + ms * 1000); }
+void setEpoch(time_t epoch) { epochAtZero = epoch; }
+
+void setDigital(pin_t pin, int level)
+{
+  if (!validPin(pin))
+  {
+    return;
+  }
+
+  level = level ? HIGH : LOW;
+  int previous = pinLevel[pin];
+  pinLevel[pin] = level;
+  if (level != previous and inputHook)
+  {
+    inputHook(clockMicros, 'd', pin, level, 0);
+  }
+  if (level == previous or pinHandler[pin] == nullptr or interruptsDisabled > 0)
+  {
+    return;
+  }
+
+  InterruptMode mode = pinInterruptMode[pin];
+  if (mode == CHANGE or (mode == RISING and level == HIGH) or (mode == FALLING and level == LOW))
+  {
+    pinHandler[pin]();
+  }
+}
+
+int digitalOutput(pin_t pin) { return validPin(pin) ? pinLevel[pin] : LOW; }
+PinMode pinModeOf(pin_t pin) { return validPin(pin) ? pinModes[pin] : INPUT; }
+
+uint64_t firstReadMicros(pin_t pin) { return validPin(pin) and pinWasRead[pin] ? pinFirstRead[pin] : UINT64_MAX; }
+
+void setAnalog(pin_t pin, int value)
+{
+  if (validPin(pin))
+  {
+    pinAnalog[pin] = value;
+  }
+}
+
+void setAnalogNoise(pin_t pin, int amplitude)
+{
+  if (validPin(pin))
+  {
+    pinAnalogNoise[pin] = amplitude;
+  }
+}
+
+void setDht(float celsius, float humidity)
+{
+  dhtCelsius = celsius;
+  dhtHumidity = humidity;
+}
+
+void queueAnalog(pin_t pin, int value)
+{
+  if (validPin(pin))
+  {
+    analogQueue[pin].push_back(value);
+  }
+}
+
+void queueDht(float celsius, float humidity) { dhtQueue.push_back({celsius, humidity, DHTLIB_OK}); }
+void queueDhtError(int status) { dhtQueue.push_back({0, 0, status}); }
+void setDhtErrors(unsigned every) { dhtErrorEvery = every; }
+
+void onInput(InputHook hook) { inputHook = hook; }
+
+void setDhtAcquireMicros(uint32_t us) { dhtMicros = us; }
+uint32_t dhtAcquireMicros() { return dhtMicros; }
+
+void onPublish(PublishHook hook) { publishHook = hook; }
+unsigned long publishCount() { return published; }
+unsigned long rateLimitedCount() { return rateLimited; }
+void setConnected(bool connected)
+{
+  if (connected != cloudConnected and inputHook)
+  {
+    inputHook(clockMicros, 'c', 0, connected, 0);
+  }
+  cloudConnected = connected;
+  if (connected)
+  {
+    connecting = false;
+  }
+}
+
+void setConnectDelay(uint32_t ms) { connectDelayMicros = (uint64_t)ms * 1000; }
+System_Mode_TypeDef systemMode() { return systemModeSetting; }
+bool systemThread() { return systemThreadSetting; }
+
+bool loadEeprom(const char *path)
+{
+  eraseEeprom();
+  FILE *file = fopen(path, "rb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  size_t read = fread(eepromBytes, 1, sizeof(eepromBytes), file);
+  fclose(file);
+  return read == sizeof(eepromBytes);
+}
+
+bool saveEeprom(const char *path)
+{
+  eraseEeprom();
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  size_t written = fwrite(eepromBytes, 1, sizeof(eepromBytes), file);
+  return fclose(file) == 0 and written == sizeof(eepromBytes);
+}
+
+unsigned long eepromWriteCount() { return eepromWrites; }
+
+void systemEvent(system_event_t event, int param)
+{
+  for (const SystemEventHandler &handler : systemEventHandlers)
+  {
+    if (handler.events & event)
+    {
+      handler.handler(event, param);
+    }
+  }
+}
+
+bool takeSleepRequest(SystemSleepConfiguration &request)
+{
+  if (not sleepRequested)
+  {
+    return false;
+  }
+  request = sleepRequest;
+  sleepRequested = false;
+  return true;
+}
+
+void countAllocations(bool on) { countingAllocations = on; }
+unsigned long allocationCount() { return allocations; }
+
+bool readVariable(const char *name, std::string &value)
+{
+  for (const Variable &v : variables())
+  {
+    if (v.name != name)
+    {
+      continue;
+    }
+    switch (v.kind)
+    {
+    case VAR_CHARS:
+      value = (const char *)v.ptr;
+      break;
+    case VAR_STRING:
+      value = ((const String *)v.ptr)->c_str();
+      break;
+    case VAR_INT:
+      value = std::to_string(*(const int *)v.ptr);
+      break;
+    case VAR_DOUBLE:
+      value = std::to_string(*(const double *)v.ptr);
+      break;
+    case VAR_FUNCTION:
+      value = ((user_variable_string_fn_t)v.ptr)().c_str();
+      break;
+    }
+    return true;
+  }
+  return false;
+}
+
+std::vector<std::string> variableNames()
+{
+  std::vector<std::string> names;
+  for (const Variable &v : variables())
+  {
+    names.push_back(v.name);
+  }
+  return names;
+}
+
+bool hasFunction(const char *name)
+{
+  for (const Function &f : functions())
+  {
+    if (f.name == name)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+int callFunction(const char *name, const char *argument)
+{
+  for (const Function &f : functions())
+  {
+    if (f.name == name)
+    {
+      return f.fn(String(argument));
+    }
+  }
+  return -1;
+}
+
+} // namespace sim
+
+/*******************************************************************************
+ heap: every operator new (the host String included) goes through here
+*******************************************************************************/
+void *operator new(size_t size)
+{
+  if (countingAllocations)
+  {
+    allocations++;
+  }
+  void *p = malloc(size ? size : 1);
+  if (!p)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
@@ -0,0 +1,174 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Host benchmark of the sensor registry (src/sensorRegistry.h): what the sensors cost loop() as the
+//   table grows from 1 to 64 sensors, on the stand-in HAL with loop() passes 1 ms apart.
+//  Every eighth sensor is a DHT22 read every 30 seconds, the others are leak sensors: watched with an
+//   interrupt and read every minute ("interrupt"), or read every 2 seconds ("polled").
+//  A quarter of the leak sensors get wet for a while, so alarms and interrupts are part of the run.
+//  Also timed is walking the table on every pass instead of only when due() says so.
+//
+//  usage: sensorBench [virtual seconds per run]   (default 3600)
+
+#include "sensorRegistry.h"
+#include "sim.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+namespace
+{
+
+const unsigned long alarms[] = {10000, 60000, 300000, 900000, 3600000, 14400000};
+const pin_t pins[] = {D0, D1, D2, D3, D4, D5, D6, D7, A0, A1, A2, A3, A4, A5, A6, A7};
+
+unsigned long events = 0;
+
+void countEvent(uint8_t index, SensorEvent event) { events++; }
+void dhtWrapper() {}
+
+struct Run
+{
+  double nanosPerPass;
+  double nanosPerWalk;
+  unsigned long walks;
+  unsigned long events;
+};
+
+// one virtual run, with the pass loop the firmware has
+Run run(uint8_t count, bool interrupts, bool alwaysWalk, unsigned long seconds)
+{
+  std::vector<PietteTech_DHT> sensorsDht;
+  std::vector<DhtReader> readers;
+  sensorsDht.reserve(count);
+  readers.reserve(count);
+
+  std::vector<SensorDescriptor> table(count);
+  std::vector<SensorState> states(count);
+  for (uint8_t i = 0; i < count; i++)
+  {
+    SensorDescriptor &sensor = table[i];
+    sensor.name = "sensor";
+    sensor.pin = pins[i % arraySize(pins)];
+    if (i % 8 == 7)
+    {
+      sensorsDht.emplace_back(sensor.pin, DHT22, dhtWrapper);
+      readers.emplace_back(sensorsDht.back());
+      sensor.type = SENSOR_DHT22;
+      sensor.flags = 0;
+      sensor.periodMillis = 30000;
+      sensor.alarms = nullptr;
+      sensor.alarmCount = 0;
+      sensor.dht = &readers.back();
+    }
+    else
+    {
+      sensor.type = SENSOR_LEAK;
+      sensor.flags = interrupts ? SENSOR_INTERRUPT : 0;
+      sensor.periodMillis = interrupts ? 60000 : 2000;
+      sensor.alarms = alarms;
+      sensor.alarmCount = arraySize(alarms);
+      sensor.dht = nullptr;
+    }
+  }
+
+  for (pin_t pin : pins)
+  {
+    sim::setDigital(pin, HIGH);
+  }
+  SensorRegistry registry(table.data(), states.data(), count, countEvent);
+  registry.begin();
+  events = 0;
+
+  unsigned long walks = 0;
+  std::chrono::steady_clock::duration walking{};
+  uint64_t end = sim::nowMicros() + (uint64_t)seconds * 1000000;
+  // the pins of a quarter of the leak sensors (D0 to D3) are wet from 1/4 to 3/4 of the run
+  uint64_t wetFrom = sim::nowMicros() + (uint64_t)seconds * 250000;
+  uint64_t wetTo = sim::nowMicros() + (uint64_t)seconds * 750000;
+  bool wet = false;
+
+  auto start = std::chrono::steady_clock::now();
+  unsigned long passes = 0;
+  while (sim::nowMicros() < end)
+  {
+    uint64_t now = sim::nowMicros();
+    bool wetNow = now >= wetFrom and now < wetTo;
+    if (wetNow != wet)
+    {
+      wet = wetNow;
+      for (pin_t pin : {D0, D1, D2, D3})
+      {
+        sim::setDigital(pin, wet ? LOW : HIGH);
+      }
+    }
+
+    if (alwaysWalk)
+    {
+      registry.process();
+    }
+    else if (registry.due())
+    {
+      auto walkStart = std::chrono::steady_clock::now();
+      registry.process();
+      walking += std::chrono::steady_clock::now() - walkStart;
+      walks++;
+    }
+    sim::advanceMicros(1000);
+    passes++;
+  }
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  double walkNanos = walks ? std::chrono::duration<double, std::nano>(walking).count() / walks : 0;
+
+  for (pin_t pin : pins)
+  {
+    detachInterrupt(pin);
+  }
+  return {elapsed * 1e9 / passes, walkNanos, walks, events};
+}
+
+// the same pass loop without sensors, taken off the results
+double emptyPass(unsigned long seconds)
+{
+  uint64_t end = sim::nowMicros() + (uint64_t)seconds * 1000000;
+  unsigned long passes = 0;
+  auto start = std::chrono::steady_clock::now();
+  while (sim::nowMicros() < end)
+  {
+    sim::advanceMicros(1000);
+    passes++;
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e9 / passes;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  unsigned long seconds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 3600;
+
+  double empty = emptyPass(seconds);
+  printf("per sensor       : %zu bytes of descriptor (flash), %zu bytes of state (RAM), on this host\n",
+         sizeof(SensorDescriptor), sizeof(SensorState));
+  printf("pass loop alone  : %.1f ns (taken off below)\n\n", empty);
+  printf("                   ---- walk only when due() ----   walk every pass\n");
+  printf("sensors  mode       walks/s  ns/walk  ns/pass        ns/pass   events\n");
+
+  for (uint8_t count : {1, 2, 4, 8, 16, 32, 64})
+  {
+    for (bool interrupts : {true, false})
+    {
+      Run due = run(count, interrupts, false, seconds);
+      Run every = run(count, interrupts, true, seconds);
+      printf("%7u  %-9s  %7.2f  %7.1f  %7.2f        %7.1f  %7lu\n", count, interrupts ? "interrupt" : "polled",
+             due.walks / (double)seconds, due.nanosPerWalk, due.nanosPerPass - empty, every.nanosPerPass - empty,
+             due.events);
+    }
+  }
+  return 0;
+}
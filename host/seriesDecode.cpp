@@ -0,0 +1,227 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Host decoder of the packed sample batches of src/sampleCodec.h (DownStairs_Packed events).
+//
+//  usage: seriesDecode BATCH...    prints every sample as "unix time,value 1,value 2"
+//         seriesDecode             same, one batch per line from stdin (e.g. the data of exported events)
+//         seriesDecode --check [rounds]
+//                                  encodes random series, decodes them back and compares every sample,
+//                                   then prints the size of a sample packed and as JSON (SampleSeries::format).
+//                                  exits with 1 on any mismatch
+
+#include "fixedFormat.h"
+#include "publishQueue.h"
+#include "sampleCodec.h"
+#include "sampleSeries.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+
+SeriesSample decoded[SAMPLE_SERIES_CAPACITY];
+
+bool printBatch(const char *text)
+{
+  uint8_t values;
+  int samples = sampleCodec_decode(text, values, decoded, SAMPLE_SERIES_CAPACITY);
+  if (samples < 0)
+  {
+    fprintf(stderr, "not a packed batch: %s\n", text);
+    return false;
+  }
+  char number[16];
+  for (int i = 0; i < samples; i++)
+  {
+    printf("%lu", (unsigned long)decoded[i].time);
+    for (uint8_t v = 0; v < values; v++)
+    {
+      fixedFormat(number, sizeof(number), decoded[i].values[v], 2);
+      printf(",%s", number);
+    }
+    printf("\n");
+  }
+  return true;
+}
+
+uint32_t randomState = 2463534242u;
+uint32_t random32()
+{
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState;
+}
+
+// a random number in [-range, range]
+int32_t randomBetween(int32_t range) { return (int32_t)(random32() % (2 * range + 1)) - range; }
+
+enum Shape
+{
+  DHT22,    // every 30 secs, tenths of a degree and of a percent that move now and then
+  FINE,     // every 30 secs, a few hundredths per sample (e.g. a filtered analog reading)
+  JITTER,   // like FINE, the timer drifts a second now and then
+  GAPS,     // the device was off for a while, big jumps
+  EXTREMES, // any int16 value, any time step
+  SHAPES,
+};
+
+const char *shapeNames[SHAPES] = {"dht22", "fine", "jitter", "gaps", "extremes"};
+
+void fill(SampleSeries &series, Shape shape, uint16_t samples)
+{
+  series.clear();
+  uint32_t time = 1700000000 + random32() % 10000000;
+  int32_t temperature = 2000 + randomBetween(1500);
+  int32_t humidity = 4500 + randomBetween(3000);
+  if (shape == DHT22)
+  {
+    temperature -= temperature % 10;
+    humidity -= humidity % 10;
+  }
+  for (uint16_t i = 0; i < samples; i++)
+  {
+    switch (shape)
+    {
+    case DHT22:
+      time += 30;
+      temperature += random32() % 4 ? 0 : 10 * randomBetween(1);
+      humidity += random32() % 2 ? 0 : 10 * randomBetween(2);
+      break;
+    case FINE:
+      time += 30;
+      temperature += randomBetween(5);
+      humidity += randomBetween(20);
+      break;
+    case JITTER:
+      time += 30 + randomBetween(1);
+      temperature += randomBetween(5);
+      humidity += randomBetween(20);
+      break;
+    case GAPS:
+      time += random32() % 8 ? 30 : random32() % 100000;
+      temperature += randomBetween(300);
+      humidity += randomBetween(1000);
+      break;
+    default:
+      time = random32();
+      temperature = (int16_t)random32();
+      humidity = (int16_t)random32();
+      break;
+    }
+    series.add(time, temperature, humidity);
+  }
+}
+
+int check(unsigned rounds)
+{
+  static SampleSeries series;
+  char packed[PUBLISH_DATA_MAX + 1];
+  char json[PUBLISH_DATA_MAX + 1];
+  char large[2048];
+  unsigned long mismatches = 0;
+
+  printf("%-10s %14s %14s %22s\n", "series", "packed B/smp", "json B/smp", "samples per publish");
+  for (int shape = 0; shape < SHAPES; shape++)
+  {
+    unsigned long packedBytes = 0;
+    unsigned long jsonBytes = 0;
+    unsigned long packedSamples = 0;
+    unsigned long jsonSamples = 0;
+    unsigned long publishes = 0;
+    for (unsigned round = 0; round < rounds; round++)
+    {
+      fill(series, (Shape)shape, 1 + round % SAMPLE_SERIES_CAPACITY);
+
+      // every length of publish, the encoder must never write more than it's given
+      size_t size = 1 + random32() % sizeof(packed);
+      uint16_t samples;
+      size_t length = sampleCodec_encode(series, SAMPLE_SERIES_VALUES, packed, size, samples);
+      if (length >= size or (samples > 0 and strlen(packed) != length))
+      {
+        printf("%s: %zu characters written in a buffer of %zu\n", shapeNames[shape], length, size);
+        mismatches++;
+        continue;
+      }
+      if (samples == 0)
+      {
+        continue;
+      }
+
+      uint8_t values;
+      int decodedSamples = sampleCodec_decode(packed, values, decoded, SAMPLE_SERIES_CAPACITY);
+      bool same = decodedSamples == samples and values == SAMPLE_SERIES_VALUES;
+      for (int i = 0; same and i < decodedSamples; i++)
+      {
+        same = decoded[i].time == series.at(i).time and
+               not memcmp(decoded[i].values, series.at(i).values, sizeof(decoded[i].values));
+      }
+      if (not same)
+      {
+        printf("%s: round %u does not decode back (%d of %u samples)\n", shapeNames[shape], round, decodedSamples, samples);
+        mismatches++;
+      }
+
+      // size of the whole series in both formats
+      if (series.size() == SAMPLE_SERIES_CAPACITY)
+      {
+        packedBytes += sampleCodec_encode(series, SAMPLE_SERIES_VALUES, large, sizeof(large), samples);
+        jsonBytes += series.format(large, sizeof(large), SAMPLE_SERIES_VALUES, samples);
+        series.format(json, sizeof(json), SAMPLE_SERIES_VALUES, samples);
+        jsonSamples += samples;
+        sampleCodec_encode(series, SAMPLE_SERIES_VALUES, packed, sizeof(packed), samples);
+        packedSamples += samples;
+        publishes++;
+      }
+    }
+    if (publishes)
+    {
+      double packedPerSample = (double)packedBytes / (publishes * SAMPLE_SERIES_CAPACITY);
+      double jsonPerSample = (double)jsonBytes / (publishes * SAMPLE_SERIES_CAPACITY);
+      // the series holds SAMPLE_SERIES_CAPACITY, beyond that it's what would fit in PUBLISH_DATA_MAX
+      printf("%-10s %14.2f %14.2f %10.0f vs %-5.0f (%.1fx)\n", shapeNames[shape], packedPerSample, jsonPerSample,
+             PUBLISH_DATA_MAX / packedPerSample, PUBLISH_DATA_MAX / jsonPerSample, jsonPerSample / packedPerSample);
+      printf("%-10s %44s %lu vs %lu\n", "", "a full series, first publish:", packedSamples / publishes,
+             jsonSamples / publishes);
+    }
+  }
+
+  printf("%u rounds per series, %lu mismatches\n", rounds, mismatches);
+  return mismatches ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  if (argc > 1 and not strcmp(argv[1], "--check"))
+  {
+    return check(argc > 2 ? strtoul(argv[2], nullptr, 10) : 20000);
+  }
+
+  bool ok = true;
+  if (argc > 1)
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      ok = printBatch(argv[i]) and ok;
+    }
+    return ok ? 0 : 1;
+  }
+
+  char line[2048];
+  while (fgets(line, sizeof(line), stdin))
+  {
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[0])
+    {
+      ok = printBatch(line) and ok;
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Controls for the host-side simulation: virtual clock, pin levels, sensor values,
+//   cloud variables/functions and the log of everything the firmware published.
+
+#pragma once
+
+#include "Particle.h"
+
+#include <vector>
+
+namespace sim
+{
+
+// virtual clock, starts at 0 and only moves when told to (or when the firmware calls delay())
+//  software timers (Timer) fire while it moves
+uint64_t nowMicros();
+void advanceMicros(uint64_t us);
+void advanceMillis(uint64_t ms);
+
+// the firmware threads (Thread) whose delay() is over run, one after the other, each until its next
+//  delay(): call it before every pass of loop(), like the scheduler of Device OS would run a thread
+//  of higher priority first
+void runThreads();
+// when the first of them wakes up, UINT64_MAX if there is none
+uint64_t nextThreadWakeMicros();
+
+// unix time reported by Time.now() when the virtual clock is at 0
+void setEpoch(time_t epoch);
+
+// pins: an edge runs the handler attached with attachInterrupt(), if any
+void setDigital(pin_t pin, int level);
+int digitalOutput(pin_t pin);
+PinMode pinModeOf(pin_t pin);
+// when the firmware read the pin for the first time, UINT64_MAX if it never did
+uint64_t firstReadMicros(pin_t pin);
+void setAnalog(pin_t pin, int value);
+// analogRead() of this pin is off by up to +-amplitude, with a spike to 0 or 4095 one time in 50
+void setAnalogNoise(pin_t pin, int amplitude);
+
+// readings replayed in order by analogRead() of the pin, before falling back to setAnalog() (no noise)
+void queueAnalog(pin_t pin, int value);
+
+// DHT22: values returned by the next acquisition and how long one acquisition takes
+void setDht(float celsius, float humidity);
+// results of the next acquisitions, in order, before falling back to setDht()
+void queueDht(float celsius, float humidity);
+// an acquisition that fails with this status, DHTLIB_ERROR_ACQUIRING for a sensor that never answers
+void queueDhtError(int status);
+// one acquisition in every fails, a bad checksum and no answer in turns (0 = never)
+void setDhtErrors(unsigned every);
+void setDhtAcquireMicros(uint32_t us);
+uint32_t dhtAcquireMicros();
+
+// cloud
+typedef void (*PublishHook)(uint64_t atMicros, const char *eventName, const char *eventData);
+void onPublish(PublishHook hook);
+unsigned long publishCount();
+// publishes lost because they went over the cloud rate limit
+unsigned long rateLimitedCount();
+void setConnected(bool connected);
+// how long the cloud handshake takes once the system starts connecting (at boot in AUTOMATIC mode,
+//  on Particle.connect() otherwise), 0 by default
+void setConnectDelay(uint32_t ms);
+System_Mode_TypeDef systemMode();
+bool systemThread();
+bool readVariable(const char *name, std::string &value);
+std::vector<std::string> variableNames();
+// returns the value returned by the cloud function, or -1 if not registered (check hasFunction())
+int callFunction(const char *name, const char *argument);
+bool hasFunction(const char *name);
+
+// everything the firmware reads, as it reads it (see src/sensorTrace.h for the kinds):
+//  'd' pin level changes, 'a' analogRead() results, 'h' DHT22 acquisitions in hundredths,
+//  'e' failed DHT22 acquisitions with their status, 'c' cloud up/down
+typedef void (*InputHook)(uint64_t atMicros, char kind, int pin, int first, int second);
+void onInput(InputHook hook);
+
+// low power: the last System.sleep() of the firmware, false if it did not ask since the last call
+//  the simulation is in charge of sleeping: moving the clock, and waking up early on an edge of one of the pins
+bool takeSleepRequest(SystemSleepConfiguration &request);
+
+// EEPROM: an image of EEPROM_SIZE bytes, so a run can start where the last one stopped
+//  load returns false if the file is not there (the EEPROM stays erased)
+bool loadEeprom(const char *path);
+bool saveEeprom(const char *path);
+unsigned long eepromWriteCount();
+
+// raises a system event for the handlers of System.on(), e.g. firmware_update, firmware_update_begin
+void systemEvent(system_event_t event, int param);
+
+// heap: number of operator new calls made while counting is on
+//  the host String allocates like the Wiring one, so String churn in the firmware shows up here
+void countAllocations(bool on);
+unsigned long allocationCount();
+
+} // namespace sim
@@ -0,0 +1,553 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Host-side simulation of homeCommander: runs the unmodified setup()/loop() of
+//   src/homeCommander.ino against the stand-in HAL, advancing a virtual clock after every loop() pass.
+//
+//  usage: homeCommanderSim [options]
+//    --loops N       number of loop() passes (default 10000000)
+//    --step-us N     virtual microseconds added after every loop() pass (default 1000)
+//    --flood-at S    water shows up on D7 after S virtual seconds
+//    --dry-at S      the water is gone after S virtual seconds
+//    --dryer-at S    a dryer cycle starts after S virtual seconds (synthetic DHT22 profile)
+//    --call-at S F A call cloud function F with argument A after S virtual seconds (can be repeated)
+//                    (garage_open/garage_close press D1, the door then takes 12 virtual seconds to move)
+//    --offline S1 S2 the cloud is unreachable from S1 to S2 virtual seconds
+//    --connect-ms N  the cloud handshake takes N virtual milliseconds (default 0); in AUTOMATIC mode without
+//                    the system thread setup() only runs after it, like on the device
+//    --dht-errors N  one DHT22 acquisition in N fails, a bad checksum and a sensor that does not answer in turns
+//    --adc-noise N   pool thermistor readings on A0 are off by up to +-N, with a spike one time in 50
+//    --verbose       print every publish as it happens
+//    --no-alloc      exit with 1 if loop() allocated from the heap after the first virtual minute
+//    --record FILE   write everything the firmware read and published as a trace (see src/sensorTrace.h),
+//                    host/traceReplay replays it
+//    --sleep         call power_sleep() after every loop() pass, as LOW_POWER 1 does
+//    --wake-us N     every sleep costs N virtual microseconds awake (default 2000): stopping, waking up
+//                    and starting the clocks again
+//    --eeprom FILE   the EEPROM starts with the contents of FILE, if it is there, and is written back to it
+//    --epoch T       unix time at the start (default 1700000000), e.g. the clock at the end of the last run
+//
+//  When the firmware asks to sleep (System.sleep()), the clock moves on in steps without running loop()
+//   until the sleep is over or one of the wake-up pins changes, the inputs above keep coming meanwhile.
+//   "awake" is then the share of the virtual time not spent sleeping, each sleep charged --wake-us
+//   of awake time: many short sleeps cost more than a few long ones.
+//
+//  Build with the default RelWithDebInfo configuration and run it under perf, e.g.
+//    perf record -g ./homeCommanderSim --loops 50000000 && perf report
+
+#include "Particle.h"
+#include "homeStatus.h"
+#include "publishQueue.h"
+#include "sensorTrace.h"
+#include "sim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+void setup();
+void loop();
+void power_sleep();
+GarageStatus garage_whatIsTheStatus();
+extern PublishQueue publishQueue;
+
+namespace
+{
+
+bool verbose = false;
+std::map<std::string, unsigned long> publishesByEvent;
+long long firstFloodAlarm = -1;
+
+struct CloudCall
+{
+  long long at;
+  const char *function;
+  const char *argument;
+};
+
+FILE *traceFile = nullptr;
+SensorTrace trace;
+char traceLine[SENSOR_TRACE_LINE_MAX + 1];
+
+void writeTrace()
+{
+  while (trace.nextLine(traceLine, sizeof(traceLine)))
+  {
+    fprintf(traceFile, "%s\n", traceLine);
+  }
+}
+
+void recordInput(uint64_t atMicros, char kind, int pin, int first, int second)
+{
+  switch (kind)
+  {
+  case TRACE_DIGITAL:
+    trace.digital(atMicros, pin, first);
+    break;
+  case TRACE_ANALOG:
+    trace.analog(atMicros, pin, first);
+    break;
+  case TRACE_DHT:
+    trace.dht(atMicros, first, second);
+    break;
+  case TRACE_DHT_ERROR:
+    trace.dhtError(atMicros, first);
+    break;
+  case TRACE_CLOUD:
+    trace.cloud(atMicros, first);
+    break;
+  }
+}
+
+void recordPublish(uint64_t atMicros, const char *eventName, const char *eventData)
+{
+  if (traceFile)
+  {
+    writeTrace();
+    trace.publishLine(traceLine, sizeof(traceLine), atMicros, eventName, eventData);
+    fprintf(traceFile, "%s\n", traceLine);
+  }
+  publishesByEvent[eventName]++;
+  if (firstFloodAlarm < 0 and strstr(eventData, "Flood detected"))
+  {
+    firstFloodAlarm = atMicros;
+  }
+  if (verbose)
+  {
+    printf("%10.3fs  %-20s %s\n", atMicros / 1e6, eventName, eventData);
+  }
+}
+
+// a rough model of a dryer cycle as seen by the DHT22 on the exhaust:
+//  humidity jumps when the drum heats up, then decays while the temperature climbs
+void dryerProfile(double secondsIntoCycle, float &celsius, float &humidity)
+{
+  const double heatUp = 300;
+  const double cycle = 3600;
+  if (secondsIntoCycle < 0 or secondsIntoCycle > cycle + 1800)
+  {
+    celsius = 22;
+    humidity = 45;
+    return;
+  }
+  if (secondsIntoCycle < heatUp)
+  {
+    double k = secondsIntoCycle / heatUp;
+    celsius = 22 + k * 18;
+    humidity = 45 + k * 40;
+    return;
+  }
+  if (secondsIntoCycle < cycle)
+  {
+    double k = (secondsIntoCycle - heatUp) / (cycle - heatUp);
+    celsius = 40 + k * 18;
+    humidity = 5 + 80 * exp(-4 * k);
+    return;
+  }
+  // cool down after the dryer stopped
+  double k = (secondsIntoCycle - cycle) / 1800;
+  celsius = 58 - k * 36;
+  humidity = 6 + k * 39;
+}
+
+// the garage door: a press of the button on D1 starts it moving towards the other reed switch,
+//  the switch it leaves and the one it reaches both bounce a few times
+struct GarageDoor
+{
+  bool open = false;
+  bool moving = false;
+  bool buttonWasPressed = false;
+  uint64_t arrivesAt = 0;
+
+  static void bounce(pin_t pin, int level)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      sim::setDigital(pin, level);
+      sim::setDigital(pin, not level);
+    }
+    sim::setDigital(pin, level);
+  }
+
+  void step(uint64_t now)
+  {
+    bool buttonPressed = sim::digitalOutput(D1) == HIGH;
+    if (buttonPressed and not buttonWasPressed and not moving)
+    {
+      bounce(open ? D5 : D4, HIGH);
+      moving = true;
+      arrivesAt = now + 12000000;
+    }
+    buttonWasPressed = buttonPressed;
+
+    if (moving and now >= arrivesAt)
+    {
+      open = not open;
+      moving = false;
+      bounce(open ? D5 : D4, LOW);
+    }
+  }
+
+  const char *status() const
+  {
+    if (moving)
+    {
+      return open ? "closing" : "opening";
+    }
+    return open ? "open" : "closed";
+  }
+};
+
+unsigned long long parseNumber(const char *text)
+{
+  return strtoull(text, nullptr, 10);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  unsigned long long loops = 10000000;
+  unsigned long long stepMicros = 1000;
+  long long floodAt = -1;
+  long long dryAt = -1;
+  long long dryerAt = -1;
+  std::vector<CloudCall> calls;
+  size_t nextCall = 0;
+  bool noAlloc = false;
+  int adcNoise = 0;
+  long long offlineFrom = -1;
+  long long offlineTo = -1;
+  bool offline = false;
+  unsigned long connectMillis = 0;
+  const char *recordPath = nullptr;
+  bool sleep = false;
+  unsigned long long wakeMicros = 2000;
+  const char *eepromPath = nullptr;
+
+  for (int i = 1; i < argc; i++)
+  {
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--loops") and hasValue)
+    {
+      loops = parseNumber(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--step-us") and hasValue)
+    {
+      stepMicros = parseNumber(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--flood-at") and hasValue)
+    {
+      floodAt = parseNumber(argv[++i]) * 1000000;
+    }
+    else if (!strcmp(argv[i], "--dry-at") and hasValue)
+    {
+      dryAt = parseNumber(argv[++i]) * 1000000;
+    }
+    else if (!strcmp(argv[i], "--dryer-at") and hasValue)
+    {
+      dryerAt = parseNumber(argv[++i]) * 1000000;
+    }
+    else if (!strcmp(argv[i], "--call-at") and i + 3 < argc)
+    {
+      CloudCall call;
+      call.at = parseNumber(argv[++i]) * 1000000;
+      call.function = argv[++i];
+      call.argument = argv[++i];
+      calls.push_back(call);
+    }
+    else if (!strcmp(argv[i], "--verbose"))
+    {
+      verbose = true;
+    }
+    else if (!strcmp(argv[i], "--offline") and i + 2 < argc)
+    {
+      offlineFrom = parseNumber(argv[++i]) * 1000000;
+      offlineTo = parseNumber(argv[++i]) * 1000000;
+    }
+    else if (!strcmp(argv[i], "--connect-ms") and hasValue)
+    {
+      connectMillis = parseNumber(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--dht-errors") and hasValue)
+    {
+      sim::setDhtErrors(parseNumber(argv[++i]));
+    }
+    else if (!strcmp(argv[i], "--adc-noise") and hasValue)
+    {
+      adcNoise = parseNumber(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--no-alloc"))
+    {
+      noAlloc = true;
+    }
+    else if (!strcmp(argv[i], "--record") and hasValue)
+    {
+      recordPath = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--sleep"))
+    {
+      sleep = true;
+    }
+    else if (!strcmp(argv[i], "--wake-us") and hasValue)
+    {
+      wakeMicros = parseNumber(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "--eeprom") and hasValue)
+    {
+      eepromPath = argv[++i];
+    }
+    else if (!strcmp(argv[i], "--epoch") and hasValue)
+    {
+      sim::setEpoch(parseNumber(argv[++i]));
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [--loops N] [--step-us N] [--flood-at S] [--dry-at S] [--dryer-at S] [--call-at S F A] [--offline S1 S2] [--connect-ms N] [--dht-errors N] [--adc-noise N] [--verbose] [--no-alloc] [--record FILE] [--sleep] [--wake-us N] [--eeprom FILE] [--epoch T]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  std::stable_sort(calls.begin(), calls.end(), [](const CloudCall &a, const CloudCall &b) { return a.at < b.at; });
+
+  // idle house: garage closed (D4 reed switch active), no water on D7
+  sim::setDigital(D4, LOW);
+  sim::setDigital(D5, HIGH);
+  sim::setDigital(D7, HIGH);
+  sim::setAnalog(A0, 2048);
+  sim::setAnalogNoise(A0, adcNoise);
+  sim::setDht(22, 45);
+  sim::onPublish(recordPublish);
+
+  // the device boots at 0, the firmware starts once the system let it
+  sim::setConnectDelay(connectMillis);
+  if (sim::systemMode() == AUTOMATIC and not sim::systemThread())
+  {
+    sim::advanceMillis(connectMillis);
+  }
+
+  if (recordPath)
+  {
+    traceFile = fopen(recordPath, "w");
+    if (traceFile == nullptr)
+    {
+      perror(recordPath);
+      return 2;
+    }
+    trace.header(traceLine, sizeof(traceLine), Time.now());
+    fprintf(traceFile, "%s\n", traceLine);
+    trace.digital(sim::nowMicros(), D4, sim::digitalOutput(D4));
+    trace.digital(sim::nowMicros(), D5, sim::digitalOutput(D5));
+    trace.digital(sim::nowMicros(), D7, sim::digitalOutput(D7));
+    trace.cloud(sim::nowMicros(), Particle.connected());
+    sim::onInput(recordInput);
+  }
+
+  if (eepromPath and sim::loadEeprom(eepromPath))
+  {
+    printf("EEPROM loaded from %s\n", eepromPath);
+  }
+
+  setup();
+
+  auto wallStart = std::chrono::steady_clock::now();
+  uint64_t virtualStart = 0;
+  uint64_t cloudConnectedAt = UINT64_MAX;
+  float celsius, humidity;
+  uint64_t longestPass = 0;
+  uint16_t mostStored = 0;
+  GarageDoor door;
+  // heap allocations made by loop() during the first virtual minute, the rest is steady state
+  const uint64_t warmUpMicros = 60000000;
+  unsigned long warmUpAllocations = 0;
+  bool warmedUp = false;
+
+  uint64_t sleptMicros = 0;
+  unsigned long sleeps = 0;
+  unsigned long pinWakeUps = 0;
+
+  // the outside world at this instant: water, dryer, garage door, cloud, function calls
+  //  returns true if a cloud function was called, that wakes up a sleeping device
+  auto inputs = [&](uint64_t now) {
+    if (floodAt >= 0)
+    {
+      sim::setDigital(D7, ((long long)now >= floodAt and (dryAt < 0 or (long long)now < dryAt)) ? LOW : HIGH);
+    }
+    if (dryerAt >= 0)
+    {
+      dryerProfile(((long long)now - dryerAt) / 1e6, celsius, humidity);
+      sim::setDht(celsius, humidity);
+    }
+
+    door.step(now);
+
+    // only the changes, the system may not have connected yet
+    if (offlineFrom >= 0 and offline != ((long long)now >= offlineFrom and (long long)now < offlineTo))
+    {
+      offline = not offline;
+      sim::setConnected(not offline);
+    }
+
+    bool called = false;
+    while (nextCall < calls.size() and (long long)now >= calls[nextCall].at)
+    {
+      const CloudCall &call = calls[nextCall++];
+      if (traceFile)
+      {
+        writeTrace();
+        trace.callLine(traceLine, sizeof(traceLine), now, call.function, call.argument);
+        fprintf(traceFile, "%s\n", traceLine);
+      }
+      int result = sim::callFunction(call.function, call.argument);
+      if (verbose)
+      {
+        printf("%10.3fs  %s(\"%s\") returned %d\n", now / 1e6, call.function, call.argument, result);
+      }
+      called = true;
+    }
+    return called;
+  };
+
+  // the firmware asked to sleep: move the clock until the time is up or a wake-up pin changes
+  auto sleepFor = [&](const SystemSleepConfiguration &request) {
+    int levels[SYSTEM_SLEEP_MAX_PINS];
+    for (uint8_t p = 0; p < request.pinCount; p++)
+    {
+      levels[p] = sim::digitalOutput(request.pins[p]);
+    }
+    uint64_t start = sim::nowMicros();
+    uint64_t end = start + request.durationMillis * 1000ULL;
+    sleeps++;
+    while (sim::nowMicros() < end)
+    {
+      sim::advanceMicros(std::min<uint64_t>(stepMicros, end - sim::nowMicros()));
+      bool woken = inputs(sim::nowMicros());
+      for (uint8_t p = 0; p < request.pinCount; p++)
+      {
+        if (sim::digitalOutput(request.pins[p]) != levels[p])
+        {
+          woken = true;
+          pinWakeUps++;
+          break;
+        }
+      }
+      if (traceFile)
+      {
+        writeTrace();
+      }
+      if (woken)
+      {
+        break;
+      }
+    }
+    // a sleep shorter than the cost of waking up saved nothing
+    uint64_t slept = sim::nowMicros() - start;
+    sleptMicros += slept > wakeMicros ? slept - wakeMicros : 0;
+  };
+
+  for (unsigned long long i = 0; i < loops; i++)
+  {
+    uint64_t now = sim::nowMicros();
+    inputs(now);
+    if (cloudConnectedAt == UINT64_MAX and Particle.connected())
+    {
+      cloudConnectedAt = now;
+    }
+
+    if (not warmedUp and now - virtualStart >= warmUpMicros)
+    {
+      warmUpAllocations = sim::allocationCount();
+      warmedUp = true;
+    }
+
+    uint64_t passStart = sim::nowMicros();
+    sim::countAllocations(true);
+    // the sensor thread first when it is due, it has a higher priority than loop()
+    sim::runThreads();
+    loop();
+    if (sleep)
+    {
+      power_sleep();
+    }
+    sim::countAllocations(false);
+    // time spent blocked inside loop() (delay(), blocking sensor reads...)
+    uint64_t pass = sim::nowMicros() - passStart;
+    if (pass > longestPass)
+    {
+      longestPass = pass;
+    }
+    if (publishQueue.stored() > mostStored)
+    {
+      mostStored = publishQueue.stored();
+    }
+    // the sleep starts where loop() asked for it, instead of the step to the next pass
+    SystemSleepConfiguration request;
+    if (sim::takeSleepRequest(request))
+    {
+      sleepFor(request);
+    }
+    else
+    {
+      sim::advanceMicros(stepMicros);
+    }
+    if (traceFile)
+    {
+      writeTrace();
+    }
+  }
+  if (traceFile)
+  {
+    writeTrace();
+    fclose(traceFile);
+  }
+
+  if (eepromPath and not sim::saveEeprom(eepromPath))
+  {
+    perror(eepromPath);
+  }
+
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  double virtualSeconds = (sim::nowMicros() - virtualStart) / 1e6;
+
+  printf("loop() passes    : %llu\n", loops);
+  printf("virtual time     : %.1f s (%.2f h)\n", virtualSeconds, virtualSeconds / 3600);
+  printf("wall time        : %.3f s\n", wallSeconds);
+  printf("passes per second: %.0f\n", wallSeconds > 0 ? loops / wallSeconds : 0);
+  printf("ns per pass      : %.1f\n", loops ? wallSeconds * 1e9 / loops : 0);
+  printf("longest pass     : %.3f ms virtual\n", longestPass / 1e3);
+  printf("clock at the end : %ld (unix time)\n", (long)Time.now());
+  const char *modes[] = {"AUTOMATIC", "SEMI_AUTOMATIC", "MANUAL"};
+  printf("boot             : %s%s, first read of D7 %.3f s after the reset, cloud connected at %.3f s\n",
+         modes[sim::systemMode()], sim::systemThread() ? " with the system thread" : "",
+         sim::firstReadMicros(D7) == UINT64_MAX ? -1.0 : sim::firstReadMicros(D7) / 1e6,
+         cloudConnectedAt == UINT64_MAX ? -1.0 : cloudConnectedAt / 1e6);
+  printf("EEPROM bytes     : %lu written\n", sim::eepromWriteCount());
+  printf("awake            : %.2f%% of the time (%lu sleeps, %lu woken up by a pin)\n",
+         virtualSeconds > 0 ? 100 - sleptMicros / 1e4 / virtualSeconds : 100.0, sleeps, pinWakeUps);
+  if (floodAt >= 0 and firstFloodAlarm >= 0)
+  {
+    printf("first flood alarm: %.3f s after the water showed up\n", (firstFloodAlarm - floodAt) / 1e6);
+  }
+  unsigned long steadyAllocations = warmedUp ? sim::allocationCount() - warmUpAllocations : 0;
+  printf("heap allocations : %lu in loop(), %lu after the first minute\n", sim::allocationCount(), steadyAllocations);
+  printf("garage door      : %s (firmware says %s)\n", door.status(), garageStatusName(garage_whatIsTheStatus()));
+  printf("publishes        : %lu\n", sim::publishCount());
+  printf("lost (rate limit): %lu\n", sim::rateLimitedCount());
+  printf("publish store    : %u of %u bytes at most, %lu events dropped\n", mostStored, PUBLISH_STORE_SIZE,
+         (unsigned long)publishQueue.dropped());
+  for (const auto &event : publishesByEvent)
+  {
+    printf("  %-20s %lu\n", event.first.c_str(), event.second);
+  }
+  printf("cloud variables  :\n");
+  for (const std::string &name : sim::variableNames())
+  {
+    std::string value;
+    sim::readVariable(name.c_str(), value);
+    printf("  %-12s = %s\n", name.c_str(), value.c_str());
+  }
+
+  return noAlloc and steadyAllocations > 0 ? 1 : 0;
+}
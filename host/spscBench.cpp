@@ -0,0 +1,152 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Throughput of the lock-free ring (src/spscRing.h) between two threads, the way the sensor thread
+//   hands its SensorMessages to loop(). The producer pushes as fast as it can and yields while the
+//   ring is full, the consumer pops, yields while it is empty, and checks every message arrives once
+//   and in order. The waits are counted: on one core every one of them is a thread switch.
+//  The same run goes through a std::deque behind a std::mutex, the queue a lock would give.
+//  Host threads on several cores say little about the device, where the two threads share one core:
+//   this is about the cost of the queue itself, and about it never losing or reordering a message.
+//
+//  usage: spscBench [messages per run]   (default 10000000)
+
+#include "sensorRegistry.h"
+#include "spscRing.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+
+SensorMessage makeMessage(uint32_t sequence)
+{
+  SensorMessage message;
+  message.index = sequence & 0xff;
+  message.event = SENSOR_READING;
+  message.reading = DHT_READ_OK;
+  message.status = (int)sequence;
+  message.celsius = 20;
+  message.humidity = 40;
+  return message;
+}
+
+// the queue with a lock, same interface as the ring
+class LockedQueue
+{
+public:
+  bool push(const SensorMessage &message)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    items.push_back(message);
+    return true;
+  }
+  bool pop(SensorMessage &message)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (items.empty())
+    {
+      return false;
+    }
+    message = items.front();
+    items.pop_front();
+    return true;
+  }
+
+private:
+  std::mutex mutex;
+  std::deque<SensorMessage> items;
+};
+
+struct Result
+{
+  double messagesPerSecond;
+  unsigned long fullWaits;
+  unsigned long emptyWaits;
+  bool inOrder;
+};
+
+template <typename Queue>
+Result run(Queue &queue, uint32_t messages)
+{
+  Result result = {0, 0, 0, true};
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer([&]() {
+    for (uint32_t i = 0; i < messages; i++)
+    {
+      SensorMessage message = makeMessage(i);
+      while (not queue.push(message))
+      {
+        result.fullWaits++;
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  SensorMessage message;
+  for (uint32_t expected = 0; expected < messages;)
+  {
+    if (not queue.pop(message))
+    {
+      result.emptyWaits++;
+      std::this_thread::yield();
+      continue;
+    }
+    if (message.status != (int)expected or message.index != (expected & 0xff))
+    {
+      result.inOrder = false;
+    }
+    expected++;
+  }
+  producer.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.messagesPerSecond = messages / seconds;
+  return result;
+}
+
+void print(const char *queue, const Result &result)
+{
+  printf("%-16s %8.1f  %8.1f  %10lu  %11lu  %s\n", queue, result.messagesPerSecond / 1e6, 1e9 / result.messagesPerSecond,
+         result.fullWaits, result.emptyWaits, result.inOrder ? "ok" : "LOST OR REORDERED");
+}
+
+template <uint16_t SIZE>
+bool runRing(uint32_t messages)
+{
+  static SpscRing<SensorMessage, SIZE> ring;
+  Result result = run(ring, messages);
+  char name[32];
+  snprintf(name, sizeof(name), "SpscRing<%u>", SIZE);
+  print(name, result);
+  return result.inOrder;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  uint32_t messages = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10000000;
+
+  printf("%u messages of %u bytes, producer and consumer on their own thread\n", messages,
+         (unsigned)sizeof(SensorMessage));
+  printf("queue              Mmsg/s    ns/msg  full waits  empty waits  order\n");
+
+  bool ok = true;
+  ok &= runRing<16>(messages);
+  ok &= runRing<256>(messages);
+  ok &= runRing<4096>(messages);
+
+  LockedQueue locked;
+  Result result = run(locked, messages);
+  print("mutex + deque", result);
+  ok &= result.inOrder;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  TCPServer and TCPClient of the host-side Particle stand-in, on POSIX sockets.
+//  The server only listens on the loopback interface: this is for load tests on the host, not a LAN.
+
+#include "Particle.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+uint8_t TCPClient::connected()
+{
+  if (sock < 0)
+  {
+    return false;
+  }
+  // like on Device OS, data that is in counts as connected even if the other side closed
+  char c;
+  ssize_t peeked = recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return peeked > 0 or (peeked < 0 and (errno == EAGAIN or errno == EWOULDBLOCK));
+}
+
+int TCPClient::available()
+{
+  int count = 0;
+  if (sock < 0 or ioctl(sock, FIONREAD, &count) < 0)
+  {
+    return 0;
+  }
+  return count;
+}
+
+int TCPClient::read()
+{
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int TCPClient::read(uint8_t *buffer, size_t size)
+{
+  if (sock < 0)
+  {
+    return -1;
+  }
+  ssize_t received = recv(sock, buffer, size, MSG_DONTWAIT);
+  return received > 0 ? (int)received : -1;
+}
+
+size_t TCPClient::write(const uint8_t *buffer, size_t size)
+{
+  if (sock < 0)
+  {
+    return 0;
+  }
+  size_t sent = 0;
+  while (sent < size)
+  {
+    ssize_t written = send(sock, buffer + sent, size - sent, MSG_NOSIGNAL);
+    if (written <= 0)
+    {
+      break;
+    }
+    sent += written;
+  }
+  return sent;
+}
+
+void TCPClient::stop()
+{
+  if (sock >= 0)
+  {
+    close(sock);
+    sock = -1;
+  }
+}
+
+bool TCPServer::begin()
+{
+  stop();
+  sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0)
+  {
+    return false;
+  }
+  int on = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(sock, (sockaddr *)&address, sizeof(address)) < 0 or listen(sock, 8) < 0)
+  {
+    stop();
+    return false;
+  }
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+  return true;
+}
+
+TCPClient TCPServer::available()
+{
+  if (sock < 0)
+  {
+    return TCPClient();
+  }
+  int client = accept(sock, nullptr, nullptr);
+  if (client < 0)
+  {
+    return TCPClient();
+  }
+  int on = 1;
+  setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  return TCPClient(client);
+}
+
+void TCPServer::stop()
+{
+  if (sock >= 0)
+  {
+    close(sock);
+    sock = -1;
+  }
+}
@@ -0,0 +1,140 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Host benchmark of the pool thermistor conversion: the float beta formula the firmware used
+//   to run on every reading against the compile-time table of src/thermistorTable.h.
+//  Both are checked against the formula in double precision for every 12 bit ADC value.
+//
+//  usage: thermistorBench [rounds]   (default 2000 sweeps of the 4096 ADC values)
+
+#include "thermistorTable.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// same parts as the firmware
+#define THERMISTORNOMINAL 10000
+#define TEMPERATURENOMINAL 25
+#define BCOEFFICIENT 3950
+#define SERIESRESISTOR 10000
+
+typedef ThermistorTable<TemperatureUnit::CELSIUS, THERMISTORNOMINAL, TEMPERATURENOMINAL, BCOEFFICIENT, SERIESRESISTOR> PoolTable;
+
+namespace
+{
+
+// the conversion as it was in pool_calculate_current_temp()
+float floatFormula(float average)
+{
+  average = (4095 / average) - 1;
+  average = SERIESRESISTOR / average;
+
+  float steinhart;
+  steinhart = average / THERMISTORNOMINAL;
+  steinhart = log(steinhart);
+  steinhart /= BCOEFFICIENT;
+  steinhart += 1.0 / (TEMPERATURENOMINAL + 273.15);
+  steinhart = 1.0 / steinhart;
+  steinhart -= 273.15;
+  return steinhart;
+}
+
+// the same formula in double precision, no clamping
+double reference(int adc)
+{
+  double ohms = (double)SERIESRESISTOR * adc / (4095 - adc);
+  double inverseKelvin = ::log(ohms / THERMISTORNOMINAL) / BCOEFFICIENT + 1.0 / (TEMPERATURENOMINAL + 273.15);
+  return 1.0 / inverseKelvin - 273.15;
+}
+
+struct ErrorBound
+{
+  double maxTable = 0;
+  double maxFloat = 0;
+  int worstTableAdc = 0;
+  int adcCount = 0;
+};
+
+// worst error of both methods over the ADC values whose temperature falls in [low, high]
+ErrorBound errorBetween(double low, double high)
+{
+  ErrorBound bound;
+  for (int adc = 1; adc < 4095; adc++)
+  {
+    double exact = reference(adc);
+    if (exact < low or exact > high)
+    {
+      continue;
+    }
+    bound.adcCount++;
+    double tableError = fabs(PoolTable::centi(adc) / 100.0 - exact);
+    double floatError = fabs(floatFormula(adc) - exact);
+    if (tableError > bound.maxTable)
+    {
+      bound.maxTable = tableError;
+      bound.worstTableAdc = adc;
+    }
+    if (floatError > bound.maxFloat)
+    {
+      bound.maxFloat = floatError;
+    }
+  }
+  return bound;
+}
+
+template <typename Convert>
+double nanosPerConversion(unsigned rounds, Convert convert)
+{
+  volatile double sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned round = 0; round < rounds; round++)
+  {
+    double sum = 0;
+    for (int adc = 1; adc < 4095; adc++)
+    {
+      sum += convert(adc);
+    }
+    sink = sink + sum;
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return seconds * 1e9 / ((double)rounds * 4094);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  unsigned rounds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000;
+
+  printf("table            : %d entries, one every %d ADC counts, %zu bytes\n",
+         THERMISTOR_TABLE_ENTRIES, THERMISTOR_TABLE_STEP, THERMISTOR_TABLE_ENTRIES * sizeof(int16_t));
+
+  struct
+  {
+    const char *name;
+    double low;
+    double high;
+  } ranges[] = {
+      {"pool (0..40 C)", 0, 40},
+      {"-20..100 C", -20, 100},
+      {"full (-55..150 C)", THERMISTOR_MIN_CELSIUS, THERMISTOR_MAX_CELSIUS},
+  };
+  printf("max error vs double formula:\n");
+  for (const auto &range : ranges)
+  {
+    ErrorBound bound = errorBetween(range.low, range.high);
+    printf("  %-18s %4d ADC values  table %.3f C (worst at ADC %d)  float formula %.4f C\n",
+           range.name, bound.adcCount, bound.maxTable, bound.worstTableAdc, bound.maxFloat);
+  }
+
+  double floatNanos = nanosPerConversion(rounds, [](int adc) { return (double)floatFormula(adc); });
+  double tableNanos = nanosPerConversion(rounds, [](int adc) { return PoolTable::centi(adc) / 100.0; });
+  printf("float formula    : %.2f ns per conversion\n", floatNanos);
+  printf("table            : %.2f ns per conversion (%.1fx)\n", tableNanos, floatNanos / tableNanos);
+
+  return 0;
+}
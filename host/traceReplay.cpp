@@ -0,0 +1,368 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Replays a sensor trace (see src/sensorTrace.h) through the unmodified setup()/loop() of
+//   src/homeCommander.ino and checks that the firmware publishes the same events, with the same data,
+//   at the same time as when the trace was recorded.
+//  The trace comes from the device (SENSOR_TRACE 1, "particle serial monitor > house.trace")
+//   or from homeCommanderSim --record.
+//
+//  Readings are handed to the stand-in HAL in the order the firmware took them: pool thermistor values
+//   go to the analogRead() queue, DHT22 results and failures to the acquisition queue, pin levels,
+//   cloud connection changes and cloud function calls are applied at their time.
+//  Between records the virtual clock jumps to the next scheduler deadline (loop_idleMillis()), so a
+//   week of the house runs in seconds.
+//
+//  usage: traceReplay [--step-us N] [--tolerance-ms N] [--verbose] FILE
+//    --step-us N       loop() ran every N virtual microseconds when the trace was recorded in the
+//                      simulator (default 1000, same as homeCommanderSim)
+//    --tolerance-ms N  a publish matches if it comes at most N ms away from the recorded one (default 0),
+//                      device traces need some since loop() did not run on a fixed grid there
+//    --verbose         print every publish of the replay
+//  exits with 1 on the first publish that does not match
+
+#include "Particle.h"
+#include "scheduler.h"
+#include "sensorTrace.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <deque>
+#include <string>
+
+void setup();
+void loop();
+unsigned long loop_idleMillis();
+
+namespace
+{
+
+struct Publish
+{
+  uint64_t atMicros;
+  std::string name;
+  std::string data;
+};
+
+struct Record
+{
+  uint64_t atMicros;
+  char kind;
+  int pin;
+  int first;
+  int second;
+  // name and argument/data of calls and publishes
+  std::string name;
+  std::string text;
+};
+
+uint64_t stepMicros = 1000;
+uint64_t toleranceMicros = 0;
+bool verbose = false;
+
+std::deque<Publish> recorded;
+std::deque<Publish> replayed;
+unsigned long matched = 0;
+uint64_t maxSkew = 0;
+bool mismatch = false;
+
+void printPublish(const char *label, const Publish &publish)
+{
+  printf("  %-9s %12.3fs  %s  %s\n", label, publish.atMicros / 1e6, publish.name.c_str(), publish.data.c_str());
+}
+
+// pairs recorded and replayed publishes in order, stops at the first difference
+void compare()
+{
+  while (not mismatch and not recorded.empty() and not replayed.empty())
+  {
+    const Publish &expected = recorded.front();
+    const Publish &actual = replayed.front();
+    uint64_t skew = expected.atMicros > actual.atMicros ? expected.atMicros - actual.atMicros : actual.atMicros - expected.atMicros;
+    if (expected.name != actual.name or expected.data != actual.data or skew > toleranceMicros)
+    {
+      printf("mismatch at publish %lu:\n", matched + 1);
+      printPublish("recorded", expected);
+      printPublish("replayed", actual);
+      mismatch = true;
+      return;
+    }
+    if (skew > maxSkew)
+    {
+      maxSkew = skew;
+    }
+    matched++;
+    recorded.pop_front();
+    replayed.pop_front();
+  }
+}
+
+void replayPublish(uint64_t atMicros, const char *eventName, const char *eventData)
+{
+  if (verbose)
+  {
+    printf("%10.3fs  %s  %s\n", atMicros / 1e6, eventName, eventData);
+  }
+  replayed.push_back({atMicros, eventName, eventData});
+  compare();
+}
+
+// runs loop() until the virtual clock gets to atMicros, skipping the time the firmware has nothing to do
+//  passes stay on the step grid the recording used, so scheduled tasks run at the same micros()
+void runUntil(uint64_t atMicros)
+{
+  while (not mismatch and sim::nowMicros() < atMicros)
+  {
+    sim::runThreads();
+    loop();
+    uint64_t now = sim::nowMicros();
+    uint64_t next = now + stepMicros;
+    unsigned long idle = loop_idleMillis();
+    if (idle != SCHEDULER_NEVER)
+    {
+      uint64_t deadline = ((uint64_t)millis() + idle) * 1000;
+      if (deadline > next)
+      {
+        next = deadline;
+      }
+    }
+    else
+    {
+      next = atMicros;
+    }
+    // a thread that wakes up before then gets its pass at the same time as in the recording
+    uint64_t wake = sim::nextThreadWakeMicros();
+    if (wake > now and wake < next)
+    {
+      next = wake;
+    }
+    next = (next + stepMicros - 1) / stepMicros * stepMicros;
+    sim::advanceMicros((next < atMicros ? next : atMicros) - now);
+  }
+}
+
+// "<dt> <kind> ...", false for lines that are not records (e.g. what the serial monitor prints)
+bool parseRecord(char *line, uint64_t &clock, Record &record)
+{
+  char *rest;
+  long dt = strtol(line, &rest, 10);
+  if (rest == line or rest[0] != ' ' or rest[1] == 0 or rest[2] != ' ')
+  {
+    return false;
+  }
+  record.kind = rest[1];
+  rest += 3;
+
+  switch (record.kind)
+  {
+  case TRACE_DIGITAL:
+  case TRACE_ANALOG:
+    record.pin = strtol(rest, &rest, 10);
+    record.first = strtol(rest, &rest, 10);
+    break;
+  case TRACE_DHT:
+    record.first = strtol(rest, &rest, 10);
+    record.second = strtol(rest, &rest, 10);
+    break;
+  case TRACE_DHT_ERROR:
+  case TRACE_CLOUD:
+    record.first = strtol(rest, &rest, 10);
+    break;
+  case TRACE_CALL:
+  case TRACE_PUBLISH:
+  {
+    char *tab = strchr(rest, '\t');
+    if (tab == nullptr)
+    {
+      return false;
+    }
+    record.name.assign(rest, tab - rest);
+    record.text.assign(tab + 1);
+    break;
+  }
+  default:
+    return false;
+  }
+
+  // dt is micros() - previous micros() on 32 bits, a record queued a bit late comes out negative
+  clock += (int32_t)(uint32_t)dt;
+  record.atMicros = clock;
+  return true;
+}
+
+bool readLine(FILE *file, char *line, size_t size)
+{
+  if (fgets(line, size, file) == nullptr)
+  {
+    return false;
+  }
+  line[strcspn(line, "\r\n")] = 0;
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const char *path = nullptr;
+  for (int i = 1; i < argc; i++)
+  {
+    bool hasValue = i + 1 < argc;
+    if (!strcmp(argv[i], "--step-us") and hasValue)
+    {
+      stepMicros = strtoull(argv[++i], nullptr, 10);
+    }
+    else if (!strcmp(argv[i], "--tolerance-ms") and hasValue)
+    {
+      toleranceMicros = strtoull(argv[++i], nullptr, 10) * 1000;
+    }
+    else if (!strcmp(argv[i], "--verbose"))
+    {
+      verbose = true;
+    }
+    else if (argv[i][0] != '-' and path == nullptr)
+    {
+      path = argv[i];
+    }
+    else
+    {
+      path = nullptr;
+      break;
+    }
+  }
+  if (path == nullptr or stepMicros == 0)
+  {
+    fprintf(stderr, "usage: %s [--step-us N] [--tolerance-ms N] [--verbose] FILE\n", argv[0]);
+    return 2;
+  }
+
+  FILE *file = fopen(path, "r");
+  if (file == nullptr)
+  {
+    perror(path);
+    return 2;
+  }
+
+  // the header can come after whatever the serial monitor printed first
+  char line[SENSOR_TRACE_LINE_MAX + 64];
+  unsigned version = 0;
+  unsigned long epoch = 0;
+  while (readLine(file, line, sizeof(line)))
+  {
+    if (sscanf(line, "homeCommander-trace %u %lu", &version, &epoch) == 2)
+    {
+      break;
+    }
+  }
+  if (version != SENSOR_TRACE_VERSION)
+  {
+    fprintf(stderr, "%s: no homeCommander-trace %d header\n", path, SENSOR_TRACE_VERSION);
+    return 2;
+  }
+
+  sim::setEpoch(epoch);
+  sim::onPublish(replayPublish);
+  // the cloud is up and down when the trace says so, a Particle.connect() of the firmware never gets through
+  sim::setConnectDelay(UINT32_MAX);
+
+  auto wallStart = std::chrono::steady_clock::now();
+  unsigned long records = 0;
+  unsigned long skipped = 0;
+  unsigned long calls = 0;
+  uint64_t clock = 0;
+  bool started = false;
+  Record record;
+
+  while (not mismatch and readLine(file, line, sizeof(line)))
+  {
+    if (not parseRecord(line, clock, record))
+    {
+      skipped++;
+      continue;
+    }
+    records++;
+
+    // the pin levels and cloud state the trace starts with are there before setup()
+    if (not started and record.kind != TRACE_DIGITAL and record.kind != TRACE_CLOUD)
+    {
+      setup();
+      started = true;
+    }
+
+    switch (record.kind)
+    {
+    case TRACE_ANALOG:
+      sim::queueAnalog(record.pin, record.first);
+      break;
+    case TRACE_DHT:
+      sim::queueDht(record.first / 100.0f, record.second / 100.0f);
+      break;
+    case TRACE_DHT_ERROR:
+      sim::queueDhtError(record.first);
+      break;
+    case TRACE_PUBLISH:
+      recorded.push_back({record.atMicros, record.name, record.text});
+      compare();
+      break;
+    case TRACE_DIGITAL:
+      runUntil(record.atMicros);
+      sim::setDigital(record.pin, record.first);
+      break;
+    case TRACE_CLOUD:
+      runUntil(record.atMicros);
+      sim::setConnected(record.first);
+      break;
+    case TRACE_CALL:
+      runUntil(record.atMicros);
+      sim::callFunction(record.name.c_str(), record.text.c_str());
+      calls++;
+      break;
+    }
+  }
+  fclose(file);
+
+  if (not started)
+  {
+    setup();
+  }
+  // the last pass ran at the time of the last record, unless that record is a pool sample: the timer
+  //  takes those while the clock moves, after the pass
+  runUntil(clock);
+  if (not mismatch and records and record.kind != TRACE_ANALOG)
+  {
+    sim::runThreads();
+    loop();
+  }
+
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  double virtualSeconds = sim::nowMicros() / 1e6;
+
+  printf("trace            : %lu records, %lu cloud function calls, %lu other lines skipped\n", records, calls, skipped);
+  printf("replayed         : %.1f virtual hours in %.2f wall seconds (%.0fx real time)\n",
+         virtualSeconds / 3600, wallSeconds, wallSeconds > 0 ? virtualSeconds / wallSeconds : 0.0);
+  printf("publishes        : %lu matched, largest time difference %.3f ms\n", matched, maxSkew / 1e3);
+
+  if (not mismatch and (not recorded.empty() or not replayed.empty()))
+  {
+    printf("mismatch after publish %lu:\n", matched);
+    if (not recorded.empty())
+    {
+      printPublish("recorded", recorded.front());
+      printf("  (replay published nothing more, %zu recorded left)\n", recorded.size());
+    }
+    else
+    {
+      printPublish("replayed", replayed.front());
+      printf("  (not in the trace, %zu more replayed)\n", replayed.size());
+    }
+    mismatch = true;
+  }
+
+  return mismatch ? 1 : 0;
+}
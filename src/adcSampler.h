@@ -0,0 +1,92 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Background oversampling of an analog input.
+//  sample() is meant to be called from a software Timer: it reads the pin once and keeps the
+//   last SIZE readings in a circular window, so loop() never waits for the ADC.
+//  filtered() sorts a copy of the window and averages what's left after dropping the
+//   trimPercent lowest and highest readings, so a few spikes don't move the result.
+//   A trim of 50 gives the median.
+
+#pragma once
+
+#include "Particle.h"
+
+#include <algorithm>
+
+template <uint16_t SIZE>
+class AdcSampler
+{
+  static_assert(SIZE >= 1, "AdcSampler needs at least one sample");
+
+public:
+  AdcSampler(pin_t pin) : pin(pin), next(0), count(0) {}
+
+  // timer side, returns the reading
+  uint16_t sample()
+  {
+    uint16_t value = analogRead(pin);
+    ATOMIC_BLOCK()
+    {
+      window[next] = value;
+      next = (next + 1) % SIZE;
+      if (count < SIZE)
+      {
+        count++;
+      }
+    }
+    return value;
+  }
+
+  // loop() side
+  bool ready() const { return count == SIZE; }
+
+  void reset()
+  {
+    ATOMIC_BLOCK()
+    {
+      next = 0;
+      count = 0;
+    }
+  }
+
+  float filtered(uint8_t trimPercent)
+  {
+    uint16_t n;
+    ATOMIC_BLOCK()
+    {
+      n = count;
+      memcpy(sorted, window, n * sizeof(uint16_t));
+    }
+    if (n == 0)
+    {
+      return 0;
+    }
+
+    std::sort(sorted, sorted + n);
+
+    uint16_t drop = (uint32_t)n * (trimPercent > 50 ? 50 : trimPercent) / 100;
+    if (2 * drop >= n)
+    {
+      // nothing left but the middle: median
+      return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0f;
+    }
+
+    uint32_t sum = 0;
+    for (uint16_t i = drop; i < n - drop; i++)
+    {
+      sum += sorted[i];
+    }
+    return (float)sum / (n - 2 * drop);
+  }
+
+private:
+  pin_t pin;
+  // only touched inside ATOMIC_BLOCK, except count which ready() peeks at
+  uint16_t window[SIZE];
+  uint16_t next;
+  volatile uint16_t count;
+  uint16_t sorted[SIZE];
+};
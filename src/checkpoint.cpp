@@ -0,0 +1,147 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "checkpoint.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define CHECKPOINT_MAGIC 0x43484b50UL
+
+namespace
+{
+
+// CRC-32 (IEEE 802.3), a nibble at a time: a 16 entry table instead of 256
+uint32_t crc32(const uint8_t *data, size_t length)
+{
+  static const uint32_t table[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+      0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+  };
+  uint32_t crc = 0xffffffff;
+  for (size_t i = 0; i < length; i++)
+  {
+    crc = table[(crc ^ data[i]) & 0x0f] ^ (crc >> 4);
+    crc = table[(crc ^ (data[i] >> 4)) & 0x0f] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+// everything up to the crc, the unused end of the payload included
+uint32_t recordCrc(const CheckpointRecord &record)
+{
+  return crc32((const uint8_t *)&record, offsetof(CheckpointRecord, crc));
+}
+
+} // namespace
+
+Checkpoint::Checkpoint(CheckpointRecord &retainedRecord, uint16_t version, int eepromAddress, uint8_t slots)
+    : record(retainedRecord), version(version), eepromAddress(eepromAddress), slots(slots), nextSlot(0), sequence(0),
+      dirty(false), writes(0)
+{
+}
+
+/*******************************************************************************
+ * Function Name  : restore
+ * Description    : copies the latest valid snapshot into state: the retained one, unless the EEPROM
+                    has a newer one (the retained RAM lost power, or the new firmware moved it)
+ * Return         : where the snapshot came from, CHECKPOINT_NONE (state untouched) if there is none
+ *******************************************************************************/
+CheckpointSource Checkpoint::restore(void *state, size_t length)
+{
+  // the newest EEPROM slot, the next write goes to the one after it
+  CheckpointRecord slot;
+  int8_t newest = -1;
+  uint32_t newestSequence = 0;
+  for (uint8_t i = 0; i < slots; i++)
+  {
+    EEPROM.get(slotAddress(i), slot);
+    if (valid(slot) and (newest < 0 or (int32_t)(slot.sequence - newestSequence) > 0))
+    {
+      newest = i;
+      newestSequence = slot.sequence;
+    }
+  }
+  nextSlot = newest < 0 ? 0 : (newest + 1) % slots;
+
+  CheckpointSource source = CHECKPOINT_NONE;
+  if (valid(record) and (newest < 0 or (int32_t)(record.sequence - newestSequence) >= 0))
+  {
+    source = CHECKPOINT_RETAINED;
+    // saved after the last flush: the EEPROM is behind
+    dirty = newest < 0 or record.sequence != newestSequence;
+  }
+  else if (newest >= 0)
+  {
+    EEPROM.get(slotAddress(newest), record);
+    source = CHECKPOINT_EEPROM;
+  }
+
+  if (source == CHECKPOINT_NONE or record.length != length)
+  {
+    // nothing to take, the next save() starts over
+    record.magic = 0;
+    dirty = false;
+    return CHECKPOINT_NONE;
+  }
+  sequence = record.sequence;
+  memcpy(state, record.payload, length);
+  return source;
+}
+
+/*******************************************************************************
+ * Function Name  : save
+ * Description    : writes the state into the retained record if it changed, flush() takes it
+                    to the EEPROM later; not this one alone when persist is false
+ *******************************************************************************/
+void Checkpoint::save(const void *state, size_t length, bool persist)
+{
+  if (length > CHECKPOINT_PAYLOAD_MAX)
+  {
+    return;
+  }
+  if (record.magic == CHECKPOINT_MAGIC and record.length == length and memcmp(record.payload, state, length) == 0)
+  {
+    return;
+  }
+
+  record.magic = CHECKPOINT_MAGIC;
+  record.version = version;
+  record.length = length;
+  record.sequence = ++sequence;
+  memcpy(record.payload, state, length);
+  memset(record.payload + length, 0, CHECKPOINT_PAYLOAD_MAX - length);
+  record.crc = recordCrc(record);
+  dirty = dirty or persist;
+}
+
+/*******************************************************************************
+ * Function Name  : flush
+ * Description    : writes the last save() to the next EEPROM slot, if the EEPROM does not have it yet
+ * Return         : true if the EEPROM was written
+ *******************************************************************************/
+bool Checkpoint::flush()
+{
+  if (not dirty)
+  {
+    return false;
+  }
+  EEPROM.put(slotAddress(nextSlot), record);
+  nextSlot = (nextSlot + 1) % slots;
+  dirty = false;
+  writes++;
+  return true;
+}
+
+bool Checkpoint::valid(const CheckpointRecord &record) const
+{
+  return record.magic == CHECKPOINT_MAGIC and record.version == version and
+         record.length <= CHECKPOINT_PAYLOAD_MAX and record.crc == recordCrc(record);
+}
+
+int Checkpoint::slotAddress(uint8_t slot) const
+{
+  return eepromAddress + slot * sizeof(CheckpointRecord);
+}
@@ -0,0 +1,72 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Snapshot of the state the firmware must not lose across a reset (firmware update, brownout, crash).
+//  The state is a plain struct of the firmware. save() copies it into a record in retained RAM right
+//   away, flush() copies the record to the EEPROM when it changed since the last time: call it on a
+//   schedule, the EEPROM is flash underneath and wears out. Every flush goes to the next of `slots`
+//   slots, so each one is written once every `slots` flushes.
+//  A record has a magic, the version of the layout of the state, its length, a sequence number that
+//   goes up on every save() and a CRC-32 of all that. restore() takes the retained record if it is
+//   valid, or else the valid EEPROM slot with the highest sequence: a reset in the middle of a write
+//   leaves a record with a bad CRC, never a half-written state.
+//  A save() with persist false only goes to the retained record: for the state that changes often and
+//   is worth the EEPROM only along with a change that is saved with persist true.
+//  Change the version whenever the struct changes, the old snapshots are then ignored.
+//  The record has no constructor on purpose, so a retained instance keeps its contents across a reset.
+
+#pragma once
+
+#include "Particle.h"
+
+#define CHECKPOINT_PAYLOAD_MAX 200
+
+enum CheckpointSource : uint8_t
+{
+  CHECKPOINT_NONE,
+  CHECKPOINT_RETAINED,
+  CHECKPOINT_EEPROM,
+};
+
+struct CheckpointRecord
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t length;
+  uint32_t sequence;
+  uint8_t payload[CHECKPOINT_PAYLOAD_MAX];
+  uint32_t crc;
+};
+
+class Checkpoint
+{
+public:
+  // the EEPROM slots go from eepromAddress on, slots * sizeof(CheckpointRecord) bytes
+  Checkpoint(CheckpointRecord &retainedRecord, uint16_t version, int eepromAddress, uint8_t slots);
+
+  // call once from setup(), before the first save()
+  CheckpointSource restore(void *state, size_t length);
+  // nothing is written if the state did not change since the last save()
+  void save(const void *state, size_t length, bool persist = true);
+  // true if the EEPROM was written
+  bool flush();
+
+  // a save() not in the EEPROM yet
+  bool pending() const { return dirty; }
+  unsigned long eepromWrites() const { return writes; }
+
+private:
+  bool valid(const CheckpointRecord &record) const;
+  int slotAddress(uint8_t slot) const;
+
+  CheckpointRecord &record;
+  uint16_t version;
+  int eepromAddress;
+  uint8_t slots;
+  uint8_t nextSlot;
+  uint32_t sequence;
+  bool dirty;
+  unsigned long writes;
+};
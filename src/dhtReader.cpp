@@ -0,0 +1,120 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "dhtReader.h"
+
+DhtReader::DhtReader(PietteTech_DHT &sensor)
+    : sensor(sensor), state(IDLE), stateStart(0), attempts(0), lastStatus(DHTLIB_ERROR_NOTSTARTED),
+      lastCelsius(0), lastHumidity(0), failedAttempts(0)
+{
+}
+
+/*******************************************************************************
+ * Function Name  : start
+ * Description    : begins a reading, the result comes later through poll()
+ * Return         : false if a reading is already in progress
+ *******************************************************************************/
+bool DhtReader::start()
+{
+  if (state != IDLE)
+  {
+    return false;
+  }
+
+  attempts = 0;
+  attempt();
+  return true;
+}
+
+void DhtReader::attempt()
+{
+  attempts++;
+  sensor.acquire();
+  state = ACQUIRING;
+  stateStart = millis();
+}
+
+bool DhtReader::valid() const
+{
+  return lastStatus == DHTLIB_OK and
+         lastCelsius >= DHT_READER_MIN_CELSIUS and lastCelsius <= DHT_READER_MAX_CELSIUS and
+         lastHumidity >= 0 and lastHumidity <= 100;
+}
+
+/*******************************************************************************
+ * Function Name  : poll
+ * Description    : checks on the reading in progress, call this from loop()
+ * Return         : DHT_READ_OK, DHT_READ_RETRY or DHT_READ_FAILED once per attempt, DHT_READ_NONE otherwise
+ *******************************************************************************/
+DhtReadResult DhtReader::poll()
+{
+  if (state == IDLE)
+  {
+    return DHT_READ_NONE;
+  }
+
+  unsigned long now = millis();
+
+  if (state == WAITING)
+  {
+    if (now - stateStart >= DHT_READER_RETRY_DELAY)
+    {
+      attempt();
+    }
+    return DHT_READ_NONE;
+  }
+
+  if (sensor.acquiring())
+  {
+    if (now - stateStart < DHT_READER_TIMEOUT)
+    {
+      return DHT_READ_NONE;
+    }
+    lastStatus = DHTLIB_ERROR_ACQUIRING;
+  }
+  else
+  {
+    lastStatus = sensor.getStatus();
+    if (lastStatus == DHTLIB_OK)
+    {
+      lastCelsius = sensor.getCelsius();
+      lastHumidity = sensor.getHumidity();
+    }
+    if (valid())
+    {
+      state = IDLE;
+      return DHT_READ_OK;
+    }
+  }
+
+  failedAttempts++;
+  if (attempts > DHT_READER_RETRIES)
+  {
+    state = IDLE;
+    return DHT_READ_FAILED;
+  }
+  state = WAITING;
+  stateStart = now;
+  return DHT_READ_RETRY;
+}
+
+/*******************************************************************************
+ * Function Name  : nextPollMillis
+ * Description    : lets loop() know how long nothing can happen here
+ * Return         : 0 while acquiring, the time left before the retry, DHT_READER_NEVER when idle
+ *******************************************************************************/
+unsigned long DhtReader::nextPollMillis() const
+{
+  if (state == IDLE)
+  {
+    return DHT_READER_NEVER;
+  }
+  if (state == ACQUIRING)
+  {
+    return 0;
+  }
+  unsigned long elapsed = millis() - stateStart;
+  return elapsed >= DHT_READER_RETRY_DELAY ? 0 : DHT_READER_RETRY_DELAY - elapsed;
+}
@@ -0,0 +1,76 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Non-blocking DHT22 reading on top of the interrupt driven PietteTech_DHT library.
+//  start() begins an acquisition and returns right away, the sensor answers through the library ISR
+//   (dht_wrapper) and poll(), called from loop() on every pass, hands out the result once it is in.
+//  A read that fails (bad checksum, no answer from the sensor, a value out of range) or takes longer
+//   than DHT_READER_TIMEOUT is tried again DHT_READER_RETRY_DELAY later, up to DHT_READER_RETRIES times.
+
+#pragma once
+
+#include "Particle.h"
+#include "PietteTech_DHT.h"
+
+// a DHT22 answers in about 5 ms (start pulse and 40 bits)
+#define DHT_READER_TIMEOUT 100
+// the DHT22 wants 2 seconds between reads
+#define DHT_READER_RETRY_DELAY 2000
+#define DHT_READER_RETRIES 2
+// I observed my dht22 measuring below 0 from time to time, those readings are taken again
+#define DHT_READER_MIN_CELSIUS 0.0f
+#define DHT_READER_MAX_CELSIUS 80.0f
+#define DHT_READER_NEVER 0xFFFFFFFFUL
+
+enum DhtReadResult : uint8_t
+{
+  DHT_READ_NONE,   // nothing new
+  DHT_READ_OK,     // celsius() and humidity() have the reading
+  DHT_READ_RETRY,  // this attempt failed, another one comes in DHT_READER_RETRY_DELAY
+  DHT_READ_FAILED, // the last attempt failed, start() again later
+};
+
+class DhtReader
+{
+public:
+  DhtReader(PietteTech_DHT &sensor);
+
+  // false if a reading is already in progress
+  bool start();
+  DhtReadResult poll();
+
+  // acquiring or waiting to retry
+  bool busy() const { return state != IDLE; }
+  // how long loop() can wait before polling again, DHT_READER_NEVER when there is no reading in progress
+  unsigned long nextPollMillis() const;
+
+  // of the last attempt: library status (DHTLIB_ERROR_ACQUIRING when it timed out) and what the sensor said
+  int status() const { return lastStatus; }
+  float celsius() const { return lastCelsius; }
+  float humidity() const { return lastHumidity; }
+
+  // attempts that failed since boot
+  uint32_t failures() const { return failedAttempts; }
+
+private:
+  enum State
+  {
+    IDLE,
+    ACQUIRING,
+    WAITING,
+  };
+
+  void attempt();
+  bool valid() const;
+
+  PietteTech_DHT &sensor;
+  State state;
+  unsigned long stateStart;
+  uint8_t attempts;
+  int lastStatus;
+  float lastCelsius;
+  float lastHumidity;
+  uint32_t failedAttempts;
+};
@@ -0,0 +1,223 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "dryerDetector.h"
+
+#include <math.h>
+#include <string.h>
+
+// sum of i and of i^2 for i in 0..DRYER_SLOPE_WINDOW-1
+#define WINDOW_SUM_X (DRYER_SLOPE_WINDOW * (DRYER_SLOPE_WINDOW - 1) / 2)
+#define WINDOW_SUM_XX ((DRYER_SLOPE_WINDOW - 1) * DRYER_SLOPE_WINDOW * (2 * DRYER_SLOPE_WINDOW - 1) / 6)
+#define WINDOW_DENOMINATOR (DRYER_SLOPE_WINDOW * WINDOW_SUM_XX - WINDOW_SUM_X * WINDOW_SUM_X)
+
+DryerDetector::DryerDetector()
+    : on(false), startTime(0), drySamples(0), lowestHumidity(0), lowestTime(0), levels(0), levelTime(0),
+      decaySeconds(0), decayFloor(0), temperatureAverage(0), humidityAverage(0), oldest(0), count(0)
+{
+  memset(times, 0, sizeof(times));
+  memset(&temperatures, 0, sizeof(temperatures));
+  memset(&humidities, 0, sizeof(humidities));
+}
+
+/*******************************************************************************
+ * Function Name  : slide
+ * Description    : adds value as the newest sample of the window, replacing the oldest once it's full
+                    every sample moves one x down, so the weighted sum loses the sum of the ones that stay
+ *******************************************************************************/
+void DryerDetector::slide(Window &window, uint8_t oldest, uint8_t count, int16_t value)
+{
+  if (count < DRYER_SLOPE_WINDOW)
+  {
+    window.values[count] = value;
+    window.sum += value;
+    window.weightedSum += (int32_t)count * value;
+    return;
+  }
+  int16_t dropped = window.values[oldest];
+  window.weightedSum += -(window.sum - dropped) + (int32_t)(DRYER_SLOPE_WINDOW - 1) * value;
+  window.sum += value - dropped;
+  window.values[oldest] = value;
+}
+
+int32_t DryerDetector::slope(const Window &window) const
+{
+  if (count < DRYER_SLOPE_WINDOW)
+  {
+    return 0;
+  }
+  uint32_t newest = times[(oldest + DRYER_SLOPE_WINDOW - 1) % DRYER_SLOPE_WINDOW];
+  uint32_t span = newest - times[oldest];
+  if (span == 0)
+  {
+    return 0;
+  }
+  // slope per sample, times samples per minute
+  int64_t numerator = (int64_t)DRYER_SLOPE_WINDOW * window.weightedSum - (int64_t)WINDOW_SUM_X * window.sum;
+  return numerator * 60 * (DRYER_SLOPE_WINDOW - 1) / ((int64_t)WINDOW_DENOMINATOR * span);
+}
+
+int32_t DryerDetector::temperatureSlope() const { return slope(temperatures); }
+int32_t DryerDetector::humiditySlope() const { return slope(humidities); }
+
+/*******************************************************************************
+ * Function Name  : update
+ * Description    : feeds one sample (time in seconds, readings in hundredths)
+ * Return         : what happened to the cycle with this sample
+ *******************************************************************************/
+DryerEvent DryerDetector::update(uint32_t time, int16_t celsius, int16_t humidity)
+{
+  if (count == 0)
+  {
+    temperatureAverage = (int32_t)celsius << DRYER_EWMA_SHIFT;
+    humidityAverage = (int32_t)humidity << DRYER_EWMA_SHIFT;
+  }
+  else
+  {
+    temperatureAverage += celsius - (temperatureAverage >> DRYER_EWMA_SHIFT);
+    humidityAverage += humidity - (humidityAverage >> DRYER_EWMA_SHIFT);
+  }
+
+  // the window keeps the readings in sample order starting at `oldest`, slide() works on slots
+  //  so it is given the slot being replaced
+  slide(temperatures, oldest, count, celsius);
+  slide(humidities, oldest, count, humidity);
+  if (count < DRYER_SLOPE_WINDOW)
+  {
+    times[count++] = time;
+  }
+  else
+  {
+    times[oldest] = time;
+    oldest = (oldest + 1) % DRYER_SLOPE_WINDOW;
+  }
+
+  if (count < DRYER_SLOPE_WINDOW)
+  {
+    return DRYER_EVENT_NONE;
+  }
+
+  int32_t humiditySlope = this->humiditySlope();
+  int32_t temperatureSlope = this->temperatureSlope();
+
+  if (not on)
+  {
+    if (humiditySlope >= config.startHumiditySlope and temperatureSlope >= config.startTemperatureSlope)
+    {
+      setRunning(true, time);
+      return DRYER_EVENT_STARTED;
+    }
+    return DRYER_EVENT_NONE;
+  }
+
+  int16_t averageHumidity = this->humidity();
+  if (averageHumidity + config.plateauDrop <= lowestHumidity)
+  {
+    lowestHumidity = averageHumidity;
+    lowestTime = time;
+  }
+
+  // every DRYER_DECAY_SECONDS while drying, fit the exponential through the last three levels
+  if (humiditySlope < 0 and (levels == 0 or time - levelTime >= DRYER_DECAY_SECONDS))
+  {
+    fitDecay(averageHumidity);
+    levelTime = time;
+  }
+
+  if (time - startTime < config.minCycleSeconds)
+  {
+    return DRYER_EVENT_NONE;
+  }
+
+  if (temperatureSlope <= -config.stopTemperatureSlope)
+  {
+    setRunning(false, time);
+    return DRYER_EVENT_STOPPED;
+  }
+
+  bool dry = averageHumidity <= config.dryHumidity and temperature() >= config.dryTemperature;
+  bool flat = averageHumidity <= config.plateauHumidity and time - lowestTime >= config.plateauSeconds;
+  drySamples = (dry or flat) ? drySamples + 1 : 0;
+  if (drySamples >= config.drySamples)
+  {
+    setRunning(false, time);
+    return DRYER_EVENT_DRY;
+  }
+  return DRYER_EVENT_NONE;
+}
+
+void DryerDetector::setRunning(bool on, uint32_t time)
+{
+  this->on = on;
+  startTime = time;
+  drySamples = 0;
+  lowestHumidity = INT16_MAX;
+  lowestTime = time;
+  levels = 0;
+  levelTime = 0;
+  decaySeconds = 0;
+  decayFloor = 0;
+}
+
+void DryerDetector::shiftTime(int32_t seconds)
+{
+  startTime += seconds;
+  lowestTime += seconds;
+  levelTime += seconds;
+  for (uint8_t i = 0; i < DRYER_SLOPE_WINDOW; i++)
+  {
+    times[i] += seconds;
+  }
+}
+
+/*******************************************************************************
+ * Function Name  : fitDecay
+ * Description    : with h0, h1, h2 taken DRYER_DECAY_SECONDS apart on h = floor + A * e^(-t / tau):
+                    (h2 - h1) / (h1 - h0) = e^(-DRYER_DECAY_SECONDS / tau)
+                    floor = (h0 * h2 - h1^2) / (h0 + h2 - 2 * h1)   (Aitken's delta-squared)
+                    the fit is kept only if the levels really decay
+ *******************************************************************************/
+void DryerDetector::fitDecay(int16_t humidity)
+{
+  if (levels < 2)
+  {
+    level[levels++] = humidity;
+    return;
+  }
+  float first = level[1] - level[0];
+  float second = humidity - level[1];
+  level[0] = level[1];
+  level[1] = humidity;
+  if (first >= 0 or second >= 0 or second <= first)
+  {
+    return;
+  }
+  decaySeconds = -DRYER_DECAY_SECONDS / logf(second / first);
+  decayFloor = humidity - second * second / (second - first);
+}
+
+int32_t DryerDetector::secondsToDry() const
+{
+  int32_t humiditySlope = this->humiditySlope();
+  int16_t averageHumidity = humidity();
+  if (not on or count < DRYER_SLOPE_WINDOW or averageHumidity <= 0)
+  {
+    return -1;
+  }
+  if (averageHumidity <= config.dryHumidity)
+  {
+    return 0;
+  }
+  // not drying yet, or no decay seen yet
+  if (humiditySlope >= 0 or decaySeconds <= 0)
+  {
+    return -1;
+  }
+
+  float target = decayFloor + 100 > config.dryHumidity ? decayFloor + 100 : config.dryHumidity;
+  float seconds =
+      averageHumidity <= target ? 0 : decaySeconds * logf((averageHumidity - decayFloor) / (target - decayFloor));
+  return seconds > 24 * 3600 ? -1 : (int32_t)seconds;
+}
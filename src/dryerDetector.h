@@ -0,0 +1,121 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Streaming detector of the dryer cycle, fed with every DHT22 sample of the exhaust.
+//  It keeps, in constant time and memory per sample:
+//   - an EWMA of temperature and humidity (alpha = 1 / 2^DRYER_EWMA_SHIFT)
+//   - the least squares slope of both over the last DRYER_SLOPE_WINDOW samples, from running
+//      integer sums that are updated when the window slides, so they never drift
+//  A cycle starts when humidity and temperature climb together (the drum heats up wet clothes),
+//   it ends when the clothes are dry (humidity low and hot, or humidity at a low level made no new low
+//   for a while) or when the dryer stopped heating (temperature falling).
+//  While drying, humidity decays exponentially towards a floor that depends on the load:
+//   h = floor + A * e^(-t / tau). Three averaged levels DRYER_DECAY_SECONDS apart give tau and the floor,
+//   and the time to dry is tau * ln((h - floor) / (target - floor)), target being the dry humidity
+//   or 1% above the floor when the clothes won't get that dry.
+//  Readings are in hundredths (of a degree and of a percent), slopes in hundredths per minute.
+
+#pragma once
+
+#include <stdint.h>
+
+#define DRYER_SLOPE_WINDOW 4
+#define DRYER_EWMA_SHIFT 1
+
+// defaults of DryerDetectorConfig, host/dryerBench replays cycles to tune them
+#define DRYER_START_HUMIDITY_SLOPE 300    // humidity rising 3%/min...
+#define DRYER_START_TEMPERATURE_SLOPE 100 // ...while temperature rises 1 degree/min
+#define DRYER_DRY_HUMIDITY 1000           // below 10% and...
+#define DRYER_DRY_TEMPERATURE 4500        // ...over 45 degrees the clothes are dry
+#define DRYER_PLATEAU_HUMIDITY 2000       // or below 20% and...
+#define DRYER_PLATEAU_DROP 50             // ...not 0.5% lower than the lowest so far...
+#define DRYER_PLATEAU_SECONDS 300         // ...for 5 minutes
+#define DRYER_STOP_TEMPERATURE_SLOPE 100  // cooling down 1 degree/min: the dryer stopped heating
+#define DRYER_DRY_SAMPLES 2               // consecutive samples the end condition must hold
+#define DRYER_MIN_CYCLE_SECONDS 600       // no end detection during the heat up
+#define DRYER_DECAY_SECONDS 300           // levels this far apart give the decay of the humidity
+
+enum DryerEvent : uint8_t
+{
+  DRYER_EVENT_NONE,
+  DRYER_EVENT_STARTED,
+  DRYER_EVENT_DRY,
+  DRYER_EVENT_STOPPED, // temperature fell before the clothes looked dry
+};
+
+struct DryerDetectorConfig
+{
+  int16_t startHumiditySlope = DRYER_START_HUMIDITY_SLOPE;
+  int16_t startTemperatureSlope = DRYER_START_TEMPERATURE_SLOPE;
+  int16_t dryHumidity = DRYER_DRY_HUMIDITY;
+  int16_t dryTemperature = DRYER_DRY_TEMPERATURE;
+  int16_t plateauHumidity = DRYER_PLATEAU_HUMIDITY;
+  int16_t plateauDrop = DRYER_PLATEAU_DROP;
+  uint16_t plateauSeconds = DRYER_PLATEAU_SECONDS;
+  int16_t stopTemperatureSlope = DRYER_STOP_TEMPERATURE_SLOPE;
+  uint8_t drySamples = DRYER_DRY_SAMPLES;
+  uint16_t minCycleSeconds = DRYER_MIN_CYCLE_SECONDS;
+};
+
+class DryerDetector
+{
+public:
+  DryerDetector();
+
+  DryerEvent update(uint32_t time, int16_t celsius, int16_t humidity);
+
+  // the cycle was turned on or off by hand (setDryer)
+  void setRunning(bool on, uint32_t time);
+  // the time base moved by that many seconds (a detector restored after a reset)
+  void shiftTime(int32_t seconds);
+  bool running() const { return on; }
+
+  int16_t temperature() const { return temperatureAverage >> DRYER_EWMA_SHIFT; }
+  int16_t humidity() const { return humidityAverage >> DRYER_EWMA_SHIFT; }
+  // 0 until the window is full
+  int32_t temperatureSlope() const;
+  int32_t humiditySlope() const;
+
+  // predicted seconds until the clothes are dry, -1 when there is no prediction
+  int32_t secondsToDry() const;
+
+  DryerDetectorConfig config;
+
+private:
+  // least squares slope of the last DRYER_SLOPE_WINDOW samples, sample i of the window at x = i
+  struct Window
+  {
+    int16_t values[DRYER_SLOPE_WINDOW];
+    int32_t sum;         // sum of values[i]
+    int32_t weightedSum; // sum of i * values[i]
+  };
+
+  static void slide(Window &window, uint8_t oldest, uint8_t count, int16_t value);
+  int32_t slope(const Window &window) const;
+  void fitDecay(int16_t humidity);
+
+  bool on;
+  uint32_t startTime;
+  uint8_t drySamples;
+  int16_t lowestHumidity;
+  uint32_t lowestTime;
+
+  // decay of the humidity while drying, decaySeconds is 0 until three levels were seen
+  int16_t level[2];
+  uint8_t levels;
+  uint32_t levelTime;
+  float decaySeconds;
+  float decayFloor;
+
+  // EWMA scaled by 2^DRYER_EWMA_SHIFT so the shift does not lose the fraction
+  int32_t temperatureAverage;
+  int32_t humidityAverage;
+
+  uint32_t times[DRYER_SLOPE_WINDOW];
+  Window temperatures;
+  Window humidities;
+  uint8_t oldest; // slot of the oldest sample, next to be replaced
+  uint8_t count;
+};
@@ -0,0 +1,113 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "fixedFormat.h"
+
+#include <string.h>
+
+size_t fixedFormat(char *buffer, size_t size, int32_t value, uint8_t decimals)
+{
+  if (decimals > FIXED_FORMAT_MAX_DECIMALS)
+  {
+    decimals = FIXED_FORMAT_MAX_DECIMALS;
+  }
+
+  // digits come out backwards, with leading zeros up to "0.0.."
+  char digits[10];
+  uint8_t count = 0;
+  uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  do
+  {
+    digits[count++] = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0 or count <= decimals);
+
+  size_t length = (value < 0 ? 1 : 0) + count + (decimals > 0 ? 1 : 0);
+  if (length + 1 > size)
+  {
+    if (size > 0)
+    {
+      buffer[0] = 0;
+    }
+    return 0;
+  }
+
+  char *p = buffer;
+  if (value < 0)
+  {
+    *p++ = '-';
+  }
+  while (count > 0)
+  {
+    if (count == decimals)
+    {
+      *p++ = '.';
+    }
+    *p++ = digits[--count];
+  }
+  *p = 0;
+  return length;
+}
+
+size_t fixedFormatFloat(char *buffer, size_t size, float value, uint8_t decimals)
+{
+  if (decimals > FIXED_FORMAT_MAX_DECIMALS)
+  {
+    decimals = FIXED_FORMAT_MAX_DECIMALS;
+  }
+
+  float scale = 1;
+  for (uint8_t i = 0; i < decimals; i++)
+  {
+    scale *= 10;
+  }
+
+  // round half away from zero, saturating at what fits in 32 bits
+  float scaled = value * scale + (value < 0 ? -0.5f : 0.5f);
+  int32_t fixed;
+  if (scaled >= 2147483647.0f)
+  {
+    fixed = INT32_MAX;
+  }
+  else if (scaled <= -2147483647.0f)
+  {
+    fixed = -INT32_MAX;
+  }
+  else
+  {
+    fixed = (int32_t)scaled;
+  }
+  return fixedFormat(buffer, size, fixed, decimals);
+}
+
+size_t fixedAppend(char *buffer, size_t size, const char *text)
+{
+  size_t length = strnlen(buffer, size);
+  while (*text and length + 1 < size)
+  {
+    buffer[length++] = *text++;
+  }
+  if (length < size)
+  {
+    buffer[length] = 0;
+  }
+  return length;
+}
+
+void fixedClock(char *buffer, time_t localTime)
+{
+  int32_t seconds = (int32_t)(localTime % 86400);
+  if (seconds < 0)
+  {
+    seconds += 86400;
+  }
+  const int32_t parts[] = {seconds / 3600, seconds / 60 % 60, seconds % 60};
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    buffer[i * 3] = '0' + parts[i] / 10;
+    buffer[i * 3 + 1] = '0' + parts[i] % 10;
+    buffer[i * 3 + 2] = i < 2 ? ':' : 0;
+  }
+}
@@ -0,0 +1,44 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Small formatter for sensor values with a fixed number of decimals.
+//  Integer only and allocation free: it writes into the caller's buffer and never touches printf,
+//   so it's cheap to call on every reading. (2005, 2) gives "20.05" and (-5, 2) gives "-0.05".
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define FIXED_FORMAT_MAX_DECIMALS 9
+// "hh:mm:ss" and the terminating 0
+#define FIXED_CLOCK_SIZE 9
+
+/*******************************************************************************
+ * Function Name  : fixedFormat
+ * Description    : writes value / 10^decimals with exactly that many decimals, plus the terminating 0
+ * Return         : the length written, 0 (and an empty string) if it does not fit in size
+ *******************************************************************************/
+size_t fixedFormat(char *buffer, size_t size, int32_t value, uint8_t decimals);
+
+/*******************************************************************************
+ * Function Name  : fixedFormatFloat
+ * Description    : same as fixedFormat(), the value is rounded to that many decimals first
+ *******************************************************************************/
+size_t fixedFormatFloat(char *buffer, size_t size, float value, uint8_t decimals);
+
+/*******************************************************************************
+ * Function Name  : fixedAppend
+ * Description    : appends text to the string in buffer, truncating it to fit size
+ * Return         : the new length of the string
+ *******************************************************************************/
+size_t fixedAppend(char *buffer, size_t size, const char *text);
+
+/*******************************************************************************
+ * Function Name  : fixedClock
+ * Description    : writes the time of day of a local unix time as "hh:mm:ss", FIXED_CLOCK_SIZE bytes
+ *******************************************************************************/
+void fixedClock(char *buffer, time_t localTime);
@@ -42,11 +42,42 @@
 // A0 : pool_THERMISTOR
 // A1~A7 : not used
 
-#include "elapsedMillis.h"
 #include "PietteTech_DHT.h"
+#include "adcSampler.h"
+#include "checkpoint.h"
+#include "dhtReader.h"
+#include "dryerDetector.h"
+#include "fixedFormat.h"
+#include "homeStatus.h"
+#include "jsonWriter.h"
+#include "lanControl.h"
+#include "loopStats.h"
+#include "notifier.h"
+#include "publishQueue.h"
+#include "relayPulse.h"
+#include "sampleCodec.h"
+#include "sampleSeries.h"
+#include "scheduler.h"
+#include "sensorRegistry.h"
+#include "sensorTrace.h"
+#include "spscRing.h"
+#include "thermistorTable.h"
 
 #define APP_NAME "Home Commander"
-String VERSION = "Version 1.02";
+String VERSION = "Version 1.26";
+
+// the retained variables (temperature series, state snapshot, events waiting for the cloud) survive a reset,
+//  and a power loss with VBAT
+STARTUP(System.enableFeature(FEATURE_RETAINED_MEMORY));
+
+// 1: setup() runs right after a reset and loop() watches the sensors while the system thread connects
+//  to the cloud in the background. 0: the system connects first (AUTOMATIC), which can take tens of
+//  seconds with a weak wifi signal, and no sensor is read meanwhile
+#define FAST_BOOT 1
+#if FAST_BOOT
+SYSTEM_THREAD(ENABLED);
+SYSTEM_MODE(SEMI_AUTOMATIC);
+#endif
 
 /*******************************************************************************
  * changes in version 0.51:
@@ -101,6 +132,98 @@ String VERSION = "Version 1.02";
               * new blynk cloud 2023
 * changes in version 1.02:
               * remove blynk, send temp via publish
+* changes in version 1.03:
+              * garage button pulse no longer blocks for one second, loop() releases the relay
+              * garage_open, garage_close and garage_stat registered as cloud functions
+* changes in version 1.04:
+              * loop() latency histograms per subsystem in cloud variable loop_stats
+* changes in version 1.05:
+              * every publish goes through a queue that respects the cloud rate limit
+                 (1 event/sec, bursts of 4) and sends flood alarms before anything else
+* changes in version 1.06:
+              * all timers replaced by a scheduler, loop() only runs the tasks that are due
+              * garage status is read every GARAGE_READ_INTERVAL again
+* changes in version 1.07:
+              * flood sensor on D7 is watched with an interrupt, the alarm schedule starts
+                 when the water shows up instead of at the next read
+* changes in version 1.08:
+              * garage reed switches on D4/D5 are watched with interrupts, the door status
+                 follows the real edges instead of being guessed every second
+* changes in version 1.09:
+              * garage and dryer status are enums, cloud variables are fixed char buffers
+                 and messages are built with snprintf, so loop() never touches the heap
+* changes in version 1.10:
+              * pool thermistor is sampled in the background by a software timer and filtered
+                 with a trimmed mean, pool monitor is enabled again
+* changes in version 1.11:
+              * pool temperature comes from a table built at compile time instead of float math,
+                 the unit (celsius/fahrenheit) is chosen at compile time with POOL_FAHRENHEIT
+* changes in version 1.12:
+              * temperatures and humidity are formatted with fixedFormat() instead of sprintf("%0d.%d"),
+                 which printed 20.05 as 20.5 and lost the sign of values between -1 and 0
+* changes in version 1.13:
+              * every DHT22 sample (30 secs) is kept with its time in retained memory and sent every
+                 5 minutes as one DownStairs_Series event, which replaces DownStairs_Temp
+* changes in version 1.14:
+              * the samples are packed with sampleCodec (deltas, bit-level varints, base64) and sent as
+                 DownStairs_Packed, about 14 times more samples fit in one event than as json
+                 (host/seriesDecode turns them back into csv). TEMPERATURE_SERIES_PACKED 0 goes back to json
+* changes in version 1.15:
+              * the dryer cycle is detected by dryerDetector (averages and slopes of temperature and humidity)
+                 instead of fixed thresholds: it starts about a minute after the drum heats up and ends when
+                 the clothes are as dry as they get, even above 10%. The predicted minutes to dry are in the
+                 cloud variable dryer_eta and published as Dryer_ETA (host/dryerBench compares both)
+* changes in version 1.16:
+              * with SENSOR_TRACE 1 every sensor reading and publish is written to the USB serial port,
+                 with the cloud function calls, host/traceReplay replays such a trace through the firmware
+                 and checks every publish
+* changes in version 1.17:
+              * the DHT22 is read without waiting: the sample task starts the acquisition and loop() picks
+                 up the result a few ms later. A failed or stuck read is tried again 2 seconds later
+                 (twice at most) instead of skipping the sample until the next 30 seconds
+* changes in version 1.18:
+              * leak sensors and DHT22s are lines of the sensors_table (see sensorRegistry.h), one pass of
+                 loop() goes through all of them when one is due. More leak sensors are one more line each,
+                 their alarms say which one got wet. loop_stats: flood and flood_notify are now sensors
+* changes in version 1.19:
+              * cloud variable status: garage, pool, dryer and leak sensors in one json document, written
+                 only when it is read after something changed. The readings are no longer formatted into
+                 their own variables as they come in; pool_tmp, currentTemp, humidity, dryer_stat and
+                 dryer_eta are gone unless STATUS_LEGACY_VARIABLES is 1, which frees 5 of the 10 variables
+* changes in version 1.20:
+              * with LAN_CONTROL 1 the garage functions, pool_get_tmp, setDryer, status and loop_stats
+                 can be used from the local network (see lanControl.h), requests signed with a shared key.
+                 loop_stats: new section lan
+* changes in version 1.21:
+              * notifications are built by a Notifier from the templates of the notifications section,
+                 with the time of day at the end, no String involved. Back after being commented out:
+                 garage door status when scheduled, garage still open and finally closed, pool ready,
+                 drying cycle started, clothes dry and still not dry
+* changes in version 1.22:
+              * with LOW_POWER 1 the processor stops (wifi in standby) while loop() has nothing to do,
+                 up to the next deadline or POWER_MAX_SLEEP, a garage reed switch or a leak sensor
+                 wakes it up. homeCommanderSim --sleep tells how much of the time it would be awake.
+                 The pool thermistor is then read in a burst by pool_read(), not by its software
+                 timer, which would wake the processor every POOL_SAMPLE_INTERVAL
+* changes in version 1.23:
+              * the state of the garage alarms, the pool notification, the dryer cycle and the flood alarms
+                 survives a reset: it is kept in retained memory as it changes and in the EEPROM every
+                 10 minutes (see checkpoint.h), setup() takes it back. A firmware update or a brownout
+                 no longer forgets a drying cycle, nor sends the flood alarms over from the first one
+* changes in version 1.24:
+              * FAST_BOOT: the sensors are armed right after a reset, the cloud connects in the background
+                 (system thread, SEMI_AUTOMATIC) and the events wait in the publish queue until it is up.
+                 The LAN control server starts listening once the wifi is up
+* changes in version 1.25:
+              * SENSOR_THREAD: the leak sensors, their alarms and the DHT22 run in a thread of their own,
+                 of higher priority than loop(). They tell loop() what happened through a lock-free queue
+                 and loop() does the notifications, so a stuck publish no longer holds the sensors up
+* changes in version 1.26:
+              * the publish queue keeps its events in retained memory (2 KB, see publishQueue.h): an ISP
+                 outage or a reset no longer loses the flood alarms and the garage events waiting for the
+                 cloud. When it is full the oldest telemetry goes first, alarms are never dropped for room.
+                 They go out at the rate limit once the cloud is back, a late alarm or event says when
+                 it happened: "Flood detected! (queued at 03:12:44)"
 
 *******************************************************************************/
 
@@ -109,6 +232,63 @@ String VERSION = "Version 1.02";
 #define AWS_EMAIL "awsEmail"
 const int TIME_ZONE = -4;
 
+// all events are published from loop() through this queue, never with Particle.publish() directly
+//  so a flood alarm is not lost because a temperature reading used up the burst, nor because the
+//  cloud was down: the events wait in retained memory until it is back
+retained PublishStore publishStore;
+PublishQueue publishQueue(publishStore);
+
+// notifications begin
+// every message for people, "{}" is filled in when it is sent (see notifier.h)
+//                                             event                      text                                                priority           time
+const Notification notify_garageIs          = {PUSHBULLET_NOTIF_PERSONAL, "Your garage door is {}",                           PUBLISH_EVENT,     false};
+const Notification notify_garageScheduled   = {PUSHBULLET_NOTIF_PERSONAL, "Your garage door is {}",                           PUBLISH_EVENT,     true};
+const Notification notify_garageStillOpen   = {PUSHBULLET_NOTIF_PERSONAL, "Garage still open!",                               PUBLISH_ALARM,     true};
+const Notification notify_garageClosed      = {PUSHBULLET_NOTIF_PERSONAL, "Garage was finally closed!",                       PUBLISH_EVENT,     true};
+const Notification notify_flood             = {PUSHBULLET_NOTIF_PERSONAL, "Flood detected!",                                  PUBLISH_ALARM,     false};
+const Notification notify_floodSensor       = {PUSHBULLET_NOTIF_PERSONAL, "Flood detected! ({})",                             PUBLISH_ALARM,     false};
+const Notification notify_poolTemp          = {PUSHBULLET_NOTIF_PERSONAL, "Your pool is at {} degrees",                       PUBLISH_EVENT,     false};
+const Notification notify_poolReady         = {PUSHBULLET_NOTIF_HOME,     "Pool is ready! ({}{})",                            PUBLISH_EVENT,     false};
+const Notification notify_dryerStarted      = {PUSHBULLET_NOTIF_HOME,     "Starting drying cycle",                            PUBLISH_EVENT,     true};
+const Notification notify_dryerDry          = {PUSHBULLET_NOTIF_HOME,     "Your clothes are dry (lowest humidity: {}%)",      PUBLISH_EVENT,     true};
+const Notification notify_dryerStillWet     = {PUSHBULLET_NOTIF_HOME,     "ALARM: Your clothes are still not dry (lowest humidity: {}%)", PUBLISH_ALARM, true};
+const Notification notify_dryerStopped      = {PUSHBULLET_NOTIF_HOME,     "The dryer stopped, your clothes are not dry (lowest humidity: {}%)", PUBLISH_EVENT, true};
+Notifier notifier(publishQueue);
+// notifications end
+
+// every periodic or delayed job is a task of this scheduler, loop() only runs the ones that are due
+Scheduler scheduler;
+
+// 1: every sensor reading (garage and flood pins, pool thermistor, DHT22), cloud connection change,
+//  cloud function call and publish goes to the USB serial port as a trace, see sensorTrace.h
+//  capture it with "particle serial monitor > house.trace" and replay it with host/traceReplay
+#define SENSOR_TRACE 0
+#if SENSOR_TRACE
+SensorTrace sensorTrace;
+char trace_line[SENSOR_TRACE_LINE_MAX + 1];
+bool trace_connected = false;
+#define TRACE(record) sensorTrace.record
+#define TRACE_CALL(name, argument) trace_called(name, argument)
+#else
+#define TRACE(record)
+#define TRACE_CALL(name, argument)
+#endif
+
+#define TEMPERATURE_PUBLISH_INTERVAL 300000 // publish temp every 5 minutes
+TaskId publishTemperatureTask;
+
+// every temperature/humidity sample of the DHT22 goes into this series (it survives a reset)
+//  and is sent every TEMPERATURE_PUBLISH_INTERVAL in one event, as many samples as fit
+// 1: packed with sampleCodec (see host/seriesDecode), 0: json {"t0":..,"d":[[dt,temp,hum],..]}
+#define TEMPERATURE_SERIES_PACKED 1
+#if TEMPERATURE_SERIES_PACKED
+#define TEMPERATURE_SERIES_EVENT "DownStairs_Packed"
+#else
+#define TEMPERATURE_SERIES_EVENT "DownStairs_Series"
+#endif
+retained SampleSeries temperatureSeries;
+char temperatureSeriesBatch[PUBLISH_DATA_MAX + 1];
+
 /*******************************************************************************
  DHT sensor
 *******************************************************************************/
@@ -117,8 +297,8 @@ const int TIME_ZONE = -4;
 #define DHT_SAMPLE_INTERVAL 30000 // Sample dryer every 30 seconds
 void dht_wrapper();               // must be declared before the lib initialization
 PietteTech_DHT DHT(DHTPIN, DHTTYPE, dht_wrapper);
-bool bDHTstarted; // flag to indicate we started acquisition
-elapsedMillis dhtSampleInterval;
+// started by the sensor registry every DHT_SAMPLE_INTERVAL, dryer_status() gets the reading
+DhtReader dht_reader(DHT);
 int n;                          // counter
 unsigned int DHTnextSampleTime; // Next time we want to start sample -> BORRAR
 
@@ -128,14 +308,23 @@ char resultstr[64];
 // String to store the sensor humidity
 char humiditystr[64];
 bool dryer_on = false;
-String dryer_stat = "";
-int humidity_samples_below_10 = 0;
+char dryer_stat[16] = "dryer_off"; // see dryerStatusNames
+// decides when a cycle starts and ends from every sample, and predicts when the clothes will be dry
+//  its time is dryer_seconds(): the seconds since the reset, they don't jump when the clock gets set
+DryerDetector dryer_detector;
+uint32_t dryer_clockSeconds = 0;
+unsigned long dryer_clockMillis = 0;
+// minutes to dry, -1 when there is no prediction (cloud variable dryer_eta)
+int dryer_etaMinutes = -1;
+int dryer_etaPublished = -1;
+#define DRYER_ETA_EVENT "Dryer_ETA"
+#define DRYER_ETA_PUBLISH_CHANGE 5 // publish the prediction again when it moved this many minutes
+char dryer_etaMessage[16];
 float currentTemp = 20.0;
 float currentHumidity = 0.0;
 float lowestHumidity = 100.0;
-// temperature related variables - to be exposed in the cloud
-String currentTempString = String(currentTemp);         // String to store the sensor's temp so it can be exposed
-String currentHumidityString = String(currentHumidity); // String to store the sensor's humidity so it can be exposed
+// false until the first reading of the DHT22
+bool currentTempValid = false;
 
 // milliseconds for the max time the dryer can be on
 //  in my case, my dryer logest cycle runs at most for 99 minutes
@@ -143,28 +332,42 @@ String currentHumidityString = String(currentHumidity); // String to store the s
 //   after this time has elapsed - the user can then decide according to the minimum
 //   humidity reached to turn the dryer on again or not
 #define DRYER_MAX_TIMER 5940000
-elapsedMillis dryerMaxTimer;
+TaskId dryer_maxTimeTask;
 // dryer end
 
-// pool begin
-#include <math.h>
-// pool end
-
 // garage begin
-#define GARAGE_READ_INTERVAL 1000
-#define GARAGE_OPEN "open"
-#define GARAGE_CLOSED "closed"
-#define GARAGE_OPENING "opening"
-#define GARAGE_CLOSING "closing"
+// the reed switches raise an interrupt on every change, the edges are queued with their level and time
+//  and loop() replays them into the status once the switches stopped bouncing for GARAGE_DEBOUNCE_MICROS
+//  the pins are also read every GARAGE_SAFETY_READ_INTERVAL, just in case an edge was lost
+#define GARAGE_EDGES_SIZE 16
+#define GARAGE_DEBOUNCE_MICROS 20000
+#define GARAGE_SAFETY_READ_INTERVAL 60000
 #define GARAGE_NOTIF "GARAGE"
-unsigned long garage_interval = 0;
+TaskId garage_readTask;
 int garage_BUTTON = D1;
 int garage_CLOSE = D4;
 int garage_OPEN = D5;
-String garage_status_string = "unknown";
+GarageStatus garage_status = GARAGE_UNKNOWN;
+
+struct GarageEdge
+{
+  uint8_t pin;
+  uint8_t level;
+  uint32_t micros;
+};
+SpscRing<GarageEdge, GARAGE_EDGES_SIZE> garage_edges;
+volatile uint32_t garage_lastEdgeMicros = 0;
+uint32_t garage_edgesLost = 0;
+
+// the garage button is pressed for GARAGE_BUTTON_PULSE milliseconds without blocking loop()
+//  a toggle requested while the button is pressed is queued and fires GARAGE_BUTTON_GAP later
+#define GARAGE_BUTTON_PULSE 1000
+#define GARAGE_BUTTON_GAP 500
+void garage_buttonReleased(pin_t pin); // must be declared before the pulse initialization
+RelayPulse garage_button(garage_BUTTON, GARAGE_BUTTON_PULSE, GARAGE_BUTTON_GAP, garage_buttonReleased);
 
 // these variables are used to signal an alarm (pushbullet notif) when the garage is left open
-elapsedMillis garageIsOpenTimer;
+TaskId garage_stillOpenTask;
 bool garageIsOpen = false;
 bool garageIsOpenAlarm = false;
 #define GARAGE_STILL_OPEN_ALARM 1800000 // 30 minutes
@@ -176,8 +379,20 @@ bool scheduleNotification = false;
 // garage end
 
 // flood detection begin
-// this reads the flood sensor every 2 seconds
+// with FLOOD_INTERRUPT_MODE the sensor raises an interrupt on every change, the sensor is
+//  read again SENSOR_DEBOUNCE milliseconds after the last edge and, just in case an edge
+//  was missed, every FLOOD_SAFETY_READ_INTERVAL
+// without it, this reads the flood sensor every 2 seconds
+#define FLOOD_INTERRUPT_MODE 1
 #define FLOOD_READ_INTERVAL 2000
+#define FLOOD_SAFETY_READ_INTERVAL 60000
+#if FLOOD_INTERRUPT_MODE
+#define FLOOD_SENSOR_FLAGS SENSOR_INTERRUPT
+#define FLOOD_SENSOR_PERIOD FLOOD_SAFETY_READ_INTERVAL
+#else
+#define FLOOD_SENSOR_FLAGS 0
+#define FLOOD_SENSOR_PERIOD FLOOD_READ_INTERVAL
+#endif
 
 // this defines the frequency of the notifications sent to the user
 #define FLOOD_FIRST_ALARM 10000    // 10 seconds
@@ -187,16 +402,28 @@ bool scheduleNotification = false;
 #define FLOOD_FIFTH_ALARM 3600000  // 1 hour
 #define FLOOD_SIXTH_ALARM 14400000 // 4 hours - and every 4 hours ever after, until the situation is rectified (ie no more water is detected)
 
-int flood_SENSOR = D7;
-elapsedMillis flood_timer;
-elapsedMillis flood_alarm_timer;
-
-int flood_alarms_array[6] = {FLOOD_FIRST_ALARM, FLOOD_SECOND_ALARM, FLOOD_THIRD_ALARM, FLOOD_FOURTH_ALARM, FLOOD_FIFTH_ALARM, FLOOD_SIXTH_ALARM};
-int flood_alarm_index = 0;
-bool flood_detected = false;
-unsigned long flood_next_alarm = 0;
+const unsigned long flood_alarms_array[6] = {FLOOD_FIRST_ALARM, FLOOD_SECOND_ALARM, FLOOD_THIRD_ALARM, FLOOD_FOURTH_ALARM, FLOOD_FIFTH_ALARM, FLOOD_SIXTH_ALARM};
+// the alarm says which sensor got wet when there is more than one
+uint8_t flood_sensorCount = 0;
 // flood detection end
 
+// loop statistics begin
+// every run of each task (and every pass of loop()) is timed with the cycle counter and kept in a histogram
+//  read them with the cloud variable loop_stats (min/p50/p99/max in microseconds)
+#define STATS_LOOP 0
+#define STATS_GARAGE 1
+#define STATS_SENSORS 2
+#define STATS_DRYER 3
+#define STATS_PUBLISH 4
+#define STATS_POOL 5
+#define STATS_LAN 6
+#define STATS_SECTIONS 7
+const char *const loopStatsNames[STATS_SECTIONS] = {"loop", "garage", "sensors", "dryer", "publish", "pool", "lan"};
+LatencyHistogram loopStats[STATS_SECTIONS];
+// a cloud variable can hold up to 622 characters
+char loopStatsReport[622];
+// loop statistics end
+
 // pool begin
 //  this is the thermistor used
 //  https://www.adafruit.com/products/372
@@ -204,9 +431,6 @@ unsigned long flood_next_alarm = 0;
 #define THERMISTORNOMINAL 10000
 // temp. for nominal resistance (almost always 25 C)
 #define TEMPERATURENOMINAL 25
-// how many samples to take and average, more takes longer
-// but is more 'smooth'
-#define NUMSAMPLES 5
 // The beta coefficient of the thermistor (usually 3000-4000)
 #define BCOEFFICIENT 3950
 // the value of the 'other' resistor
@@ -215,22 +439,161 @@ unsigned long flood_next_alarm = 0;
 #define POOL_READ_INTERVAL 60000
 #define POOL_NOTIF "POOL"
 
-unsigned long pool_interval = 0;
-int samples[NUMSAMPLES];
+// the thermistor is read by a software timer every POOL_SAMPLE_INTERVAL milliseconds,
+//  the last POOL_OVERSAMPLING readings are kept (64 to 256 make sense, more is smoother)
+//  and POOL_TRIM percent of the lowest and highest ones are discarded before averaging
+//  (50 would use the median)
+//  with LOW_POWER 1 the timer does not run, the processor would have to wake up for every reading:
+//  pool_read() takes the POOL_OVERSAMPLING readings in a burst instead (see pool_burst())
+#define POOL_SAMPLE_INTERVAL 100
+#define POOL_OVERSAMPLING 128
+#define POOL_TRIM 25
+
+TaskId pool_readTask;
 int pool_THERMISTOR = A0;
-// this is coming from http://www.instructables.com/id/Datalogging-with-Spark-Core-Google-Drive/?ALLSTEPS
-char pool_tmp[64]; // String to store the sensor data
-char pool_temperature_ifttt[64];
+AdcSampler<POOL_OVERSAMPLING> pool_sampler(pool_THERMISTOR);
+void pool_sample(); // must be declared before the timer initialization
+Timer pool_sampleTimer(POOL_SAMPLE_INTERVAL, pool_sample);
+// the last temperature of the pool, in hundredths of a degree, formatted when somebody asks for it
+int16_t pool_centi = 0;
+bool pool_valid = false;
+// the temperature goes out as telemetry when it moved this many hundredths of a degree since the last time
+#define POOL_PUBLISH_CHANGE 25
+int16_t pool_centiPublished = 0;
+bool pool_published = false;
 
 float poolCurrentTemp;
 #define POOL_TARGET_TEMP 29
 #define POOL_HYST_TEMP 28
 bool poolReadyAlreadyNotified = false;
 
-// by default, we'll display the temperature in degrees celsius, but if you prefer farenheit please set this to true
-bool useFahrenheit = false;
+// by default, we'll display the temperature in degrees celsius, but if you prefer farenheit please set this to 1
+#define POOL_FAHRENHEIT 0
+
+// ADC reading to pool temperature, computed by the compiler from the thermistor parameters above
+typedef ThermistorTable<POOL_FAHRENHEIT ? TemperatureUnit::FAHRENHEIT : TemperatureUnit::CELSIUS,
+                        THERMISTORNOMINAL, TEMPERATURENOMINAL, BCOEFFICIENT, SERIESRESISTOR>
+    PoolThermistor;
 // pool end
 
+// sensors begin
+// every leak sensor and DHT22 of the unit, one line each
+//  a leak sensor goes on a pin with INPUT_PULLUP that reads low when wet, a DHT22 needs its own
+//  PietteTech_DHT and DhtReader (see the DHT sensor section)
+const SensorDescriptor sensors_table[] = {
+    // name         pin           type          flags               period               alarms              alarm count                    DHT22
+    {"flood",       D7,           SENSOR_LEAK,  FLOOD_SENSOR_FLAGS, FLOOD_SENSOR_PERIOD, flood_alarms_array, arraySize(flood_alarms_array), nullptr},
+    {"dryer",       DHTPIN,       SENSOR_DHT22, 0,                  DHT_SAMPLE_INTERVAL, nullptr,            0,                             &dht_reader},
+};
+SensorState sensors_state[arraySize(sensors_table)];
+void sensors_post(uint8_t index, SensorEvent event); // must be declared before the registry initialization
+SensorRegistry sensors(sensors_table, sensors_state, arraySize(sensors_table), sensors_post);
+
+// the events of the sensors on their way to loop(), see sensors_post(); the ones that do not fit wait
+//  in the registry (dropped() counts them) until loop() collects them
+#define SENSOR_MESSAGES_SIZE 16
+SpscRing<SensorMessage, SENSOR_MESSAGES_SIZE> sensors_messages;
+// sensors end
+
+// sensor thread begin
+// 1: the sensor registry (leak sensors, their alarm schedules, DHT22s) runs in a thread of its own,
+//  of higher priority than loop(), and sends its events through sensors_messages. A publish or a cloud
+//  call that holds loop() up no longer delays the sensors. 0: loop() runs the registry itself
+#define SENSOR_THREAD 1
+#define SENSOR_THREAD_PRIORITY (OS_THREAD_PRIORITY_DEFAULT + 1)
+#define SENSOR_THREAD_STACK 2048
+// longest wait of the thread between two looks at the registry, a leak sensor edge waits at most this
+#define SENSOR_THREAD_POLL 10
+#if SENSOR_THREAD
+Thread *sensors_thread;
+#endif
+// sensor thread end
+
+// status begin
+// the cloud variable status has the state of the whole house as json (see status_report()), it is written
+//  when somebody reads it and something changed since the last time: whoever changes that state sets
+//  status_dirty instead of formatting a variable of its own
+// 1: also the one-value variables of the older versions (pool_tmp, currentTemp, humidity, dryer_stat,
+//  dryer_eta), they take 5 of the 10 cloud variables
+#define STATUS_LEGACY_VARIABLES 0
+bool status_dirty = true;
+// a cloud variable can hold up to 622 characters
+char statusReport[622];
+// status end
+
+// state begin
+// what must survive a reset (firmware update, brownout): it goes to retained memory at the end of the
+//  loop() pass that changed it and to the EEPROM every STATE_EEPROM_INTERVAL if it changed (see
+//  checkpoint.h), setup() takes it back. Whoever changes it sets state_dirty. The dryer detector
+//  changes with every sample of a cycle: it sets state_samplesDirty, retained memory only, and reaches
+//  the EEPROM along with the next change that sets state_dirty
+// timers are kept as the unix time they go off, 0 when the clock was not set: they start over then
+// change STATE_VERSION whenever HouseState changes
+#define STATE_VERSION 2
+#define STATE_EEPROM_ADDRESS 0
+#define STATE_EEPROM_SLOTS 8
+#define STATE_EEPROM_INTERVAL 600000 // 10 minutes
+struct LeakState
+{
+  uint32_t nextAlarmAt;
+  uint8_t alarmIndex;
+  bool active;
+  bool armed;
+};
+struct HouseState
+{
+  bool garageIsOpen;
+  bool garageIsOpenAlarm;
+  bool poolReadyAlreadyNotified;
+  bool dryerOn;
+  uint32_t garageStillOpenAt;
+  uint32_t dryerMaxTimeAt;
+  int16_t lowestHumidity; // hundredths
+  uint8_t dryerDetector[sizeof(DryerDetector)]; // while dryerOn, zeros otherwise
+  uint32_t dryerSeconds; // dryer_seconds() when saved, the detector counts from the reset before
+  uint32_t savedAt;      // unix time, 0 when the clock was not set; these two while dryerOn as well
+  LeakState leaks[arraySize(sensors_table)];
+};
+static_assert(sizeof(HouseState) <= CHECKPOINT_PAYLOAD_MAX, "HouseState does not fit in a checkpoint");
+retained CheckpointRecord state_record;
+Checkpoint state_checkpoint(state_record, STATE_VERSION, STATE_EEPROM_ADDRESS, STATE_EEPROM_SLOTS);
+bool state_dirty = false;
+bool state_samplesDirty = false;
+TaskId state_flushTask;
+// state end
+
+// lan control begin
+// 1: the cloud functions and variables below can also be called from the local network, without the
+//  cloud round trip (see lanControl.h, host/lanLoad load-tests it)
+#define LAN_CONTROL 0
+#define LAN_CONTROL_PORT 5050
+// shared key of the LAN clients, 32 hex digits: the server does not start with this placeholder
+#define LAN_CONTROL_KEY "00000000000000000000000000000000"
+#if LAN_CONTROL
+const LanCommand lan_commands[] = {
+    {"garage_open", garage_open, nullptr},
+    {"garage_close", garage_close, nullptr},
+    {"garage_stat", garage_stat, nullptr},
+    {"pool_get_tmp", pool_get_tmp, nullptr},
+    {"setDryer", setDryer, nullptr},
+    {"status", nullptr, status_report},
+    {"loop_stats", nullptr, loopStats_report},
+};
+LanControl lanControl(LAN_CONTROL_PORT, lan_commands, arraySize(lan_commands));
+#endif
+// lan control end
+
+// low power begin
+// 1: when loop() has nothing to do for a while the processor stops until the next deadline (see
+//  power_sleep()), a garage reed switch or a leak sensor that changes wakes it up before that.
+//  The wifi stays connected meanwhile, the cloud functions and variables keep working
+#define LOW_POWER 0
+// shorter waits are not worth stopping for
+#define POWER_MIN_SLEEP 10
+// a sleep lasts until the next deadline, pool_read() has one every POOL_READ_INTERVAL anyway
+#define POWER_MAX_SLEEP POOL_READ_INTERVAL
+// low power end
+
 /*******************************************************************************
  * Function Name  : setup
  * Description    : this function runs once at system boot
@@ -238,49 +601,145 @@ bool useFahrenheit = false;
 void setup()
 {
 
-  // publish startup message with firmware version
-  Particle.publish(APP_NAME, VERSION, 60, PRIVATE);
+  // the events that were waiting for the cloud before the reset go out first
+  publishQueue.begin();
+
+  // publish startup message with firmware version (it goes out once the cloud is connected)
+  publishQueue.add(APP_NAME, VERSION.c_str(), PUBLISH_EVENT);
 
   Time.zone(TIME_ZONE);
 
-  // flood detection begin
-  pinMode(flood_SENSOR, INPUT_PULLUP);
-  // flood detection end
+#if SENSOR_TRACE
+  Serial.begin(115200);
+  sensorTrace.header(trace_line, sizeof(trace_line), Time.now() - micros() / 1000000);
+  Serial.println(trace_line);
+  // the levels the firmware starts from, the interrupts record every change after this
+  TRACE(digital(micros(), garage_CLOSE, digitalRead(garage_CLOSE)));
+  TRACE(digital(micros(), garage_OPEN, digitalRead(garage_OPEN)));
+  for (uint8_t i = 0; i < sensors.count(); i++)
+  {
+    if (sensors.sensor(i).type == SENSOR_LEAK)
+    {
+      TRACE(digital(micros(), sensors.sensor(i).pin, digitalRead(sensors.sensor(i).pin)));
+    }
+  }
+  publishQueue.onPublished(trace_published);
+#endif
+
+  // the sensors are armed first, they do not need the cloud
+
+  // flood detection and dryer sensors begin
+  for (uint8_t i = 0; i < sensors.count(); i++)
+  {
+    if (sensors.sensor(i).type == SENSOR_LEAK)
+    {
+      flood_sensorCount++;
+    }
+  }
+#if SENSOR_TRACE
+  sensors.onEdge(trace_sensorEdge);
+#endif
+  sensors.begin();
+  // flood detection and dryer sensors end
+
+  // garage begin
+  garage_button.begin();
+  garage_readTask = scheduler.add(garage_monitor, &loopStats[STATS_GARAGE]);
+  scheduler.start(garage_readTask, GARAGE_SAFETY_READ_INTERVAL, GARAGE_SAFETY_READ_INTERVAL);
+  garage_stillOpenTask = scheduler.add(garage_notifyUserIfStillOpen);
+
+  // attach first, so an edge that comes while reading the pins is replayed afterwards
+  pinMode(garage_CLOSE, INPUT_PULLUP);
+  pinMode(garage_OPEN, INPUT_PULLUP);
+  attachInterrupt(garage_CLOSE, garage_closeIsr, CHANGE);
+  attachInterrupt(garage_OPEN, garage_openIsr, CHANGE);
+  garage_setStatus(garage_readPins());
+  // garage end
 
   // pool begin
-  pool_interval = 0;
   pinMode(pool_THERMISTOR, INPUT);
+#if not LOW_POWER
+  pool_sampleTimer.start();
+#endif
+  pool_readTask = scheduler.add(pool_read, &loopStats[STATS_POOL]);
+  scheduler.start(pool_readTask, POOL_READ_INTERVAL, POOL_READ_INTERVAL);
+  // pool end
+
+  // dryer begin
+  dryer_maxTimeTask = scheduler.add(dryer_maxTimeReached);
+
+  temperatureSeries.begin();
+  publishTemperatureTask = scheduler.add(publishDownStairsTemp);
+  scheduler.start(publishTemperatureTask, 0, TEMPERATURE_PUBLISH_INTERVAL);
+  // dryer end
+
+  // state begin
+  state_restore();
+  state_flushTask = scheduler.add(state_flush);
+  scheduler.start(state_flushTask, STATE_EEPROM_INTERVAL, STATE_EEPROM_INTERVAL);
+  System.on(firmware_update, state_firmwareUpdate);
+  // state end
+
+#if SENSOR_THREAD
+  // the registry belongs to the thread from now on, its state was restored above
+  sensors_thread = new Thread("sensors", sensors_threadMain, nullptr, SENSOR_THREAD_PRIORITY, SENSOR_THREAD_STACK);
+#endif
+
+  // then the cloud functions and variables: they go in a table of the system, sent to the cloud
+  //  when it connects
 
   // declare cloud variables
   // https://docs.particle.io/reference/firmware/photon/#particle-variable-
   // Currently, up to 10 cloud variables may be defined and each variable name is limited to a maximum of 12 characters
-  if (Particle.variable("pool_tmp", pool_tmp, STRING) == false)
+  // garage begin
+  if (Particle.function("garage_open", garage_open) == false)
+  {
+    publishQueue.add("ERROR", "Failed to register function garage_open", PUBLISH_EVENT);
+  }
+  if (Particle.function("garage_close", garage_close) == false)
+  {
+    publishQueue.add("ERROR", "Failed to register function garage_close", PUBLISH_EVENT);
+  }
+  if (Particle.function("garage_stat", garage_stat) == false)
+  {
+    publishQueue.add("ERROR", "Failed to register function garage_stat", PUBLISH_EVENT);
+  }
+  // garage end
+
+  // pool begin
+#if STATUS_LEGACY_VARIABLES
+  if (Particle.variable("pool_tmp", status_poolTmp) == false)
   {
-    Particle.publish(APP_NAME, "ERROR: Failed to register variable pool_tmp", 60, PRIVATE);
+    publishQueue.add(APP_NAME, "ERROR: Failed to register variable pool_tmp", PUBLISH_EVENT);
   }
+#endif
 
   bool success = Particle.function("pool_get_tmp", pool_get_tmp);
   if (not success)
   {
-    Particle.publish("ERROR", "Failed to register function pool_get_tmp", 60, PRIVATE);
+    publishQueue.add("ERROR", "Failed to register function pool_get_tmp", PUBLISH_EVENT);
   }
   // pool end
 
   // dryer begin
-  //  Start the first sample immediately
-  DHTnextSampleTime = 0;
-  if (Particle.variable("currentTemp", currentTempString) == false)
+#if STATUS_LEGACY_VARIABLES
+  if (Particle.variable("currentTemp", status_currentTemp) == false)
   {
-    Particle.publish(APP_NAME, "ERROR: Failed to register variable currentTemp", 60, PRIVATE);
+    publishQueue.add(APP_NAME, "ERROR: Failed to register variable currentTemp", PUBLISH_EVENT);
   }
-  if (Particle.variable("humidity", currentHumidityString) == false)
+  if (Particle.variable("humidity", status_humidity) == false)
   {
-    Particle.publish(APP_NAME, "ERROR: Failed to register variable humidity", 60, PRIVATE);
+    publishQueue.add(APP_NAME, "ERROR: Failed to register variable humidity", PUBLISH_EVENT);
   }
   if (Particle.variable("dryer_stat", dryer_stat) == false)
   {
-    Particle.publish(APP_NAME, "ERROR: Failed to register variable dryer_stat", 60, PRIVATE);
+    publishQueue.add(APP_NAME, "ERROR: Failed to register variable dryer_stat", PUBLISH_EVENT);
+  }
+  if (Particle.variable("dryer_eta", dryer_etaMinutes) == false)
+  {
+    publishQueue.add(APP_NAME, "ERROR: Failed to register variable dryer_eta", PUBLISH_EVENT);
   }
+#endif
   // if (Particle.variable("lowestHumid", float2string(lowestHumidity)) == false)
   // {
   //   Particle.publish(APP_NAME, "ERROR: Failed to register variable lowestHumidity", 60, PRIVATE);
@@ -288,71 +747,608 @@ void setup()
   success = Particle.function("setDryer", setDryer);
   if (not success)
   {
-    Particle.publish("ERROR", "Failed to register function setDryer", 60, PRIVATE);
+    publishQueue.add("ERROR", "Failed to register function setDryer", PUBLISH_EVENT);
   }
   // dryer end
+
+  if (Particle.variable("loop_stats", loopStats_report) == false)
+  {
+    publishQueue.add(APP_NAME, "ERROR: Failed to register variable loop_stats", PUBLISH_EVENT);
+  }
+  if (Particle.variable("status", status_report) == false)
+  {
+    publishQueue.add(APP_NAME, "ERROR: Failed to register variable status", PUBLISH_EVENT);
+  }
+
+#if LAN_CONTROL
+  if (not lanControl.begin(LAN_CONTROL_KEY))
+  {
+    publishQueue.add(APP_NAME, "ERROR: LAN control did not start, check LAN_CONTROL_KEY", PUBLISH_EVENT);
+  }
+#endif
+
+#if FAST_BOOT
+  // everything is in place: the system thread connects while loop() runs
+  Particle.connect();
+#endif
 }
 
 // This wrapper is in charge of calling the DHT sensor lib
 void dht_wrapper() { DHT.isrCallback(); }
 
+// This wrapper feeds the pool thermistor readings to the sampler, runs in the timer thread
+void pool_sample()
+{
+#if SENSOR_TRACE
+  uint16_t value = pool_sampler.sample();
+  TRACE(analog(micros(), pool_THERMISTOR, value));
+#else
+  pool_sampler.sample();
+#endif
+}
+
 /*******************************************************************************
  * Function Name  : loop
  * Description    : this function runs all the time
  *******************************************************************************/
 void loop()
 {
+  uint32_t loopStart = loopStats_ticks();
+
+  // release the garage button when its pulse is over
+  garage_button.process();
 
-  flood_check();
-  if (flood_detected)
+  // the garage reed switches moved: replay their edges once they settle
+  if (not garage_edges.empty())
   {
-    flood_notify_user();
+    uint32_t sectionStart = loopStats_ticks();
+    garage_read();
+    loopStats[STATS_GARAGE].record(loopStats_elapsed(sectionStart));
   }
 
-  // // pool temp
-  // if ((millis() - pool_interval >= POOL_READ_INTERVAL) or (pool_interval == 0))
-  // {
-  //   pool_calculate_current_temp();
-  //   pool_notifyTargetTempReached();
-  //   pool_interval = millis(); // update to current millis()
-  // }
+  // garage, pool and temperature publishing run as scheduler tasks
+  scheduler.dispatch();
+
+#if not SENSOR_THREAD
+  // leak sensors and DHT22s, the table is only walked when one of them is due
+  if (sensors.due())
+  {
+    sensors_pass();
+  }
+#endif
+
+  // alarms and readings of the sensors, from their thread or from the pass above, then the ones
+  //  that did not fit in sensors_messages
+  SensorMessage message;
+  while (sensors_messages.pop(message))
+  {
+    sensors_event(message);
+  }
+  while (sensors.collect(message))
+  {
+    sensors_event(message);
+  }
+
+#if LAN_CONTROL
+  {
+    uint32_t sectionStart = loopStats_ticks();
+    lanControl.process();
+    loopStats[STATS_LAN].record(loopStats_elapsed(sectionStart));
+  }
+#endif
+
+  // what changed in this pass goes to retained memory
+  if (state_dirty or state_samplesDirty)
+  {
+    state_save();
+  }
+
+  uint32_t sectionStart = loopStats_ticks();
+  publishQueue.process();
+  loopStats[STATS_PUBLISH].record(loopStats_elapsed(sectionStart));
+
+#if SENSOR_TRACE
+  trace_write();
+#endif
+
+  loopStats[STATS_LOOP].record(loopStats_elapsed(loopStart));
+
+#if LOW_POWER
+  power_sleep();
+#endif
+}
+
+/*******************************************************************************
+ * Function Name  : loop_idleMillis
+ * Description    : how long loop() has nothing to do, unless an interrupt comes
+ * Return         : 0 when there is work pending now, SCHEDULER_NEVER when nothing is scheduled
+ *******************************************************************************/
+unsigned long loop_idleMillis()
+{
+  if (garage_button.busy() or not garage_edges.empty() or not sensors_messages.empty() or sensors.anyHeld() or
+      state_dirty or state_samplesDirty or (publishQueue.pending() and Particle.connected()))
+  {
+    return 0;
+  }
+  unsigned long idle = scheduler.nextDeadline();
+  unsigned long sensorsIdle = sensors.nextDueMillis();
+  if (sensorsIdle < idle)
+  {
+    idle = sensorsIdle;
+  }
+#if LAN_CONTROL
+  unsigned long lanIdle = lanControl.nextPollMillis();
+  if (lanIdle < idle)
+  {
+    idle = lanIdle;
+  }
+#endif
+  return idle;
+}
+
+/*******************************************************************************
+ * Function Name  : state_save
+ * Description    : writes the state that must survive a reset into the retained snapshot,
+                    nothing is written if it did not change
+ * Return         : none
+ *******************************************************************************/
+void state_save()
+{
+  HouseState state;
+  memset(&state, 0, sizeof(state));
+
+  state.garageIsOpen = garageIsOpen;
+  state.garageIsOpenAlarm = garageIsOpenAlarm;
+  state.garageStillOpenAt = state_deadline(scheduler.remaining(garage_stillOpenTask));
+  state.poolReadyAlreadyNotified = poolReadyAlreadyNotified;
+
+  state.dryerOn = dryer_on;
+  state.dryerMaxTimeAt = state_deadline(scheduler.remaining(dryer_maxTimeTask));
+  state.lowestHumidity = toHundredths(lowestHumidity);
+  // the detector only matters while a cycle runs
+  if (dryer_on)
+  {
+    memcpy(state.dryerDetector, &dryer_detector, sizeof(dryer_detector));
+    state.dryerSeconds = dryer_seconds();
+    state.savedAt = Time.isValid() ? Time.now() : 0;
+  }
+
+  for (uint8_t i = 0; i < sensors.count(); i++)
+  {
+    if (sensors.sensor(i).type == SENSOR_LEAK)
+    {
+      // the sensor thread must not change the alarms half way through the copy
+      LeakAlarms alarms;
+      SINGLE_THREADED_BLOCK()
+      {
+        alarms = sensors.leakAlarms(i);
+      }
+      state.leaks[i].active = alarms.active;
+      state.leaks[i].armed = alarms.armed;
+      state.leaks[i].alarmIndex = alarms.index;
+      state.leaks[i].nextAlarmAt = alarms.armed ? state_deadline(alarms.nextInMillis) : 0;
+    }
+  }
+
+  // the system thread may flush the record for a firmware update (state_firmwareUpdate()),
+  //  it must not see it half written
+  SINGLE_THREADED_BLOCK()
+  {
+    state_checkpoint.save(&state, sizeof(state), state_dirty);
+  }
+  state_dirty = false;
+  state_samplesDirty = false;
+}
+
+/*******************************************************************************
+ * Function Name  : state_restore
+ * Description    : takes back the state saved before the reset, if there is one; runs at the end
+                    of setup(), once the garage pins were read and the tasks added
+ * Return         : none
+ *******************************************************************************/
+void state_restore()
+{
+  HouseState state;
+  CheckpointSource source = state_checkpoint.restore(&state, sizeof(state));
+  if (source == CHECKPOINT_NONE)
+  {
+    state_dirty = true;
+    return;
+  }
+
+  // the door is still open: the alarm goes off when it was going to, or not again if it went off already
+  garageIsOpenAlarm = state.garageIsOpenAlarm;
+  if (garage_status == GARAGE_OPEN and garageIsOpenAlarm)
+  {
+    garageIsOpen = false;
+    scheduler.stop(garage_stillOpenTask);
+  }
+  else if (garage_status == GARAGE_OPEN and state.garageIsOpen)
+  {
+    scheduler.start(garage_stillOpenTask, state_remaining(state.garageStillOpenAt, GARAGE_STILL_OPEN_ALARM));
+  }
+  // closed while the device was down
+  garage_notifyUserIfStillOpenAndWasClosed();
+
+  poolReadyAlreadyNotified = state.poolReadyAlreadyNotified;
+
+  lowestHumidity = state.lowestHumidity / 100.0f;
+  if (state.dryerOn)
+  {
+    // the detector goes on with the cycle, with the parameters of this firmware
+    DryerDetectorConfig config = dryer_detector.config;
+    memcpy(&dryer_detector, state.dryerDetector, sizeof(dryer_detector));
+    dryer_detector.config = config;
+    // its times move to this reset, less the time the device was down when the clock says it
+    int32_t downSeconds = state.savedAt != 0 and Time.isValid() ? (int32_t)(Time.now() - state.savedAt) : 0;
+    dryer_detector.shiftTime(dryer_seconds() - state.dryerSeconds - (downSeconds > 0 ? downSeconds : 0));
+    dryer_setStatus(DRYER_ON);
+    scheduler.start(dryer_maxTimeTask, state_remaining(state.dryerMaxTimeAt, DRYER_MAX_TIMER));
+  }
+
+  for (uint8_t i = 0; i < sensors.count(); i++)
+  {
+    const SensorDescriptor &sensor = sensors.sensor(i);
+    if (sensor.type == SENSOR_LEAK and sensor.alarmCount > 0)
+    {
+      LeakAlarms alarms;
+      alarms.active = state.leaks[i].active;
+      alarms.armed = state.leaks[i].armed;
+      alarms.index = state.leaks[i].alarmIndex < sensor.alarmCount ? state.leaks[i].alarmIndex : sensor.alarmCount - 1;
+      alarms.nextInMillis = state_remaining(state.leaks[i].nextAlarmAt, sensor.alarms[alarms.index]);
+      sensors.restoreLeakAlarms(i, alarms);
+    }
+  }
+
+  status_dirty = true;
+  state_dirty = true;
+  publishQueue.add(APP_NAME, source == CHECKPOINT_RETAINED ? "State restored from retained memory"
+                                                             : "State restored from EEPROM",
+                   PUBLISH_EVENT);
+}
+
+/*******************************************************************************
+ * Function Name  : state_deadline
+ * Description    : the unix time a timer goes off, for the snapshot
+ * Return         : 0 when the timer is not running or the clock is not set
+ *******************************************************************************/
+uint32_t state_deadline(unsigned long remainingMillis)
+{
+  if (remainingMillis == SCHEDULER_NEVER or not Time.isValid())
+  {
+    return 0;
+  }
+  return Time.now() + (remainingMillis + 999) / 1000;
+}
+
+/*******************************************************************************
+ * Function Name  : state_remaining
+ * Description    : milliseconds until a timer of the snapshot goes off, at most fullMillis
+ * Return         : fullMillis when the deadline is not known (the timer starts over)
+ *******************************************************************************/
+unsigned long state_remaining(uint32_t deadline, unsigned long fullMillis)
+{
+  if (deadline == 0 or not Time.isValid())
+  {
+    return fullMillis;
+  }
+  long seconds = (long)(deadline - (uint32_t)Time.now());
+  if (seconds <= 0)
+  {
+    return 0;
+  }
+  return (unsigned long)seconds < fullMillis / 1000 ? seconds * 1000UL : fullMillis;
+}
+
+/*******************************************************************************
+ * Function Name  : state_flush
+ * Description    : writes the snapshot to the EEPROM if it changed, runs every STATE_EEPROM_INTERVAL
+ * Return         : none
+ *******************************************************************************/
+void state_flush()
+{
+  state_checkpoint.flush();
+}
+
+/*******************************************************************************
+ * Function Name  : state_firmwareUpdate
+ * Description    : a new firmware may move the retained memory around: the snapshot goes to the
+                    EEPROM before the update starts; it runs on the system thread, so it takes the
+                    snapshot of the last loop() pass as it is, never one that state_save() is
+                    writing: both hold the other thread off while they use the record
+ * Return         : none
+ *******************************************************************************/
+void state_firmwareUpdate(system_event_t event, int param)
+{
+  if (param == firmware_update_begin)
+  {
+    SINGLE_THREADED_BLOCK()
+    {
+      state_checkpoint.flush();
+    }
+  }
+}
+
+/*******************************************************************************
+ * Function Name  : power_sleepMillis
+ * Description    : how long the processor can stop now
+ * Return         : 0 when it is not worth it, or while the cloud is not connected (the system
+                    is reconnecting)
+ *******************************************************************************/
+unsigned long power_sleepMillis()
+{
+  if (not Particle.connected())
+  {
+    return 0;
+  }
+  unsigned long idle = loop_idleMillis();
+  if (idle < POWER_MIN_SLEEP)
+  {
+    return 0;
+  }
+  return idle < POWER_MAX_SLEEP ? idle : POWER_MAX_SLEEP;
+}
+
+/*******************************************************************************
+ * Function Name  : power_sleep
+ * Description    : stops the processor until the next deadline of loop(), or until a garage
+                    reed switch or a leak sensor changes; the wifi is kept in standby
+ * Return         : none
+ *******************************************************************************/
+void power_sleep()
+{
+  unsigned long sleepMillis = power_sleepMillis();
+  if (sleepMillis == 0)
+  {
+    return;
+  }
+
+  SystemSleepConfiguration config;
+  config.mode(SystemSleepMode::STOP)
+      .gpio(garage_CLOSE, CHANGE)
+      .gpio(garage_OPEN, CHANGE)
+      .duration(sleepMillis)
+      .network(NETWORK_INTERFACE_WIFI_STA, SystemSleepNetworkFlag::INACTIVE_STANDBY);
+  for (const SensorDescriptor &sensor : sensors_table)
+  {
+    if (sensor.type == SENSOR_LEAK)
+    {
+      config.gpio(sensor.pin, CHANGE);
+    }
+  }
+  System.sleep(config);
+}
+
+#if SENSOR_TRACE
+/*******************************************************************************
+ * Function Name  : trace_write
+ * Description    : writes the queued trace records to the serial port, and the cloud connection when it changed
+ * Return         : none
+ *******************************************************************************/
+void trace_write()
+{
+  if (Particle.connected() != trace_connected)
+  {
+    trace_connected = not trace_connected;
+    TRACE(cloud(micros(), trace_connected));
+  }
+  while (sensorTrace.nextLine(trace_line, sizeof(trace_line)))
+  {
+    Serial.println(trace_line);
+  }
+}
+
+/*******************************************************************************
+ * Function Name  : trace_published
+ * Description    : called by the publish queue for every event the cloud took, it goes in the trace
+                    after the readings that came before it
+ * Return         : none
+ *******************************************************************************/
+void trace_published(const char *eventName, const char *eventData)
+{
+  trace_write();
+  sensorTrace.publishLine(trace_line, sizeof(trace_line), micros(), eventName, eventData);
+  Serial.println(trace_line);
+}
+
+/*******************************************************************************
+ * Function Name  : trace_sensorEdge
+ * Description    : a leak sensor of the table changed, runs in its interrupt
+ * Return         : none
+ *******************************************************************************/
+void trace_sensorEdge(uint8_t index, int level)
+{
+  TRACE(digital(micros(), sensors.sensor(index).pin, level));
+}
 
-  dryer_status();
+/*******************************************************************************
+ * Function Name  : trace_called
+ * Description    : a cloud function is running, it goes in the trace so the replay calls it too
+ * Return         : none
+ *******************************************************************************/
+void trace_called(const char *name, const char *argument)
+{
+  trace_write();
+  sensorTrace.callLine(trace_line, sizeof(trace_line), micros(), name, argument);
+  Serial.println(trace_line);
+}
+#endif
 
-  // publish temp every 5 minutes
-  static unsigned long lastPublish = 0 - 300000;
-  if (millis() - lastPublish >= 300000)
+/*******************************************************************************
+ * Function Name  : publishDownStairsTemp
+ * Description    : publishes the samples of the DHT22 taken since the last time in one event,
+                    runs every TEMPERATURE_PUBLISH_INTERVAL
+                    while offline the samples stay in the series, oldest first when the cloud is back
+ * Return         : none
+ *******************************************************************************/
+void publishDownStairsTemp()
+{
+  if (temperatureSeries.size() == 0 or not Particle.connected())
   {
-    lastPublish = millis();
-    Particle.publish("DownStairs_Temp", currentTempString, 60, PRIVATE);
-    // Blynk.virtualWrite(V8, currentTemp);
+    return;
+  }
+
+  uint16_t samples;
+#if TEMPERATURE_SERIES_PACKED
+  sampleCodec_encode(temperatureSeries, 2, temperatureSeriesBatch, sizeof(temperatureSeriesBatch), samples);
+#else
+  temperatureSeries.format(temperatureSeriesBatch, sizeof(temperatureSeriesBatch), 2, samples);
+#endif
+
+  // not telemetry: the queue would replace a batch still waiting with the next one
+  //  and never stamped, every sample of the batch has its time already
+  if (samples > 0 and publishQueue.add(TEMPERATURE_SERIES_EVENT, temperatureSeriesBatch, PUBLISH_EVENT, false))
+  {
+    temperatureSeries.drop(samples);
   }
+  // Blynk.virtualWrite(V8, currentTemp);
+}
+
+/*******************************************************************************
+ * Function Name  : loopStats_report
+ * Description    : cloud variable loop_stats, formatted only when somebody reads it
+ * Return         : "section:n=..,min=..,p50=..,p99=..,max=..;" for every section of loop()
+ *******************************************************************************/
+String loopStats_report()
+{
+  loopStats_format(loopStatsReport, sizeof(loopStatsReport), loopStats, loopStatsNames, STATS_SECTIONS);
+  return String(loopStatsReport);
 }
 
+/*******************************************************************************
+ * Function Name  : status_report
+ * Description    : cloud variable status, written again only if something changed since the last read
+ * Return         : {"garage":..,"pool":..,"temp":..,"hum":..,"dryer":..,"eta":..,"lowHum":..,"wet":[..]}
+                    readings not taken yet are null, wet has the names of the leak sensors that are wet
+ *******************************************************************************/
+String status_report()
+{
+  if (status_dirty)
+  {
+    status_dirty = false;
+    status_format();
+  }
+  return String(statusReport);
+}
+
+void status_format()
+{
+  JsonWriter json(statusReport, sizeof(statusReport));
+
+  json.string("garage", garageStatusName(garage_status));
+  if (pool_valid)
+  {
+    json.number("pool", pool_centi, 2);
+  }
+  else
+  {
+    json.null("pool");
+  }
+
+  if (currentTempValid)
+  {
+    json.number("temp", toHundredths(currentTemp), 2);
+    json.number("hum", toHundredths(currentHumidity), 2);
+  }
+  else
+  {
+    json.null("temp");
+    json.null("hum");
+  }
+  json.string("dryer", dryer_stat);
+  json.number("eta", dryer_etaMinutes);
+  json.number("lowHum", toHundredths(lowestHumidity), 2);
+
+  json.beginArray("wet");
+  for (uint8_t i = 0; i < sensors.count(); i++)
+  {
+    if (sensors.sensor(i).type == SENSOR_LEAK and sensors.state(i).active)
+    {
+      json.item(sensors.sensor(i).name);
+    }
+  }
+  json.endArray();
+  json.finish();
+}
+
+#if STATUS_LEGACY_VARIABLES
+/*******************************************************************************
+ * Function Name  : status_poolTmp, status_currentTemp, status_humidity
+ * Description    : cloud variables pool_tmp ({"t":25.30}, google sheets reads it), currentTemp and humidity
+ *******************************************************************************/
+String status_poolTmp()
+{
+  char poolTmp[24] = "";
+  if (pool_valid)
+  {
+    strcpy(poolTmp, "{\"t\":");
+    size_t length = strlen(poolTmp);
+    fixedFormat(poolTmp + length, sizeof(poolTmp) - length, pool_centi, 2);
+    fixedAppend(poolTmp, sizeof(poolTmp), "}");
+  }
+  return String(poolTmp);
+}
+
+String status_currentTemp()
+{
+  char value[16];
+  fixedFormatFloat(value, sizeof(value), currentTemp, 2);
+  return String(value);
+}
+
+String status_humidity()
+{
+  char value[16];
+  fixedFormatFloat(value, sizeof(value), currentHumidity, 2);
+  return String(value);
+}
+#endif
+
+/*******************************************************************************
+ * Function Name  : garage_toggle
+ * Description    : presses the garage button, or queues the press if the button is already pressed
+ *******************************************************************************/
 void garage_toggle()
 {
   // Particle.publish(GARAGE_NOTIF, "garage_open triggered", 60, PRIVATE);
-  Particle.publish("garage", "garage_toggle triggered", 60, PRIVATE);
-  digitalWrite(garage_BUTTON, HIGH);
-  delay(1000);
-  digitalWrite(garage_BUTTON, LOW);
+  if (garage_button.trigger())
+  {
+    publishQueue.add("garage", "garage_toggle triggered", PUBLISH_EVENT);
+  }
+}
+
+/*******************************************************************************
+ * Function Name  : garage_buttonReleased
+ * Description    : called from loop() when a garage button pulse is over
+ *******************************************************************************/
+void garage_buttonReleased(pin_t pin)
+{
+  // telemetry: it goes out when the rate limit has room, a newer release replaces one still waiting
+  publishQueue.add("garage", "garage button released", PUBLISH_TELEMETRY);
 }
 
 /*******************************************************************************
  * Function Name  : garage_open
  * Description    : garage_BUTTON goes up for one second ONLY if the garage is closed
+                     the button is released later by loop(), so this returns right away
  * Parameters     : String parameter: if equal to "scheduleNotification" then a pushbullet notification
                      will be sent when the garage starts to open
- * Return         : 0 if success, -1 if fails (which means the garage was already open)
+ * Return         : 0 if success, -1 if fails (which means the garage was already open
+                     or the button is still being pressed)
  *******************************************************************************/
 int garage_open(String parameter)
 {
-  if (garage_status_string == GARAGE_CLOSED)
+  TRACE_CALL("garage_open", parameter.c_str());
+
+  if (garage_button.busy())
+  {
+    return -1;
+  }
+
+  if (garage_whatIsTheStatus() == GARAGE_CLOSED)
   {
     // Particle.publish(GARAGE_NOTIF, "garage_open triggered", 60, PRIVATE);
-    digitalWrite(garage_BUTTON, HIGH);
-    delay(1000);
-    digitalWrite(garage_BUTTON, LOW);
+    garage_button.trigger();
 
     // Particle.publish("DEBUG", "parameter: " + parameter, 60, PRIVATE);
     if (parameter == "scheduleNotification")
@@ -369,17 +1365,24 @@ int garage_open(String parameter)
 /*******************************************************************************
  * Function Name  : garage_close
  * Description    : garage_BUTTON goes up for one second only if the garage is open
+                     the button is released later by loop(), so this returns right away
  * Parameters     : String parameter: if equal to "scheduleNotification" then a pushbullet notification
                      will be sent when the garage starts to close
- * Return         : 0 if success, -1 if fails (which means the garage was already closed)
+ * Return         : 0 if success, -1 if fails (which means the garage was already closed
+                     or the button is still being pressed)
  *******************************************************************************/
 int garage_close(String parameter)
 {
-  if (garage_status_string == GARAGE_OPEN)
+  TRACE_CALL("garage_close", parameter.c_str());
+
+  if (garage_button.busy())
+  {
+    return -1;
+  }
+
+  if (garage_whatIsTheStatus() == GARAGE_OPEN)
   {
-    digitalWrite(garage_BUTTON, HIGH);
-    delay(1000);
-    digitalWrite(garage_BUTTON, LOW);
+    garage_button.trigger();
 
     // Particle.publish("DEBUG", "parameter: " + parameter, 60, PRIVATE);
     if (parameter == "scheduleNotification")
@@ -393,34 +1396,105 @@ int garage_close(String parameter)
   return -1;
 }
 
+/*******************************************************************************
+ * Function Name  : garage_closeIsr, garage_openIsr
+ * Description    : interrupt handlers of the reed switches, they only queue the edge for garage_read()
+ *******************************************************************************/
+void garage_closeIsr()
+{
+  garage_lastEdgeMicros = micros();
+  garage_edges.push({(uint8_t)garage_CLOSE, (uint8_t)digitalRead(garage_CLOSE), garage_lastEdgeMicros});
+  TRACE(digital(garage_lastEdgeMicros, garage_CLOSE, digitalRead(garage_CLOSE)));
+}
+
+void garage_openIsr()
+{
+  garage_lastEdgeMicros = micros();
+  garage_edges.push({(uint8_t)garage_OPEN, (uint8_t)digitalRead(garage_OPEN), garage_lastEdgeMicros});
+  TRACE(digital(garage_lastEdgeMicros, garage_OPEN, digitalRead(garage_OPEN)));
+}
+
 /*******************************************************************************
  * Function Name  : garage_read()
- * Description    : reads and publishes the status of the garage, intended for using it with a service like ifttt
+ * Description    : replays the queued reed switch edges into the status of the garage
+                     the edges are left in the queue until the switches are quiet for GARAGE_DEBOUNCE_MICROS,
+                     then every burst of bounces on the same switch counts as its last edge
  * Return         : 0
  *******************************************************************************/
 int garage_read()
 {
-  String previous_garage_status_string = garage_status_string;
-  garage_status_string = garage_whatIsTheStatus();
-
-  // if status of the garage changed from last scan, publish the new status
-  if (previous_garage_status_string != garage_status_string)
+  if (garage_edges.empty() or (uint32_t)(micros() - garage_lastEdgeMicros) < GARAGE_DEBOUNCE_MICROS)
   {
+    return 0;
+  }
 
-    if (scheduleNotification)
+  GarageEdge edge;
+  GarageEdge next;
+  while (garage_edges.pop(edge))
+  {
+    while (garage_edges.peek(next) and next.pin == edge.pin and (uint32_t)(next.micros - edge.micros) < GARAGE_DEBOUNCE_MICROS)
     {
-      // Particle.publish(PUSHBULLET_NOTIF_PERSONAL, "Your garage door is " + garage_status_string + getTime(), 60, PRIVATE);
-      scheduleNotification = false;
+      garage_edges.pop(edge);
     }
+    garage_applyEdge(edge.pin, edge.level);
+  }
 
-    // Particle.publish("STATUS", "Your garage door is " + garage_status_string);
-    // String tempStatus = "Your garage door is " + garage_status_string + getTime();
-    // Particle.publish("googleDocs", "{\"my-name\":\"" + tempStatus + "\"}", 60, PRIVATE);
+  // the queue overflowed, so some edges are missing: trust the pins instead
+  if (garage_edges.dropped() != garage_edgesLost)
+  {
+    garage_edgesLost = garage_edges.dropped();
+    garage_setStatus(garage_readPins());
   }
 
   return 0;
 }
 
+/*******************************************************************************
+ * Function Name  : garage_applyEdge
+ * Description    : a switch going low means the door got there,
+                     a switch going high means the door is leaving
+ *******************************************************************************/
+void garage_applyEdge(uint8_t pin, uint8_t level)
+{
+  if (pin == garage_CLOSE)
+  {
+    garage_setStatus(level == LOW ? GARAGE_CLOSED : GARAGE_OPENING);
+  }
+  if (pin == garage_OPEN)
+  {
+    garage_setStatus(level == LOW ? GARAGE_OPEN : GARAGE_CLOSING);
+  }
+}
+
+/*******************************************************************************
+ * Function Name  : garage_setStatus
+ * Description    : updates the status of the garage and fires the related alarms if it changed
+ * Return         : none
+ *******************************************************************************/
+void garage_setStatus(GarageStatus status)
+{
+  if (garage_status == status)
+  {
+    return;
+  }
+
+  garage_status = status;
+  status_dirty = true;
+
+  if (scheduleNotification)
+  {
+    notifier.send(notify_garageScheduled, garageStatusName(garage_status));
+    scheduleNotification = false;
+  }
+
+  // Particle.publish("STATUS", "Your garage door is " + String(garageStatusName(garage_status)));
+  // String tempStatus = "Your garage door is " + String(garageStatusName(garage_status)) + getTime();
+  // Particle.publish("googleDocs", "{\"my-name\":\"" + tempStatus + "\"}", 60, PRIVATE);
+
+  garage_checkIfStillOpen();
+  garage_notifyUserIfStillOpenAndWasClosed();
+}
+
 /*******************************************************************************
  * Function Name  : garage_stat  // function name cannot be longer than 12 chars otherwise it wont be registered!
  * Description    : reads and publishes the status of the garage, intended for using it with a service like ifttt
@@ -428,11 +1502,30 @@ int garage_read()
  *******************************************************************************/
 int garage_stat(String args)
 {
-  // Particle.publish(PUSHBULLET_NOTIF_PERSONAL, "Your garage door is " + garage_whatIsTheStatus() + getTime(), 60, PRIVATE);
-  Particle.publish(PUSHBULLET_NOTIF_PERSONAL, "Your garage door is " + garage_whatIsTheStatus(), 60, PRIVATE);
+  TRACE_CALL("garage_stat", args.c_str());
+
+  notifier.send(notify_garageIs, garageStatusName(garage_whatIsTheStatus()));
   return 0;
 }
 
+/*******************************************************************************
+ * Function Name  : garage_monitor
+ * Description    : reads the reed switches in case an edge was missed, runs every GARAGE_SAFETY_READ_INTERVAL
+ * Return         : none
+ *******************************************************************************/
+void garage_monitor()
+{
+  garage_read();
+
+  // edges still bouncing, they will be replayed by loop()
+  if (not garage_edges.empty())
+  {
+    return;
+  }
+
+  garage_setStatus(garage_readPins());
+}
+
 /*******************************************************************************
  * Function Name  : garage_checkIfStillOpen
  * Description    : nofities the user if the garage is open for more than 30 minutes
@@ -440,7 +1533,7 @@ int garage_stat(String args)
  *******************************************************************************/
 void garage_checkIfStillOpen()
 {
-  if (garage_status_string == GARAGE_OPEN)
+  if (garage_status == GARAGE_OPEN)
   {
 
     if (garageIsOpen)
@@ -450,18 +1543,21 @@ void garage_checkIfStillOpen()
 
     garageIsOpen = true;
 
-    // reset alarm timer
-    garageIsOpenTimer = 0;
+    // start alarm timer
+    scheduler.start(garage_stillOpenTask, GARAGE_STILL_OPEN_ALARM);
   }
   else
   {
     garageIsOpen = false;
+    scheduler.stop(garage_stillOpenTask);
   }
+  state_dirty = true;
 }
 
 /*******************************************************************************
  * Function Name  : garage_notifyUserIfStillOpen
  * Description    : will fire notifications to user if the garage is left open
+                    runs GARAGE_STILL_OPEN_ALARM after the garage was opened
  * Return         : none
  *******************************************************************************/
 void garage_notifyUserIfStillOpen()
@@ -472,19 +1568,15 @@ void garage_notifyUserIfStillOpen()
     return;
   }
 
-  if (garageIsOpenTimer < GARAGE_STILL_OPEN_ALARM)
-  {
-    return;
-  }
-
   // time is up, so reset flag
   garageIsOpen = false;
 
   // set flag for alarm
   garageIsOpenAlarm = true;
+  state_dirty = true;
 
   // send an alarm to user (this one goes to pushbullet servers via a webhook)
-  // Particle.publish(PUSHBULLET_NOTIF_PERSONAL, "Garage still open!" + getTime(), 60, PRIVATE);
+  notifier.send(notify_garageStillOpen);
 }
 
 /*******************************************************************************
@@ -496,62 +1588,99 @@ void garage_notifyUserIfStillOpen()
 void garage_notifyUserIfStillOpenAndWasClosed()
 {
 
-  if ((garage_status_string == GARAGE_CLOSED) and garageIsOpenAlarm)
+  if ((garage_status == GARAGE_CLOSED) and garageIsOpenAlarm)
   {
 
     // reset flag
     garageIsOpenAlarm = false;
+    state_dirty = true;
 
     // send an alarm to user (this one goes to pushbullet servers via a webhook)
-    // Particle.publish(PUSHBULLET_NOTIF_PERSONAL, "Garage was finally closed!" + getTime(), 60, PRIVATE);
+    notifier.send(notify_garageClosed);
   }
 }
 
 /*******************************************************************************
  * Function Name  : garage_whatIsTheStatus()
- * Description    : reads the status of the garage
- * Return         : the status of the garage according to
-                     #define GARAGE_OPEN "open"
-                     #define GARAGE_CLOSED "closed"
-                     #define GARAGE_OPENING "opening"
-                     #define GARAGE_CLOSING "closing"
+ * Description    : returns the status of the garage, after replaying any pending reed switch edge
+ * Return         : the status of the garage, see GarageStatus in homeStatus.h
 *******************************************************************************/
-String garage_whatIsTheStatus()
+GarageStatus garage_whatIsTheStatus()
+{
+  garage_read();
+  return garage_status;
+}
+
+/*******************************************************************************
+ * Function Name  : garage_readPins()
+ * Description    : works out the status of the garage from the level of the reed switches
+ * Return         : the status of the garage, see garage_whatIsTheStatus()
+*******************************************************************************/
+GarageStatus garage_readPins()
 {
   int open = digitalRead(garage_OPEN);
   int closed = digitalRead(garage_CLOSE);
-  String previous_garage_status_string = garage_status_string;
 
   // input goes low when the reed switch is activated
-  if (not closed)
+  if (not open)
   {
-    garage_status_string = GARAGE_CLOSED;
+    return GARAGE_OPEN;
   }
 
   // input goes low when the reed switch is activated
-  if (not open)
+  if (not closed)
   {
-    garage_status_string = GARAGE_OPEN;
+    return GARAGE_CLOSED;
   }
 
   // if both inputs are high, it means that the garage is moving
   //  so if it was open, we believe it's closing now
   //  and if it was closed, we believe it's opening now
-  if (open and closed)
+  if (garage_status == GARAGE_OPEN)
   {
-    if (previous_garage_status_string == GARAGE_OPEN)
-    {
-      garage_status_string = GARAGE_CLOSING;
-    }
-    if (previous_garage_status_string == GARAGE_CLOSED)
-    {
-      garage_status_string = GARAGE_OPENING;
-    }
+    return GARAGE_CLOSING;
+  }
+  if (garage_status == GARAGE_CLOSED)
+  {
+    return GARAGE_OPENING;
   }
 
-  return garage_status_string;
+  return garage_status;
 }
 
+/*******************************************************************************
+ * Function Name  : pool_read
+ * Description    : reads the pool temperature and notifies if it's ready, runs every POOL_READ_INTERVAL
+ * Return         : none
+ *******************************************************************************/
+void pool_read()
+{
+#if LOW_POWER
+  pool_burst();
+#endif
+  if (pool_calculate_current_temp() != 0)
+  {
+    return;
+  }
+  pool_notifyTargetTempReached();
+}
+
+#if LOW_POWER
+/*******************************************************************************
+ * Function Name  : pool_burst
+ * Description    : fills the window of the pool sampler at once, the software timer does not
+                    sample with LOW_POWER 1
+ * Return         : none
+ *******************************************************************************/
+void pool_burst()
+{
+  for (uint16_t i = 0; i < POOL_OVERSAMPLING; i++)
+  {
+    pool_sample();
+  }
+}
+#endif
+
 /*******************************************************************************
  * Function Name  : pool_notifyTargetTempReached
  * Description    : notify the user that the pool is ready for jumping in!
@@ -561,83 +1690,60 @@ void pool_notifyTargetTempReached()
 {
   if ((not poolReadyAlreadyNotified) and (poolCurrentTemp > POOL_TARGET_TEMP))
   {
-    // Particle.publish(PUSHBULLET_NOTIF_HOME, "Pool is ready! (" + String(POOL_TARGET_TEMP) + "°C)", 60, PRIVATE);
+    notifier.send(notify_poolReady, POOL_TARGET_TEMP, PoolThermistor::symbol());
     poolReadyAlreadyNotified = true;
+    state_dirty = true;
   }
 
   // now reset notif if temp goes lower than POOL_HYST_TEMP
-  if (poolCurrentTemp < POOL_HYST_TEMP)
+  if (poolReadyAlreadyNotified and (poolCurrentTemp < POOL_HYST_TEMP))
   {
     poolReadyAlreadyNotified = false;
+    state_dirty = true;
   }
 }
 
 /*******************************************************************************
  * Function Name  : pool_calculate_current_temp
- * Description    : read the value of the thermistor, convert it to degrees and store it in pool_tmp
- * Return         : 0
+ * Description    : filter the readings of the thermistor, convert them to degrees and store them in pool_centi
+                    the conversion is a lookup in PoolThermistor, no floating point math
+ * Return         : 0, -1 if there are not enough readings yet
  *******************************************************************************/
 int pool_calculate_current_temp()
 {
-  uint8_t i;
-  float average;
-
-  // take N samples in a row, with a slight delay
-  for (i = 0; i < NUMSAMPLES; i++)
+  // the window is not full yet (just booted)
+  if (not pool_sampler.ready())
   {
-    samples[i] = analogRead(pool_THERMISTOR);
-    delay(10);
+    return -1;
   }
 
-  // average all the samples out
-  average = 0;
-  for (i = 0; i < NUMSAMPLES; i++)
-  {
-    average += samples[i];
-  }
-  average /= NUMSAMPLES;
+  // drop the outliers and average the rest, then look up the temperature (in hundredths of a degree)
+  float average = pool_sampler.filtered(POOL_TRIM);
+  int16_t centi = PoolThermistor::centi((uint16_t)(average + 0.5f));
 
-  // convert the value to resistance
-  average = (4095 / average) - 1;
-  average = SERIESRESISTOR / average;
-
-  float steinhart;
-  steinhart = average / THERMISTORNOMINAL;          // (R/Ro)
-  steinhart = log(steinhart);                       // ln(R/Ro)
-  steinhart /= BCOEFFICIENT;                        // 1/B * ln(R/Ro)
-  steinhart += 1.0 / (TEMPERATURENOMINAL + 273.15); // + (1/To)
-  steinhart = 1.0 / steinhart;                      // Invert
-  steinhart -= 273.15;                              // convert to C
+  // assign to global variable
+  poolCurrentTemp = centi / 100.0f;
+  pool_centi = centi;
+  pool_valid = true;
+  status_dirty = true;
 
-  // Convert Celsius to Fahrenheit
-  // source: http://playground.arduino.cc/ComponentLib/Thermistor2#TheSimpleCode
-  if (useFahrenheit)
+  // publish readings, only when they say something new: the cloud variables have the latest one
+  if (pool_published and abs(centi - pool_centiPublished) < POOL_PUBLISH_CHANGE)
   {
-    steinhart = (steinhart * 9.0) / 5.0 + 32.0;
+    return 0;
   }
 
-  // assign to global variable
-  poolCurrentTemp = steinhart;
-
-  int steinhart1 = (steinhart - (int)steinhart) * 100;
-  // for negative temperatures
-  steinhart1 = abs(steinhart1);
-
-  char currentPoolTempChar[32];
-  sprintf(currentPoolTempChar, "%0d.%d", (int)steinhart, steinhart1);
-  String currentPoolTempString = String(currentPoolTempChar);
+  char tempInChar[16];
+  fixedFormat(tempInChar, sizeof(tempInChar), centi, 2);
 
-  // publish readings
-  Particle.publish(APP_NAME, "Pool temperature: " + currentPoolTempString + "°C", 60, PRIVATE);
-
-  char tempInChar[32];
-  sprintf(tempInChar, "%0d.%d", (int)steinhart, steinhart1);
-
-  // Write temperature to string, google sheets will get this variable
-  sprintf(pool_tmp, "{\"t\":%s}", tempInChar);
-
-  // this variable will be published by function status()
-  sprintf(pool_temperature_ifttt, "%s", tempInChar);
+  char message[64] = "Pool temperature: ";
+  fixedAppend(message, sizeof(message), tempInChar);
+  fixedAppend(message, sizeof(message), PoolThermistor::symbol());
+  if (publishQueue.add(APP_NAME, message, PUBLISH_TELEMETRY))
+  {
+    pool_centiPublished = centi;
+    pool_published = true;
+  }
 
   return 0;
 }
@@ -649,77 +1755,117 @@ int pool_calculate_current_temp()
  *******************************************************************************/
 int pool_get_tmp(String args)
 {
-  Particle.publish(PUSHBULLET_NOTIF_PERSONAL, "Your pool is at " + String(pool_temperature_ifttt) + " degrees", 60, PRIVATE);
+  TRACE_CALL("pool_get_tmp", args.c_str());
+
+  notifier.send(notify_poolTemp, pool_valid ? NotificationArg(pool_centi, 2) : NotificationArg());
   return 0;
 }
 
 /*******************************************************************************
- * Function Name  : flood_check
- * Description    : check water leak sensor at FLOOD_READ_INTERVAL, turns on led on D7 and raises alarm if water is detected
- * Return         : 0
+ * Function Name  : sensors_pass
+ * Description    : one pass of the sensor registry over the sensors that are due, in the sensor
+                    thread or in loop() (SENSOR_THREAD 0)
+ * Return         : none
+ *******************************************************************************/
+void sensors_pass()
+{
+  uint32_t sectionStart = loopStats_ticks();
+  sensors.process();
+  loopStats[STATS_SENSORS].record(loopStats_elapsed(sectionStart));
+}
+
+#if SENSOR_THREAD
+/*******************************************************************************
+ * Function Name  : sensors_threadMain
+ * Description    : the sensor thread: a pass of the registry when a sensor is due, then it sleeps
+                    until the next one is, SENSOR_THREAD_POLL at most so a leak sensor edge is not
+                    left waiting; never less than 1 ms, loop() has a lower priority
+ * Return         : never
  *******************************************************************************/
-int flood_check()
+void sensors_threadMain(void *param)
 {
-  if (flood_timer < FLOOD_READ_INTERVAL)
+  while (true)
   {
-    return 0;
+    if (sensors.due())
+    {
+      sensors_pass();
+    }
+    unsigned long wait = sensors.nextDueMillis();
+    if (wait > SENSOR_THREAD_POLL)
+    {
+      wait = SENSOR_THREAD_POLL;
+    }
+    delay(wait < 1 ? 1 : wait);
   }
+}
+#endif
 
-  // time is up, so reset timer
-  flood_timer = 0;
-
-  if (not digitalRead(flood_SENSOR))
+/*******************************************************************************
+ * Function Name  : sensors_post
+ * Description    : the sensor registry calls this when something happened to a sensor of the table,
+                    the message goes to loop() (see sensors_event())
+                    never waits for loop(): when sensors_messages is full the registry holds the
+                    event until loop() collects it, and the next ones of that sensor after it
+ * Return         : none
+ *******************************************************************************/
+void sensors_post(uint8_t index, SensorEvent event)
+{
+  if (sensors.held(index) or not sensors_messages.push(sensors.message(index, event)))
   {
+    sensors.hold(index, event);
+  }
+}
 
-    // if flood is already detected, no need to do anything, since an alarm will be fired
-    if (flood_detected)
-    {
-      return 0;
-    }
+/*******************************************************************************
+ * Function Name  : sensors_event
+ * Description    : something happened to a sensor of the table: a leak sensor raised an alarm
+                    or a DHT22 reading came in; runs in loop()
+ * Return         : none
+ *******************************************************************************/
+void sensors_event(const SensorMessage &message)
+{
+  const SensorDescriptor &sensor = sensors.sensor(message.index);
 
-    flood_detected = true;
+  if (message.event == SENSOR_ALARM)
+  {
+    flood_notify_user(sensor.name);
+  }
 
-    // reset alarm timer
-    flood_alarm_timer = 0;
+  if (message.event == SENSOR_WET or message.event == SENSOR_DRY)
+  {
+    status_dirty = true;
+  }
 
-    // set next alarm
-    flood_alarm_index = 0;
-    flood_next_alarm = flood_alarms_array[0];
+  if (message.event != SENSOR_READING)
+  {
+    state_dirty = true;
   }
-  else
+
+  if (message.event == SENSOR_READING and sensor.dht == &dht_reader)
   {
-    flood_detected = false;
+    uint32_t sectionStart = loopStats_ticks();
+    dryer_status(message);
+    loopStats[STATS_DRYER].record(loopStats_elapsed(sectionStart));
   }
-  return 0;
 }
 
 /*******************************************************************************
  * Function Name  : flood_notify_user
  * Description    : will fire notifications to user at scheduled intervals
- * Return         : 0
+                    the sensor registry calls this at every alarm of the schedule while a leak sensor is wet
+ * Return         : none
  *******************************************************************************/
-int flood_notify_user()
+void flood_notify_user(const char *sensorName)
 {
-
-  if (flood_alarm_timer < flood_next_alarm)
+  // send an alarm to user (this one goes to pushbullet servers)
+  if (flood_sensorCount > 1)
   {
-    return 0;
+    notifier.send(notify_floodSensor, sensorName);
   }
-
-  // time is up, so reset timer
-  flood_alarm_timer = 0;
-
-  // set next alarm or just keep current one if there are no more alarms to set
-  if (flood_alarm_index < arraySize(flood_alarms_array) - 1)
+  else
   {
-    flood_alarm_index = flood_alarm_index + 1;
-    flood_next_alarm = flood_alarms_array[flood_alarm_index];
+    notifier.send(notify_flood);
   }
-
-  // send an alarm to user (this one goes to pushbullet servers)
-  Particle.publish(PUSHBULLET_NOTIF_PERSONAL, "Flood detected!", 60, PRIVATE);
-
-  return 0;
 }
 
 /*******************************************************************************
@@ -732,12 +1878,14 @@ int flood_notify_user()
  *******************************************************************************/
 int setDryer(String status)
 {
+  TRACE_CALL("setDryer", status.c_str());
 
   // update the fan status only in the case the status is on or off
   if (status == "on")
   {
-    dryer_on = true;
-    dryer_stat = "dryer_on";
+    dryer_setStatus(DRYER_ON);
+    dryer_detector.setRunning(true, dryer_seconds());
+    scheduler.start(dryer_maxTimeTask, DRYER_MAX_TIMER);
     // Particle.publish(PUSHBULLET_NOTIF_PERSONAL, "Dryer on" + getTime(), 60, PRIVATE);
 
     return 0;
@@ -745,8 +1893,9 @@ int setDryer(String status)
 
   if (status == "off")
   {
-    dryer_on = false;
-    dryer_stat = "dryer_off";
+    dryer_setStatus(DRYER_OFF);
+    dryer_detector.setRunning(false, dryer_seconds());
+    scheduler.stop(dryer_maxTimeTask);
     // Particle.publish(PUSHBULLET_NOTIF_PERSONAL, "Dryer off" + getTime(), 60, PRIVATE);
 
     return 0;
@@ -757,61 +1906,49 @@ int setDryer(String status)
 
 /*******************************************************************************
  * Function Name  : dryer_status
- * Description    : reads the temperature of the DHT22 sensor at every DHT_SAMPLE_INTERVAL
- * Return         : 0
+ * Description    : takes the reading of the DHT22 sensor and runs the dryer detection on it
+ * Parameters     : const SensorMessage &message: the reading, DHT_READ_OK or DHT_READ_RETRY/DHT_READ_FAILED
+                     when the attempt failed (a failed reading is skipped, the next sample comes as usual)
+ * Return         : none
  *******************************************************************************/
-int dryer_status()
+void dryer_status(const SensorMessage &message)
 {
-
-  // time is up? no, then come back later
-  if (dhtSampleInterval < DHT_SAMPLE_INTERVAL)
-  {
-    return 0;
-  }
-
-  // time is up, reset timer
-  dhtSampleInterval = 0;
-
-  // start the sample
-  if (!bDHTstarted)
+  if (message.status == DHTLIB_OK)
   {
-    DHT.acquireAndWait(5);
-    bDHTstarted = true;
+    TRACE(dht(micros(), toHundredths(message.celsius), toHundredths(message.humidity)));
   }
-
-  // still acquiring sample? go away
-  if (DHT.acquiring())
+  else
   {
-    return 0;
+    TRACE(dhtError(micros(), message.status));
   }
 
-  // I observed my dht22 measuring below 0 from time to time, so let's discard that sample
-  if ((DHT.getCelsius() < 0) or (DHT.getHumidity() < 0))
+  if (message.reading != DHT_READ_OK)
   {
-    // reset the sample flag so we can take another
-    bDHTstarted = false;
-    return 0;
+    return;
   }
 
   // sample acquired - go ahead and store temperature and humidity in internal variables
-  publishTemperature((float)DHT.getCelsius(), (float)DHT.getHumidity());
+  publishTemperature(message.celsius, message.humidity);
 
-  // reset the sample flag so we can take another
-  bDHTstarted = false;
+  DryerEvent event = dryer_detector.update(dryer_seconds(), toHundredths(currentTemp), toHundredths(currentHumidity));
+  // the cycle goes on in retained memory, the EEPROM follows its start and end (dryer_setStatus())
+  if (dryer_on)
+  {
+    state_samplesDirty = true;
+  }
 
-  // if humidity goes above 50% then we believe the dryer has just started a cycle
-  if ((not dryer_on) and (currentHumidity > 50) and (currentTemp > 30))
+  // humidity and temperature climb together: the dryer has just started a cycle
+  if (event == DRYER_EVENT_STARTED)
   {
-    dryer_on = true;
-    humidity_samples_below_10 = 0;
+    dryer_setStatus(DRYER_ON);
     lowestHumidity = 100.0;
-    // Particle.publish(PUSHBULLET_NOTIF_HOME, "Starting drying cycle" + getTime(), 60, PRIVATE);
+    notifier.send(notify_dryerStarted);
     //  Particle.publish(AWS_EMAIL, "Starting drying cycle", 60, PRIVATE);
     // String tempStatus = "Starting drying cycle" + getTime();
     // Particle.publish("googleDocs", "{\"my-name\":\"" + tempStatus + "\"}", 60, PRIVATE);
 
     // this fires up the max time the dryer can be on
-    dryerMaxTimer = 0;
+    scheduler.start(dryer_maxTimeTask, DRYER_MAX_TIMER);
   }
 
   // update the lowest humidity readingso far if the dryer is on
@@ -820,45 +1957,107 @@ int dryer_status()
     lowestHumidity = currentHumidity;
   }
 
-  // if humidity goes below 10% and temperature goes over 50 degrees for a number of samples
-  //  we believe the clothes are dry
-  //  modify these parameters if you want to dry even more your clothes
-  //  example: to have clothes drier modify to "if ( dryer_on and ( currentHumidity < 8) and ( currentTemp > 50 ) ) {"
-  if (dryer_on and (currentHumidity < 10) and (currentTemp > 50))
+  // the clothes are dry: humidity below 10% while hot, or stuck at its lowest
+  //  modify the DRYER_* parameters of dryerDetector.h if you want to dry even more your clothes
+  // or the dryer stopped heating before that, and the clothes are still wet
+  if (event == DRYER_EVENT_DRY or event == DRYER_EVENT_STOPPED)
   {
-    humidity_samples_below_10 = humidity_samples_below_10 + 1;
-  }
-
-  // if there are 5 samples below 10% then we are sure the cycle is done
-  if (dryer_on and (humidity_samples_below_10 >= 5))
-  {
-    // Particle.publish(PUSHBULLET_NOTIF_HOME, "Your clothes are dry (lowest humidity: " + float2string(lowestHumidity) + ")" + getTime(), 60, PRIVATE);
+    notifier.send(event == DRYER_EVENT_DRY ? notify_dryerDry : notify_dryerStopped,
+                  NotificationArg(toHundredths(lowestHumidity), 2));
     // String tempStatus = "Your clothes are dry" + getTime();
     // Particle.publish("googleDocs", "{\"my-name\":\"" + tempStatus + "\"}", 60, PRIVATE);
     // Particle.publish(AWS_EMAIL, "Your clothes are dry", 60, PRIVATE);
-    dryer_on = false;
+    dryer_setStatus(DRYER_OFF);
+    scheduler.stop(dryer_maxTimeTask);
   }
 
-  // this indirect method will be used to raise an alarm if the clothes are still not fully dry
-  //  after this time has elapsed
-  if (dryer_on and (dryerMaxTimer > DRYER_MAX_TIMER))
+  dryer_updateEta();
+}
+
+/*******************************************************************************
+ * Function Name  : dryer_updateEta
+ * Description    : updates the predicted minutes to dry, publishes it when it's new or moved
+                    DRYER_ETA_PUBLISH_CHANGE minutes
+ * Return         : none
+ *******************************************************************************/
+void dryer_updateEta()
+{
+  int32_t seconds = dryer_on ? dryer_detector.secondsToDry() : -1;
+  int etaMinutes = seconds < 0 ? -1 : (seconds + 59) / 60;
+  if (etaMinutes != dryer_etaMinutes)
   {
-    // Particle.publish(PUSHBULLET_NOTIF_HOME, "ALARM: Your clothes are still not dry (lowest humidity: " + float2string(lowestHumidity) + ")" + getTime(), 60, PRIVATE);
-    // String tempStatus = "ALARM: Your clothes are still not dry (and your dryer is off!)" + getTime();
-    // Particle.publish("googleDocs", "{\"my-name\":\"" + tempStatus + "\"}", 60, PRIVATE);
-    dryer_on = false;
+    dryer_etaMinutes = etaMinutes;
+    status_dirty = true;
   }
 
-  if (dryer_on)
+  if (dryer_etaMinutes < 0)
   {
-    dryer_stat = "dryer_on";
+    dryer_etaPublished = -1;
+    return;
   }
-  else
+  if (dryer_etaPublished >= 0 and abs(dryer_etaMinutes - dryer_etaPublished) < DRYER_ETA_PUBLISH_CHANGE)
   {
-    dryer_stat = "dryer_off";
+    return;
   }
 
-  return 0;
+  char minutes[8];
+  fixedFormat(minutes, sizeof(minutes), dryer_etaMinutes, 0);
+  strcpy(dryer_etaMessage, "{\"min\":");
+  fixedAppend(dryer_etaMessage, sizeof(dryer_etaMessage), minutes);
+  fixedAppend(dryer_etaMessage, sizeof(dryer_etaMessage), "}");
+  if (publishQueue.add(DRYER_ETA_EVENT, dryer_etaMessage, PUBLISH_TELEMETRY))
+  {
+    dryer_etaPublished = dryer_etaMinutes;
+  }
+}
+
+/*******************************************************************************
+ * Function Name  : dryer_setStatus
+ * Description    : turns the dryer cycle on or off and updates the cloud variable dryer_stat
+ * Return         : none
+ *******************************************************************************/
+void dryer_setStatus(DryerStatus status)
+{
+  dryer_on = (status == DRYER_ON);
+  strncpy(dryer_stat, dryerStatusName(status), sizeof(dryer_stat) - 1);
+  status_dirty = true;
+  state_dirty = true;
+}
+
+/*******************************************************************************
+ * Function Name  : dryer_maxTimeReached
+ * Description    : runs DRYER_MAX_TIMER after a cycle started
+                    this indirect method will be used to raise an alarm if the clothes are still not fully dry
+                    after this time has elapsed
+ * Return         : none
+ *******************************************************************************/
+void dryer_maxTimeReached()
+{
+  if (not dryer_on)
+  {
+    return;
+  }
+
+  notifier.send(notify_dryerStillWet, NotificationArg(toHundredths(lowestHumidity), 2));
+  // String tempStatus = "ALARM: Your clothes are still not dry (and your dryer is off!)" + getTime();
+  // Particle.publish("googleDocs", "{\"my-name\":\"" + tempStatus + "\"}", 60, PRIVATE);
+  dryer_setStatus(DRYER_OFF);
+  dryer_detector.setRunning(false, dryer_seconds());
+  dryer_updateEta();
+}
+
+/*******************************************************************************
+ * Function Name  : dryer_seconds
+ * Description    : the time base of dryer_detector: seconds since the reset, monotonic
+                    (millis() wrapping around after 49 days included)
+ * Return         : the seconds
+ *******************************************************************************/
+uint32_t dryer_seconds()
+{
+  unsigned long seconds = (millis() - dryer_clockMillis) / 1000;
+  dryer_clockSeconds += seconds;
+  dryer_clockMillis += seconds * 1000;
+  return dryer_clockSeconds;
 }
 
 /*******************************************************************************
@@ -870,22 +2069,31 @@ int dryer_status()
 int publishTemperature(float temperature, float humidity)
 {
 
-  char currentTempChar[32];
+  // publish readings into exposed variables
   currentTemp = temperature;
-  int currentTempDecimals = (currentTemp - (int)currentTemp) * 100;
-  sprintf(currentTempChar, "%0d.%d", (int)currentTemp, currentTempDecimals);
-
-  char currentHumidityChar[32];
   currentHumidity = humidity;
-  int currentHumidityDecimals = (currentHumidity - (int)currentHumidity) * 100;
-  sprintf(currentHumidityChar, "%0d.%d", (int)currentHumidity, currentHumidityDecimals);
+  currentTempValid = true;
+  status_dirty = true;
 
-  // publish readings into exposed variables
-  currentTempString = String(currentTempChar);
-  currentHumidityString = String(currentHumidityChar);
+  // keep the sample for the next DownStairs_Series, not before the clock is set (FAST_BOOT): its
+  //  samples are stamped with the unix time
+  if (Time.isValid())
+  {
+    temperatureSeries.add(Time.now(), toHundredths(temperature), toHundredths(humidity));
+  }
 
   // publish readings
-  // Particle.publish(APP_NAME, dryer_stat + " " + currentTempString + "°C " + currentHumidityString + "% ", 60, PRIVATE);
+  // Particle.publish(APP_NAME, String(dryer_stat) + " " + currentTempString + "°C " + currentHumidityString + "% ", 60, PRIVATE);
 
   return 0;
+}
+
+/*******************************************************************************
+ * Function Name  : toHundredths
+ * Description    : a reading in hundredths, rounded, the way the series and the dryer detector keep them
+ * Return         : the reading times 100
+ *******************************************************************************/
+int16_t toHundredths(float value)
+{
+  return (int16_t)(value * 100 + (value < 0 ? -0.5f : 0.5f));
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Status of the garage door and the dryer.
+//  They are kept as enums and only turned into text through these constant tables,
+//   so updating them never touches the heap.
+
+#pragma once
+
+#include <stdint.h>
+
+enum GarageStatus : uint8_t
+{
+  GARAGE_UNKNOWN,
+  GARAGE_OPEN,
+  GARAGE_CLOSED,
+  GARAGE_OPENING,
+  GARAGE_CLOSING,
+  GARAGE_STATUS_COUNT,
+};
+
+constexpr const char *garageStatusNames[GARAGE_STATUS_COUNT] = {"unknown", "open", "closed", "opening", "closing"};
+
+constexpr const char *garageStatusName(GarageStatus status)
+{
+  return status < GARAGE_STATUS_COUNT ? garageStatusNames[status] : "unknown";
+}
+
+enum DryerStatus : uint8_t
+{
+  DRYER_OFF,
+  DRYER_ON,
+  DRYER_STATUS_COUNT,
+};
+
+// these are the values of the cloud variable dryer_stat
+constexpr const char *dryerStatusNames[DRYER_STATUS_COUNT] = {"dryer_off", "dryer_on"};
+
+constexpr const char *dryerStatusName(DryerStatus status)
+{
+  return status < DRYER_STATUS_COUNT ? dryerStatusNames[status] : "dryer_off";
+}
@@ -0,0 +1,188 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "jsonWriter.h"
+
+#include "fixedFormat.h"
+
+// room kept for closing an array and the object: "]}"
+#define JSON_WRITER_RESERVE 2
+
+JsonWriter::JsonWriter(char *buffer, size_t size)
+    : buffer(buffer), size(size), used(0), inArray(false), arrayOpen(false), closed(false), overflow(false)
+{
+  if (size < JSON_WRITER_RESERVE + 2)
+  {
+    overflow = true;
+    closed = true;
+    if (size > 0)
+    {
+      buffer[0] = 0;
+    }
+    return;
+  }
+  buffer[used++] = '{';
+  buffer[used] = 0;
+}
+
+bool JsonWriter::put(const char *text)
+{
+  while (*text)
+  {
+    if (used + 1 + JSON_WRITER_RESERVE >= size)
+    {
+      return false;
+    }
+    buffer[used++] = *text++;
+  }
+  return true;
+}
+
+bool JsonWriter::putQuoted(const char *text)
+{
+  char escaped[3] = "\\";
+  if (not put("\""))
+  {
+    return false;
+  }
+  for (; *text; text++)
+  {
+    char c = *text;
+    if (c == '"' or c == '\\')
+    {
+      escaped[1] = c;
+      if (not put(escaped))
+      {
+        return false;
+      }
+      continue;
+    }
+    // control characters would need \u escapes, none of the names and states have them
+    char plain[2] = {(unsigned char)c < 0x20 ? ' ' : c, 0};
+    if (not put(plain))
+    {
+      return false;
+    }
+  }
+  return put("\"");
+}
+
+// the comma, unless this is the first field of the object or the first item of the array
+bool JsonWriter::key(const char *name)
+{
+  char last = buffer[used - 1];
+  if (last != '{' and last != '[' and not put(","))
+  {
+    return false;
+  }
+  return name == nullptr or (putQuoted(name) and put(":"));
+}
+
+// fields go in an open object, not in an array
+bool JsonWriter::accepting()
+{
+  if (closed or inArray)
+  {
+    overflow = true;
+    return false;
+  }
+  return true;
+}
+
+// a field that did not fit is taken out whole
+void JsonWriter::commit(size_t start, bool fits)
+{
+  if (not fits)
+  {
+    used = start;
+    overflow = true;
+  }
+  buffer[used] = 0;
+}
+
+void JsonWriter::string(const char *name, const char *value)
+{
+  if (not accepting())
+  {
+    return;
+  }
+  size_t start = used;
+  commit(start, key(name) and putQuoted(value));
+}
+
+void JsonWriter::number(const char *name, int32_t value, uint8_t decimals)
+{
+  if (not accepting())
+  {
+    return;
+  }
+  char digits[16];
+  fixedFormat(digits, sizeof(digits), value, decimals);
+  size_t start = used;
+  commit(start, key(name) and put(digits));
+}
+
+void JsonWriter::null(const char *name)
+{
+  if (not accepting())
+  {
+    return;
+  }
+  size_t start = used;
+  commit(start, key(name) and put("null"));
+}
+
+void JsonWriter::beginArray(const char *name)
+{
+  if (not accepting())
+  {
+    return;
+  }
+  inArray = true;
+  size_t start = used;
+  arrayOpen = key(name) and put("[");
+  commit(start, arrayOpen);
+}
+
+void JsonWriter::item(const char *value)
+{
+  if (not arrayOpen)
+  {
+    overflow = true;
+    return;
+  }
+  size_t start = used;
+  commit(start, key(nullptr) and putQuoted(value));
+}
+
+void JsonWriter::endArray()
+{
+  // "]" always fits, it is part of the reserve
+  if (arrayOpen)
+  {
+    buffer[used++] = ']';
+    buffer[used] = 0;
+  }
+  inArray = false;
+  arrayOpen = false;
+}
+
+/*******************************************************************************
+ * Function Name  : finish
+ * Description    : closes an array left open and the object, nothing can be added after this
+ * Return         : the document, an empty string if the buffer could not even hold "{}"
+ *******************************************************************************/
+const char *JsonWriter::finish()
+{
+  if (closed)
+  {
+    return buffer;
+  }
+  endArray();
+  buffer[used++] = '}';
+  buffer[used] = 0;
+  closed = true;
+  return buffer;
+}
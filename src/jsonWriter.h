@@ -0,0 +1,52 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Writes a flat json object into the caller's buffer, one field at a time.
+//  Numbers go through fixedFormat(), so it is integer only and allocation free.
+//  A field (or array item) that does not fit is left out whole: the document stays valid json,
+//   overflowed() tells that something is missing.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class JsonWriter
+{
+public:
+  // starts the object, size includes the terminating 0 (at least 4: "{}" plus room for "]")
+  JsonWriter(char *buffer, size_t size);
+
+  void string(const char *name, const char *value);
+  // value / 10^decimals, like fixedFormat()
+  void number(const char *name, int32_t value, uint8_t decimals = 0);
+  void null(const char *name);
+
+  // an array of strings, items go between beginArray() and endArray()
+  void beginArray(const char *name);
+  void item(const char *value);
+  void endArray();
+
+  // closes the object
+  const char *finish();
+
+  size_t length() const { return used; }
+  bool overflowed() const { return overflow; }
+
+private:
+  bool put(const char *text);
+  bool putQuoted(const char *text);
+  bool key(const char *name);
+  bool accepting();
+  void commit(size_t start, bool fits);
+
+  char *buffer;
+  size_t size;
+  size_t used;
+  bool inArray;
+  bool arrayOpen;
+  bool closed;
+  bool overflow;
+};
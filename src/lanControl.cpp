@@ -0,0 +1,320 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "lanControl.h"
+
+#include "fixedFormat.h"
+
+namespace
+{
+
+const char hexDigits[] = "0123456789abcdef";
+
+int hexValue(char c)
+{
+  if (c >= '0' and c <= '9')
+  {
+    return c - '0';
+  }
+  if (c >= 'a' and c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' and c <= 'F')
+  {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+void toHex(uint64_t value, char *text)
+{
+  for (int8_t i = 15; i >= 0; i--)
+  {
+    text[i] = hexDigits[value & 0xf];
+    value >>= 4;
+  }
+  text[16] = 0;
+}
+
+} // namespace
+
+LanControl::LanControl(uint16_t port, const LanCommand *commands, uint8_t count)
+    : server(port), commands(commands), commandCount(count), key(), keyLoaded(false), started(false),
+      lastListen(0), slots(), served(0), refusedRequests(0)
+{
+}
+
+/*******************************************************************************
+ * Function Name  : begin
+ * Description    : takes the shared key, process() starts listening when the wifi is up
+ * Return         : false if the key is not 32 hex digits or is all zeros (the placeholder)
+ *******************************************************************************/
+bool LanControl::begin(const char *keyHex)
+{
+  uint8_t any = 0;
+  for (uint8_t i = 0; i < SIP_HASH_KEY_SIZE; i++)
+  {
+    int high = hexValue(keyHex[2 * i]);
+    int low = high < 0 ? -1 : hexValue(keyHex[2 * i + 1]);
+    if (low < 0)
+    {
+      return false;
+    }
+    key[i] = high << 4 | low;
+    any |= key[i];
+  }
+  if (keyHex[2 * SIP_HASH_KEY_SIZE] != 0 or any == 0)
+  {
+    return false;
+  }
+
+  keyLoaded = true;
+  // the first try is right away
+  lastListen = millis() - LAN_CONTROL_LISTEN_RETRY;
+  return true;
+}
+
+/*******************************************************************************
+ * Function Name  : process
+ * Description    : takes new clients, answers one request of each client that sent one
+                    and closes the clients that went silent, call this from loop()
+ *******************************************************************************/
+void LanControl::process()
+{
+  if (not started)
+  {
+    if (not keyLoaded or not WiFi.ready() or millis() - lastListen < LAN_CONTROL_LISTEN_RETRY)
+    {
+      return;
+    }
+    lastListen = millis();
+    started = server.begin();
+    if (not started)
+    {
+      return;
+    }
+  }
+
+  accept();
+
+  unsigned long now = millis();
+  for (Client &client : slots)
+  {
+    if (not client.active)
+    {
+      continue;
+    }
+    if (not client.socket.connected() or now - client.lastActivity >= LAN_CONTROL_IDLE_TIMEOUT)
+    {
+      close(client);
+      continue;
+    }
+    if (receive(client))
+    {
+      client.lastActivity = now;
+      handle(client);
+    }
+  }
+}
+
+unsigned long LanControl::nextPollMillis() const
+{
+  return clients() > 0 ? 0 : LAN_CONTROL_ACCEPT_POLL;
+}
+
+uint8_t LanControl::clients() const
+{
+  uint8_t count = 0;
+  for (const Client &client : slots)
+  {
+    count += client.active ? 1 : 0;
+  }
+  return count;
+}
+
+void LanControl::accept()
+{
+  TCPClient incoming = server.available();
+  if (not incoming.connected())
+  {
+    return;
+  }
+
+  for (Client &client : slots)
+  {
+    if (client.active)
+    {
+      continue;
+    }
+    client.socket = incoming;
+    client.length = 0;
+    client.overlong = false;
+    client.active = true;
+    client.seqSeen = false;
+    client.lastSeq = 0;
+    client.lastActivity = millis();
+    toHex((uint64_t)HAL_RNG_GetRandomNumber() << 32 | HAL_RNG_GetRandomNumber(), client.nonce);
+
+    char hello[24] = "hello ";
+    fixedAppend(hello, sizeof(hello), client.nonce);
+    fixedAppend(hello, sizeof(hello), "\n");
+    client.socket.write((const uint8_t *)hello, strlen(hello));
+    return;
+  }
+
+  const char busy[] = "ERR busy\n";
+  incoming.write((const uint8_t *)busy, sizeof(busy) - 1);
+  incoming.stop();
+  refusedRequests++;
+}
+
+// reads what arrived up to the end of a line, true once a whole line is in
+bool LanControl::receive(Client &client)
+{
+  while (client.socket.available() > 0)
+  {
+    int c = client.socket.read();
+    if (c < 0)
+    {
+      return false;
+    }
+    if (c == '\n')
+    {
+      client.line[client.length] = 0;
+      return true;
+    }
+    if (client.length < LAN_CONTROL_LINE_MAX)
+    {
+      client.line[client.length++] = c;
+    }
+    else
+    {
+      client.overlong = true;
+    }
+  }
+  return false;
+}
+
+void LanControl::handle(Client &client)
+{
+  char *line = client.line;
+  bool overlong = client.overlong;
+  uint8_t length = client.length;
+  client.length = 0;
+  client.overlong = false;
+
+  if (length > 0 and line[length - 1] == '\r')
+  {
+    line[--length] = 0;
+  }
+
+  // "<seq> <command> [argument] <mac>": the mac is the last word
+  char *mac = strrchr(line, ' ');
+  if (overlong or mac == nullptr or strlen(mac + 1) != 16)
+  {
+    const char error[] = "ERR line\n";
+    client.socket.write((const uint8_t *)error, sizeof(error) - 1);
+    refusedRequests++;
+    return;
+  }
+  *mac++ = 0;
+
+  if (not authentic(client, line, mac))
+  {
+    const char error[] = "ERR auth\n";
+    client.socket.write((const uint8_t *)error, sizeof(error) - 1);
+    refusedRequests++;
+    close(client);
+    return;
+  }
+
+  char *rest;
+  uint32_t seq = strtoul(line, &rest, 10);
+  if (rest == line or *rest != ' ' or (client.seqSeen and (int32_t)(seq - client.lastSeq) <= 0))
+  {
+    reply(client, seq, "ERR seq");
+    refusedRequests++;
+    return;
+  }
+  client.seqSeen = true;
+  client.lastSeq = seq;
+
+  char *name = rest + 1;
+  char *argument = strchr(name, ' ');
+  if (argument != nullptr)
+  {
+    *argument++ = 0;
+  }
+  const LanCommand *command = find(name);
+  if (command == nullptr)
+  {
+    reply(client, seq, "ERR unknown");
+    refusedRequests++;
+    return;
+  }
+
+  served++;
+  if (command->function)
+  {
+    char result[12];
+    fixedFormat(result, sizeof(result), command->function(String(argument ? argument : "")), 0);
+    reply(client, seq, result);
+  }
+  else
+  {
+    reply(client, seq, command->query().c_str());
+  }
+}
+
+// compares every digit, so the time taken does not tell how many were right
+bool LanControl::authentic(const Client &client, const char *request, const char *mac) const
+{
+  char message[sizeof(client.nonce) + LAN_CONTROL_LINE_MAX + 1];
+  strcpy(message, client.nonce);
+  fixedAppend(message, sizeof(message), " ");
+  fixedAppend(message, sizeof(message), request);
+
+  char expected[17];
+  toHex(sipHash24(key, message, strlen(message)), expected);
+
+  uint8_t difference = 0;
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    int value = hexValue(mac[i]);
+    difference |= value < 0 ? 1 : (uint8_t)(value ^ hexValue(expected[i]));
+  }
+  return difference == 0;
+}
+
+const LanCommand *LanControl::find(const char *name) const
+{
+  for (uint8_t i = 0; i < commandCount; i++)
+  {
+    if (strcmp(commands[i].name, name) == 0)
+    {
+      return &commands[i];
+    }
+  }
+  return nullptr;
+}
+
+void LanControl::reply(Client &client, uint32_t seq, const char *text)
+{
+  // one write, so the answer goes out in one segment
+  char answer[12 + LAN_CONTROL_REPLY_MAX + 2];
+  size_t length = fixedFormat(answer, 12, (int32_t)seq, 0);
+  answer[length++] = ' ';
+  answer[length] = 0;
+  length = fixedAppend(answer, sizeof(answer) - 1, text);
+  answer[length++] = '\n';
+  client.socket.write((const uint8_t *)answer, length);
+}
+
+void LanControl::close(Client &client)
+{
+  client.socket.stop();
+  client.active = false;
+}
@@ -0,0 +1,92 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Control of the house from the local network, without the cloud round trip: a TCP server with a
+//   line protocol, for up to LAN_CONTROL_CLIENTS clients at a time (the next one gets "ERR busy").
+//  Commands run the same handlers as the cloud functions and variables, from loop(), one request
+//   per client per pass.
+//
+//  On connect the server sends "hello <nonce>\n", 16 hex digits that are new for every connection.
+//  A request is one line: "<seq> <command> [argument] <mac>\n"
+//   seq  goes up on every request of the connection, a line sent again is refused ("<seq> ERR seq")
+//   mac  SipHash-2-4 of "<nonce> <seq> <command> [argument]" with the shared key, 16 hex digits
+//  The answer is "<seq> <value>\n": what the function returned, or the text of the variable.
+//  "<seq> ERR unknown" is a command that is not in the table, "ERR line" a line too long or without
+//   a mac. A wrong mac gets "ERR auth" and the connection is closed, so is a client silent for
+//   LAN_CONTROL_IDLE_TIMEOUT.
+
+#pragma once
+
+#include "Particle.h"
+#include "sipHash.h"
+
+#define LAN_CONTROL_CLIENTS 4
+#define LAN_CONTROL_LINE_MAX 128
+// longer answers are cut, a cloud variable holds up to 622 characters
+#define LAN_CONTROL_REPLY_MAX 622
+#define LAN_CONTROL_IDLE_TIMEOUT 60000
+// how long loop() can go without looking for new clients
+#define LAN_CONTROL_ACCEPT_POLL 20
+// how often to try to listen again while the wifi is down or the port is taken
+#define LAN_CONTROL_LISTEN_RETRY 1000
+
+struct LanCommand
+{
+  const char *name;
+  // one of them: a function like Particle.function() takes, or a variable like Particle.variable()
+  int (*function)(String argument);
+  String (*query)();
+};
+
+class LanControl
+{
+public:
+  LanControl(uint16_t port, const LanCommand *commands, uint8_t count);
+
+  // key: 32 hex digits, false (and no server) if it is not, or if it is all zeros
+  //  the server starts listening in process() once the wifi is up
+  bool begin(const char *key);
+  void process();
+  bool listening() const { return started; }
+  // 0 while clients are connected, LAN_CONTROL_ACCEPT_POLL otherwise
+  unsigned long nextPollMillis() const;
+
+  uint8_t clients() const;
+  unsigned long requests() const { return served; }
+  unsigned long refused() const { return refusedRequests; }
+
+private:
+  struct Client
+  {
+    TCPClient socket;
+    char line[LAN_CONTROL_LINE_MAX + 1];
+    uint8_t length;
+    bool overlong;
+    bool active;
+    bool seqSeen;
+    uint32_t lastSeq;
+    unsigned long lastActivity;
+    char nonce[17];
+  };
+
+  void accept();
+  bool receive(Client &client);
+  void handle(Client &client);
+  bool authentic(const Client &client, const char *request, const char *mac) const;
+  const LanCommand *find(const char *name) const;
+  void reply(Client &client, uint32_t seq, const char *text);
+  void close(Client &client);
+
+  TCPServer server;
+  const LanCommand *commands;
+  uint8_t commandCount;
+  uint8_t key[SIP_HASH_KEY_SIZE];
+  bool keyLoaded;
+  bool started;
+  unsigned long lastListen;
+  Client slots[LAN_CONTROL_CLIENTS];
+  unsigned long served;
+  unsigned long refusedRequests;
+};
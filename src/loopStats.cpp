@@ -0,0 +1,121 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "loopStats.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+  reset();
+}
+
+/*******************************************************************************
+ * Function Name  : record
+ * Description    : adds one duration (in cycles) to the histogram
+                    bucket 0 holds 0 and 1, bucket i holds [2^i, 2^(i+1))
+ *******************************************************************************/
+void LatencyHistogram::record(uint32_t ticks)
+{
+  uint8_t bucket = ticks > 1 ? 31 - __builtin_clz(ticks) : 0;
+  buckets[bucket]++;
+
+  if (samples == 0 or ticks < minTicks)
+  {
+    minTicks = ticks;
+  }
+  if (ticks > maxTicks)
+  {
+    maxTicks = ticks;
+  }
+
+  // saturate instead of wrapping, the histogram keeps its shape
+  if (samples < UINT32_MAX)
+  {
+    samples++;
+  }
+}
+
+void LatencyHistogram::reset()
+{
+  samples = 0;
+  minTicks = 0;
+  maxTicks = 0;
+  memset(buckets, 0, sizeof(buckets));
+}
+
+/*******************************************************************************
+ * Function Name  : percentile
+ * Description    : upper bound of the bucket holding the given percentile,
+                    clamped to the min/max actually seen
+ *******************************************************************************/
+uint32_t LatencyHistogram::percentile(uint8_t percent) const
+{
+  if (samples == 0)
+  {
+    return 0;
+  }
+
+  uint64_t target = ((uint64_t)samples * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (uint8_t i = 0; i < LOOP_STATS_BUCKETS; i++)
+  {
+    seen += buckets[i];
+    if (seen >= target)
+    {
+      uint32_t upper = i >= 31 ? UINT32_MAX : (2u << i) - 1;
+      if (upper > maxTicks)
+      {
+        upper = maxTicks;
+      }
+      if (upper < minTicks)
+      {
+        upper = minTicks;
+      }
+      return upper;
+    }
+  }
+  return maxTicks;
+}
+
+// cycles to tenths of microseconds, printed as "12.3"
+static void ticksToMicros(uint32_t ticks, uint32_t ticksPerMicro, unsigned long &whole, unsigned long &tenths)
+{
+  uint64_t deci = (uint64_t)ticks * 10 / ticksPerMicro;
+  whole = deci / 10;
+  tenths = deci % 10;
+}
+
+int loopStats_format(char *buffer, size_t size, const LatencyHistogram *histograms, const char *const *names, size_t count)
+{
+  if (size == 0)
+  {
+    return 0;
+  }
+  buffer[0] = 0;
+
+  uint32_t ticksPerMicro = System.ticksPerMicrosecond();
+  size_t used = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    const LatencyHistogram &h = histograms[i];
+    unsigned long value[4][2];
+    ticksToMicros(h.min(), ticksPerMicro, value[0][0], value[0][1]);
+    ticksToMicros(h.percentile(50), ticksPerMicro, value[1][0], value[1][1]);
+    ticksToMicros(h.percentile(99), ticksPerMicro, value[2][0], value[2][1]);
+    ticksToMicros(h.max(), ticksPerMicro, value[3][0], value[3][1]);
+
+    int written = snprintf(buffer + used, size - used, "%s:n=%lu,min=%lu.%lu,p50=%lu.%lu,p99=%lu.%lu,max=%lu.%lu;",
+                           names[i], (unsigned long)h.count(),
+                           value[0][0], value[0][1], value[1][0], value[1][1],
+                           value[2][0], value[2][1], value[3][0], value[3][1]);
+    if (written < 0 or (size_t)written >= size - used)
+    {
+      // out of room: drop the partial entry
+      buffer[used] = 0;
+      break;
+    }
+    used += written;
+  }
+  return used;
+}
@@ -0,0 +1,61 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Lightweight latency histograms for the sections of loop().
+//  Durations are measured with the cycle counter (System.ticks()) and kept in
+//   power-of-two buckets, so recording is a handful of instructions and the memory is fixed.
+//  Percentiles are reported as the upper bound of the bucket they fall in (at most 2x off).
+
+#pragma once
+
+#include "Particle.h"
+
+#define LOOP_STATS_BUCKETS 32
+
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  void record(uint32_t ticks);
+  void reset();
+
+  uint32_t count() const { return samples; }
+  uint32_t min() const { return samples ? minTicks : 0; }
+  uint32_t max() const { return maxTicks; }
+  uint32_t percentile(uint8_t percent) const;
+
+private:
+  uint32_t samples;
+  uint32_t minTicks;
+  uint32_t maxTicks;
+  uint32_t buckets[LOOP_STATS_BUCKETS];
+};
+
+/*******************************************************************************
+ * Function Name  : loopStats_ticks
+ * Description    : current value of the cycle counter, pass it later to loopStats_elapsed()
+ *******************************************************************************/
+inline uint32_t loopStats_ticks()
+{
+  return System.ticks();
+}
+
+/*******************************************************************************
+ * Function Name  : loopStats_elapsed
+ * Description    : cycles elapsed since start (wraps fine since it's unsigned)
+ *******************************************************************************/
+inline uint32_t loopStats_elapsed(uint32_t start)
+{
+  return System.ticks() - start;
+}
+
+/*******************************************************************************
+ * Function Name  : loopStats_format
+ * Description    : writes "name:n=..,min=..,p50=..,p99=..,max=..;" for every histogram,
+                    values in microseconds with one decimal
+ * Return         : number of characters written (output is truncated to fit size)
+ *******************************************************************************/
+int loopStats_format(char *buffer, size_t size, const LatencyHistogram *histograms, const char *const *names, size_t count);
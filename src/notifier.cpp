@@ -0,0 +1,89 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "notifier.h"
+
+#include "fixedFormat.h"
+
+Notifier::Notifier(PublishQueue &queue) : queue(queue), message(), length(0), clockText("00:00:00"), clockSecond(-1)
+{
+}
+
+/*******************************************************************************
+ * Function Name  : send
+ * Description    : fills the template with the arguments, in order, adds the time if the template
+                    wants it and the clock is set, and queues the notification; a "{}" without
+                    argument is left empty
+ * Return         : false if the publish queue refused it
+ *******************************************************************************/
+bool Notifier::send(const Notification &notification, NotificationArg first, NotificationArg second)
+{
+  const NotificationArg *arguments[] = {&first, &second};
+  uint8_t next = 0;
+
+  message[0] = 0;
+  length = 0;
+  for (const char *text = notification.text; *text; text++)
+  {
+    if (text[0] == '{' and text[1] == '}')
+    {
+      if (next < arraySize(arguments))
+      {
+        append(*arguments[next++]);
+      }
+      text++;
+    }
+    else if (length < NOTIFIER_MESSAGE_MAX)
+    {
+      message[length++] = *text;
+      message[length] = 0;
+    }
+  }
+
+  // no time before the clock is set (FAST_BOOT), it would be the time of day of 1970
+  bool timestamp = notification.timestamp and Time.isValid();
+  if (timestamp)
+  {
+    append(" at ");
+    append(clock());
+  }
+  // a notification with the time in it does not need the queue to say when it happened
+  return queue.add(notification.eventName, message, notification.priority, not timestamp);
+}
+
+/*******************************************************************************
+ * Function Name  : clock
+ * Description    : the local time of day for the notifications
+ * Return         : "hh:mm:ss", the same buffer until the second changes
+ *******************************************************************************/
+const char *Notifier::clock()
+{
+  time_t now = Time.now();
+  if (now == clockSecond)
+  {
+    return clockText;
+  }
+  clockSecond = now;
+  fixedClock(clockText, Time.local());
+  return clockText;
+}
+
+void Notifier::append(const char *text)
+{
+  length = fixedAppend(message, sizeof(message), text);
+}
+
+void Notifier::append(const NotificationArg &argument)
+{
+  if (argument.number)
+  {
+    fixedFormat(message + length, sizeof(message) - length, argument.value, argument.decimals);
+    length += strlen(message + length);
+  }
+  else if (argument.text)
+  {
+    append(argument.text);
+  }
+}
@@ -0,0 +1,61 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Notifications to people (pushbullet and the like) built from constant templates.
+//  A template is the event, the text with "{}" where the arguments go and whether the time of day goes
+//   at the end (" at 14:05:09"). The message is written into a buffer of the notifier and queued in
+//   the publish queue: no String, no heap, and the time is formatted at most once per second.
+
+#pragma once
+
+#include "Particle.h"
+#include "fixedFormat.h"
+#include "publishQueue.h"
+
+#define NOTIFIER_MESSAGE_MAX 128
+
+struct Notification
+{
+  const char *eventName;
+  const char *text;
+  PublishPriority priority;
+  bool timestamp;
+};
+
+// an argument of a notification: text, or a number with a fixed number of decimals (see fixedFormat())
+struct NotificationArg
+{
+  NotificationArg() : text(nullptr), value(0), decimals(0), number(false) {}
+  NotificationArg(const char *text) : text(text), value(0), decimals(0), number(false) {}
+  NotificationArg(int32_t value, uint8_t decimals = 0) : text(nullptr), value(value), decimals(decimals), number(true) {}
+
+  const char *text;
+  int32_t value;
+  uint8_t decimals;
+  bool number;
+};
+
+class Notifier
+{
+public:
+  explicit Notifier(PublishQueue &queue);
+
+  // false if the publish queue refused it
+  bool send(const Notification &notification, NotificationArg first = NotificationArg(),
+            NotificationArg second = NotificationArg());
+
+  // "hh:mm:ss" local time, formatted again only when the second changed
+  const char *clock();
+
+private:
+  void append(const char *text);
+  void append(const NotificationArg &argument);
+
+  PublishQueue &queue;
+  char message[NOTIFIER_MESSAGE_MAX + 1];
+  size_t length;
+  char clockText[FIXED_CLOCK_SIZE];
+  time_t clockSecond;
+};
@@ -0,0 +1,298 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "publishQueue.h"
+
+#include "fixedFormat.h"
+
+#define PUBLISH_STORE_MAGIC 0x50554251UL
+#define PUBLISH_NO_RECORD 0xffff
+
+PublishQueue::PublishQueue(PublishStore &store)
+    : store(store), stamped(), availableTokens(PUBLISH_BURST), lastRefill(0), droppedEvents(0), published(nullptr)
+{
+}
+
+/*******************************************************************************
+ * Function Name  : begin
+ * Description    : keeps the events that survived a reset, clears the store if it's not valid
+ *******************************************************************************/
+void PublishQueue::begin()
+{
+  if (not valid())
+  {
+    store.magic = PUBLISH_STORE_MAGIC;
+    store.nextSequence = 0;
+    store.used = 0;
+  }
+}
+
+/*******************************************************************************
+ * Function Name  : add
+ * Description    : queues an event to be published by process()
+                    when the store is full the oldest events of the lowest priority are dropped,
+                    as long as they're of lower priority than the new one (or both are telemetry)
+                    and dropping them makes enough room, otherwise the store is left as it was
+                    dropped() counts the events dropped from the store and the ones refused
+ * Return         : false if the event was dropped
+ *******************************************************************************/
+bool PublishQueue::add(const char *eventName, const char *eventData, PublishPriority priority, bool stampIfLate)
+{
+  size_t nameLength = strnlen(eventName, PUBLISH_NAME_MAX);
+  size_t dataLength = strnlen(eventData, PUBLISH_DATA_MAX);
+  uint16_t needed = sizeof(PublishRecord) + nameLength + 1 + dataLength + 1;
+
+  // newer telemetry supersedes the one waiting in the store, and takes its place in the order
+  uint16_t superseded = PUBLISH_NO_RECORD;
+  uint16_t room = PUBLISH_STORE_SIZE - store.used;
+  if (priority == PUBLISH_TELEMETRY)
+  {
+    for (uint16_t offset = 0; offset < store.used; offset += record(offset).length)
+    {
+      PublishRecord entry = record(offset);
+      if (entry.priority == PUBLISH_TELEMETRY and strlen(name(offset)) == nameLength and
+          strncmp(name(offset), eventName, nameLength) == 0)
+      {
+        superseded = offset;
+        room += entry.length;
+        break;
+      }
+    }
+  }
+
+  // nothing leaves the store unless the new event is going in
+  uint16_t evictable = 0;
+  if (room < needed)
+  {
+    findVictim(priority, evictable);
+    if (PUBLISH_STORE_SIZE - store.used + evictable < needed)
+    {
+      droppedEvents++;
+      return false;
+    }
+  }
+
+  uint32_t sequence = store.nextSequence++;
+  if (superseded != PUBLISH_NO_RECORD)
+  {
+    sequence = record(superseded).sequence;
+    remove(superseded);
+  }
+
+  while (PUBLISH_STORE_SIZE - store.used < needed)
+  {
+    remove(findVictim(priority, evictable));
+    droppedEvents++;
+  }
+
+  append(eventName, eventData, priority, stampIfLate, sequence);
+  return true;
+}
+
+/*******************************************************************************
+ * Function Name  : process
+ * Description    : publishes the most important queued event if the rate limit allows it
+                    call this from loop()
+ *******************************************************************************/
+void PublishQueue::process()
+{
+  refill();
+
+  if (availableTokens == 0)
+  {
+    return;
+  }
+
+  uint16_t next = PUBLISH_NO_RECORD;
+  PublishRecord nextRecord = {};
+  for (uint16_t offset = 0; offset < store.used;)
+  {
+    PublishRecord entry = record(offset);
+    if (next == PUBLISH_NO_RECORD or entry.priority < nextRecord.priority or
+        (entry.priority == nextRecord.priority and (int32_t)(entry.sequence - nextRecord.sequence) < 0))
+    {
+      next = offset;
+      nextRecord = entry;
+    }
+    offset += entry.length;
+  }
+
+  if (next == PUBLISH_NO_RECORD or not Particle.connected())
+  {
+    return;
+  }
+
+  // the attempt counts against the rate limit even if it fails, in which case we retry later
+  availableTokens--;
+  const char *eventData = stamp(nextRecord, data(next));
+  if (Particle.publish(name(next), eventData, 60, PRIVATE))
+  {
+    if (published)
+    {
+      published(name(next), eventData);
+    }
+    remove(next);
+  }
+}
+
+/*******************************************************************************
+ * Function Name  : pending
+ * Description    : number of events waiting to be published
+ *******************************************************************************/
+uint16_t PublishQueue::pending() const
+{
+  uint16_t count = 0;
+  for (uint16_t offset = 0; offset < store.used; offset += record(offset).length)
+  {
+    count++;
+  }
+  return count;
+}
+
+// one token every PUBLISH_REFILL_MILLIS, up to PUBLISH_BURST
+void PublishQueue::refill()
+{
+  unsigned long now = millis();
+
+  if (availableTokens >= PUBLISH_BURST)
+  {
+    lastRefill = now;
+    return;
+  }
+
+  unsigned long newTokens = (now - lastRefill) / PUBLISH_REFILL_MILLIS;
+  if (newTokens == 0)
+  {
+    return;
+  }
+
+  lastRefill += newTokens * PUBLISH_REFILL_MILLIS;
+  availableTokens = newTokens >= (unsigned long)(PUBLISH_BURST - availableTokens) ? PUBLISH_BURST : availableTokens + newTokens;
+}
+
+PublishQueue::PublishRecord PublishQueue::record(uint16_t offset) const
+{
+  PublishRecord entry;
+  memcpy(&entry, store.bytes + offset, sizeof(entry));
+  return entry;
+}
+
+const char *PublishQueue::name(uint16_t offset) const
+{
+  return (const char *)store.bytes + offset + sizeof(PublishRecord);
+}
+
+const char *PublishQueue::data(uint16_t offset) const
+{
+  const char *eventName = name(offset);
+  return eventName + strlen(eventName) + 1;
+}
+
+// every record fits in the store, the last one ends where the store does, names and data are terminated
+bool PublishQueue::valid() const
+{
+  if (store.magic != PUBLISH_STORE_MAGIC or store.used > PUBLISH_STORE_SIZE)
+  {
+    return false;
+  }
+  uint16_t offset = 0;
+  while (offset < store.used)
+  {
+    if ((size_t)(store.used - offset) < sizeof(PublishRecord) + 2)
+    {
+      return false;
+    }
+    PublishRecord entry = record(offset);
+    uint16_t textLength = entry.length - sizeof(PublishRecord);
+    if (entry.length < sizeof(PublishRecord) + 2 or entry.length > store.used - offset or
+        entry.priority > PUBLISH_TELEMETRY or
+        memchr(name(offset), 0, textLength - 1) == nullptr or store.bytes[offset + entry.length - 1] != 0)
+    {
+      return false;
+    }
+    offset += entry.length;
+  }
+  return true;
+}
+
+// the oldest of the lowest priority that can make room for an event of this priority,
+//  and how many bytes all of those together take
+uint16_t PublishQueue::findVictim(PublishPriority priority, uint16_t &evictable) const
+{
+  uint16_t victim = PUBLISH_NO_RECORD;
+  PublishRecord victimRecord = {};
+  evictable = 0;
+  for (uint16_t offset = 0; offset < store.used;)
+  {
+    PublishRecord entry = record(offset);
+    if (entry.priority > priority or (entry.priority == PUBLISH_TELEMETRY and priority == PUBLISH_TELEMETRY))
+    {
+      evictable += entry.length;
+      if (victim == PUBLISH_NO_RECORD or entry.priority > victimRecord.priority or
+          (entry.priority == victimRecord.priority and (int32_t)(entry.sequence - victimRecord.sequence) < 0))
+      {
+        victim = offset;
+        victimRecord = entry;
+      }
+    }
+    offset += entry.length;
+  }
+  return victim;
+}
+
+void PublishQueue::append(const char *eventName, const char *eventData, PublishPriority priority, bool stampIfLate,
+                          uint32_t sequence)
+{
+  size_t nameLength = strnlen(eventName, PUBLISH_NAME_MAX);
+  size_t dataLength = strnlen(eventData, PUBLISH_DATA_MAX);
+
+  PublishRecord entry;
+  entry.length = sizeof(PublishRecord) + nameLength + 1 + dataLength + 1;
+  entry.priority = priority;
+  entry.stampIfLate = stampIfLate;
+  entry.sequence = sequence;
+  entry.time = Time.isValid() ? (uint32_t)Time.now() : 0;
+
+  uint8_t *at = store.bytes + store.used;
+  memcpy(at, &entry, sizeof(entry));
+  at += sizeof(entry);
+  memcpy(at, eventName, nameLength);
+  at[nameLength] = 0;
+  at += nameLength + 1;
+  memcpy(at, eventData, dataLength);
+  at[dataLength] = 0;
+  store.used += entry.length;
+}
+
+// the records after it move down, the store stays packed
+void PublishQueue::remove(uint16_t offset)
+{
+  uint16_t length = record(offset).length;
+  memmove(store.bytes + offset, store.bytes + offset + length, store.used - offset - length);
+  store.used -= length;
+}
+
+// the data, or a copy with " (queued at hh:mm:ss)" if the event is late; as it is if that does not fit
+const char *PublishQueue::stamp(const PublishRecord &entry, const char *eventData)
+{
+  if (not entry.stampIfLate or entry.priority == PUBLISH_TELEMETRY or entry.time == 0 or not Time.isValid() or
+      (int32_t)(Time.now() - entry.time) < PUBLISH_LATE_SECONDS)
+  {
+    return eventData;
+  }
+
+  char clock[FIXED_CLOCK_SIZE];
+  fixedClock(clock, entry.time + (Time.local() - Time.now()));
+  size_t length = strlen(eventData);
+  if (length + strlen(" (queued at ") + FIXED_CLOCK_SIZE - 1 + 1 > PUBLISH_DATA_MAX)
+  {
+    return eventData;
+  }
+  memcpy(stamped, eventData, length + 1);
+  fixedAppend(stamped, sizeof(stamped), " (queued at ");
+  fixedAppend(stamped, sizeof(stamped), clock);
+  fixedAppend(stamped, sizeof(stamped), ")");
+  return stamped;
+}
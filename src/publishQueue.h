@@ -0,0 +1,100 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Bounded, statically allocated queue in front of Particle.publish().
+//  source: https://docs.particle.io/reference/firmware/photon/#particle-publish-
+//   NOTE: Currently, a device can publish at rate of about 1 event/sec,
+//   with bursts of up to 4 allowed in 1 second.
+//  process() releases events through a token bucket with the same shape, so nothing gets dropped
+//   by the cloud, and always sends the highest priority event first.
+//  Telemetry events with the same name are coalesced: only the newest value is kept.
+//
+//  Store and forward: the events are packed one after the other in a PublishStore, meant to live in
+//   retained RAM, so the events waiting for a cloud that is down survive a reset too. When the store
+//   is full the oldest telemetry makes room first, then the oldest events, and only for an alarm:
+//   an alarm is never dropped to make room, a new one is refused when the store holds only alarms.
+//  Every event keeps the time it was queued. An alarm or an event that goes out PUBLISH_LATE_SECONDS
+//   or more after that says when it happened: " (queued at hh:mm:ss)", local time, at the end of the
+//   data. Telemetry goes out as it is, and so do the events added with stampIfLate false (their data
+//   has times of its own, or is not text).
+//  The store has no constructor on purpose, so a retained instance keeps its contents across a reset:
+//   call begin() from setup() before the first add(), it only clears the store if it doesn't look valid.
+
+#pragma once
+
+#include "Particle.h"
+
+#define PUBLISH_STORE_SIZE 2048
+#define PUBLISH_NAME_MAX 64
+#define PUBLISH_DATA_MAX 622
+#define PUBLISH_BURST 4
+#define PUBLISH_REFILL_MILLIS 1000
+#define PUBLISH_LATE_SECONDS 60
+
+// lower value, higher priority
+enum PublishPriority
+{
+  PUBLISH_ALARM = 0,     // flood
+  PUBLISH_EVENT = 1,     // garage, user notifications, errors
+  PUBLISH_TELEMETRY = 2, // periodic readings, newest value wins
+};
+
+// the events, each one a PublishRecord followed by its name and data with their terminating 0
+struct PublishStore
+{
+  uint32_t magic;
+  uint32_t nextSequence;
+  uint16_t used;
+  uint8_t bytes[PUBLISH_STORE_SIZE];
+};
+
+class PublishQueue
+{
+public:
+  // called by process() for every event the cloud took
+  typedef void (*PublishedCallback)(const char *eventName, const char *eventData);
+
+  explicit PublishQueue(PublishStore &store);
+  void begin();
+  void onPublished(PublishedCallback callback) { published = callback; }
+
+  bool add(const char *eventName, const char *eventData, PublishPriority priority, bool stampIfLate = true);
+  void process();
+
+  uint16_t pending() const;
+  uint32_t dropped() const { return droppedEvents; }
+  uint8_t tokens() const { return availableTokens; }
+  // bytes of the store in use
+  uint16_t stored() const { return store.used; }
+
+private:
+  struct PublishRecord
+  {
+    uint16_t length; // of the whole record, name and data included
+    uint8_t priority;
+    uint8_t stampIfLate;
+    uint32_t sequence;
+    uint32_t time; // unix time it was queued, 0 if the clock was not set yet
+  };
+
+  // records are packed, unaligned: they are read and written with memcpy()
+  PublishRecord record(uint16_t offset) const;
+  const char *name(uint16_t offset) const;
+  const char *data(uint16_t offset) const;
+  bool valid() const;
+  uint16_t findVictim(PublishPriority priority, uint16_t &evictable) const;
+  void append(const char *eventName, const char *eventData, PublishPriority priority, bool stampIfLate,
+              uint32_t sequence);
+  void remove(uint16_t offset);
+  const char *stamp(const PublishRecord &record, const char *eventData);
+  void refill();
+
+  PublishStore &store;
+  char stamped[PUBLISH_DATA_MAX + 1];
+  uint8_t availableTokens;
+  unsigned long lastRefill;
+  uint32_t droppedEvents;
+  PublishedCallback published;
+};
@@ -0,0 +1,118 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "relayPulse.h"
+
+RelayPulse::RelayPulse(pin_t pin, unsigned long pulseMillis, unsigned long gapMillis, PulseDoneCallback pulseDone)
+    : pin(pin), pulseMillis(pulseMillis), gapMillis(gapMillis), pulseDone(pulseDone), state(IDLE), stateStart(0), pending(0)
+{
+}
+
+/*******************************************************************************
+ * Function Name  : begin
+ * Description    : configures the relay pin as an output and releases the relay
+ *******************************************************************************/
+void RelayPulse::begin()
+{
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  state = IDLE;
+  pending = 0;
+}
+
+/*******************************************************************************
+ * Function Name  : trigger
+ * Description    : fires a pulse now, or queues it if a pulse is already running
+ * Return         : true if the pulse was started or queued, false if it was refused
+ *******************************************************************************/
+bool RelayPulse::trigger()
+{
+  if (state == IDLE)
+  {
+    startPulse();
+    return true;
+  }
+
+  if (pending >= RELAY_PULSE_MAX_PENDING)
+  {
+    return false;
+  }
+
+  pending++;
+  return true;
+}
+
+/*******************************************************************************
+ * Function Name  : busy
+ * Description    : true while a pulse (or the gap after it) is in progress
+ *******************************************************************************/
+bool RelayPulse::busy() const
+{
+  return state != IDLE;
+}
+
+/*******************************************************************************
+ * Function Name  : active
+ * Description    : true while the relay is up
+ *******************************************************************************/
+bool RelayPulse::active() const
+{
+  return state == PULSE;
+}
+
+/*******************************************************************************
+ * Function Name  : process
+ * Description    : ends the pulse when its time is up and fires the next queued one
+                    call this from loop()
+ *******************************************************************************/
+void RelayPulse::process()
+{
+  if (state == IDLE)
+  {
+    return;
+  }
+
+  unsigned long now = millis();
+
+  if (state == PULSE)
+  {
+    if (now - stateStart < pulseMillis)
+    {
+      return;
+    }
+
+    digitalWrite(pin, LOW);
+    state = GAP;
+    stateStart = now;
+
+    if (pulseDone)
+    {
+      pulseDone(pin);
+    }
+    return;
+  }
+
+  // state == GAP
+  if (now - stateStart < gapMillis)
+  {
+    return;
+  }
+
+  if (pending > 0)
+  {
+    pending--;
+    startPulse();
+    return;
+  }
+
+  state = IDLE;
+}
+
+void RelayPulse::startPulse()
+{
+  digitalWrite(pin, HIGH);
+  state = PULSE;
+  stateStart = millis();
+}
@@ -0,0 +1,48 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Non-blocking relay pulse: the relay goes up when the pulse is triggered and process(),
+//   called from loop(), brings it down once the pulse time has elapsed.
+//  A pulse requested while another one is running is queued (up to RELAY_PULSE_MAX_PENDING)
+//   and fired after a short gap so the receiver sees two separate presses, or refused if the queue is full.
+
+#pragma once
+
+#include "Particle.h"
+
+#define RELAY_PULSE_MAX_PENDING 1
+
+class RelayPulse
+{
+public:
+  // called from process() every time a pulse ends and the relay is released
+  typedef void (*PulseDoneCallback)(pin_t pin);
+
+  RelayPulse(pin_t pin, unsigned long pulseMillis, unsigned long gapMillis, PulseDoneCallback pulseDone = nullptr);
+
+  void begin();
+  bool trigger();
+  bool busy() const;
+  bool active() const;
+  void process();
+
+private:
+  enum State
+  {
+    IDLE,
+    PULSE,
+    GAP,
+  };
+
+  void startPulse();
+
+  pin_t pin;
+  unsigned long pulseMillis;
+  unsigned long gapMillis;
+  PulseDoneCallback pulseDone;
+  State state;
+  unsigned long stateStart;
+  uint8_t pending;
+};
@@ -0,0 +1,412 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "sampleCodec.h"
+
+#include <string.h>
+
+namespace
+{
+
+// the longest LEB128 varint of a 32 bit number
+#define VARINT_MAX 5
+// version, t0, values, quanta and sample count
+#define HEADER_MAX (2 + (2 + SAMPLE_SERIES_VALUES) * VARINT_MAX)
+
+// a batch never needs more than a publish can carry
+#define SAMPLE_CODEC_BINARY_MAX 512
+
+const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+uint32_t zigzag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+int32_t unzigzag(uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+
+size_t putVarint(uint8_t *out, uint32_t value)
+{
+  size_t length = 0;
+  do
+  {
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    out[length++] = value ? (byte | 0x80) : byte;
+  } while (value);
+  return length;
+}
+
+bool getVarint(const uint8_t *&in, const uint8_t *end, uint32_t &value)
+{
+  value = 0;
+  for (uint8_t shift = 0; shift < 7 * VARINT_MAX; shift += 7)
+  {
+    if (in >= end)
+    {
+      return false;
+    }
+    uint8_t byte = *in++;
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if (not(byte & 0x80))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+// bit-level varint: prefix bits and payload bits for a zig-zag encoded number
+struct BitCode
+{
+  uint8_t prefix;
+  uint8_t prefixBits;
+  uint8_t payloadBits;
+};
+
+const BitCode bitCodes[] = {
+    {0x0, 1, 0},  // 0
+    {0x2, 2, 4},  // 10 + 4 bits
+    {0x6, 3, 8},  // 110 + 8 bits
+    {0xE, 4, 16}, // 1110 + 16 bits
+    {0xF, 4, 32}, // 1111 + 32 bits
+};
+
+const BitCode &bitCodeOf(uint32_t value)
+{
+  if (value == 0)
+  {
+    return bitCodes[0];
+  }
+  if (value < 16)
+  {
+    return bitCodes[1];
+  }
+  if (value < 256)
+  {
+    return bitCodes[2];
+  }
+  if (value < 65536)
+  {
+    return bitCodes[3];
+  }
+  return bitCodes[4];
+}
+
+uint8_t bitLength(uint32_t value)
+{
+  const BitCode &code = bitCodeOf(value);
+  return code.prefixBits + code.payloadBits;
+}
+
+// msb first, the caller checked there is room
+class BitWriter
+{
+public:
+  BitWriter(uint8_t *data) : data(data), position(0) {}
+
+  void put(uint32_t bits, uint8_t count)
+  {
+    while (count--)
+    {
+      if ((position & 7) == 0)
+      {
+        data[position >> 3] = 0;
+      }
+      if ((bits >> count) & 1)
+      {
+        data[position >> 3] |= 0x80 >> (position & 7);
+      }
+      position++;
+    }
+  }
+
+  void putNumber(uint32_t value)
+  {
+    const BitCode &code = bitCodeOf(value);
+    put(code.prefix, code.prefixBits);
+    put(value, code.payloadBits);
+  }
+
+  size_t bytes() const { return (position + 7) >> 3; }
+
+private:
+  uint8_t *data;
+  size_t position;
+};
+
+class BitReader
+{
+public:
+  BitReader(const uint8_t *data, const uint8_t *end) : data(data), length((end - data) * 8), position(0) {}
+
+  bool get(uint8_t count, uint32_t &bits)
+  {
+    bits = 0;
+    if (position + count > length)
+    {
+      return false;
+    }
+    while (count--)
+    {
+      bits = (bits << 1) | ((data[position >> 3] >> (7 - (position & 7))) & 1);
+      position++;
+    }
+    return true;
+  }
+
+  bool getNumber(uint32_t &value)
+  {
+    uint8_t ones = 0;
+    uint32_t bit;
+    // count the prefix ones, the last code needs no terminating 0
+    while (ones < 4)
+    {
+      if (not get(1, bit))
+      {
+        return false;
+      }
+      if (not bit)
+      {
+        break;
+      }
+      ones++;
+    }
+    return get(bitCodes[ones].payloadBits, value);
+  }
+
+private:
+  const uint8_t *data;
+  size_t length;
+  size_t position;
+};
+
+size_t base64Encode(const uint8_t *data, size_t length, char *text)
+{
+  size_t out = 0;
+  for (size_t i = 0; i < length; i += 3)
+  {
+    uint32_t chunk = (uint32_t)data[i] << 16;
+    if (i + 1 < length)
+    {
+      chunk |= (uint32_t)data[i + 1] << 8;
+    }
+    if (i + 2 < length)
+    {
+      chunk |= data[i + 2];
+    }
+    text[out++] = base64Alphabet[(chunk >> 18) & 0x3F];
+    text[out++] = base64Alphabet[(chunk >> 12) & 0x3F];
+    text[out++] = i + 1 < length ? base64Alphabet[(chunk >> 6) & 0x3F] : '=';
+    text[out++] = i + 2 < length ? base64Alphabet[chunk & 0x3F] : '=';
+  }
+  text[out] = 0;
+  return out;
+}
+
+// returns the number of bytes decoded, -1 on a character outside the alphabet or too much data
+int base64Decode(const char *text, uint8_t *data, size_t size)
+{
+  size_t out = 0;
+  uint32_t chunk = 0;
+  uint8_t bits = 0;
+  for (; *text and *text != '='; text++)
+  {
+    const char *position = strchr(base64Alphabet, *text);
+    if (position == nullptr)
+    {
+      return -1;
+    }
+    chunk = (chunk << 6) | (uint32_t)(position - base64Alphabet);
+    bits += 6;
+    if (bits >= 8)
+    {
+      bits -= 8;
+      if (out >= size)
+      {
+        return -1;
+      }
+      data[out++] = (chunk >> bits) & 0xFF;
+    }
+  }
+  return out;
+}
+
+uint16_t gcd(uint16_t a, uint16_t b)
+{
+  while (b)
+  {
+    uint16_t rest = a % b;
+    a = b;
+    b = rest;
+  }
+  return a;
+}
+
+uint8_t binary[SAMPLE_CODEC_BINARY_MAX];
+
+} // namespace
+
+size_t sampleCodec_encode(const SampleSeries &series, uint8_t values, char *text, size_t size, uint16_t &samples)
+{
+  samples = 0;
+  if (size == 0)
+  {
+    return 0;
+  }
+  text[0] = 0;
+  if (series.size() == 0)
+  {
+    return 0;
+  }
+  if (values > SAMPLE_SERIES_VALUES)
+  {
+    values = SAMPLE_SERIES_VALUES;
+  }
+
+  // room for the binary once base64 encoded, the bit stream goes after the largest possible header
+  size_t capacity = (size - 1) / 4 * 3;
+  if (capacity > SAMPLE_CODEC_BINARY_MAX)
+  {
+    capacity = SAMPLE_CODEC_BINARY_MAX;
+  }
+  if (capacity <= HEADER_MAX)
+  {
+    return 0;
+  }
+  size_t bitsLeft = (capacity - HEADER_MAX) * 8;
+
+  // the DHT22 reads in tenths: readings in hundredths are all multiples of 10
+  uint16_t quantum[SAMPLE_SERIES_VALUES];
+  for (uint8_t v = 0; v < values; v++)
+  {
+    quantum[v] = 0;
+    for (uint16_t i = 0; i < series.size() and quantum[v] != 1; i++)
+    {
+      int32_t value = series.at(i).values[v];
+      quantum[v] = gcd(quantum[v], value < 0 ? -value : value);
+    }
+    if (quantum[v] == 0)
+    {
+      quantum[v] = 1;
+    }
+  }
+
+  BitWriter writer(binary + HEADER_MAX);
+  uint32_t previousStep = 0;
+  int32_t previous[SAMPLE_SERIES_VALUES] = {0};
+  for (uint16_t i = 0; i < series.size(); i++)
+  {
+    const SeriesSample &sample = series.at(i);
+    uint32_t step = i == 0 ? 0 : sample.time - series.at(i - 1).time;
+    uint32_t codes[1 + SAMPLE_SERIES_VALUES];
+    codes[0] = zigzag((int32_t)(step - previousStep));
+    size_t bits = bitLength(codes[0]);
+    for (uint8_t v = 0; v < values; v++)
+    {
+      int32_t value = sample.values[v] / quantum[v];
+      codes[1 + v] = zigzag(value - previous[v]);
+      bits += bitLength(codes[1 + v]);
+    }
+
+    // a sample goes in whole or not at all
+    if (bits > bitsLeft)
+    {
+      break;
+    }
+    bitsLeft -= bits;
+    for (uint8_t c = 0; c <= values; c++)
+    {
+      writer.putNumber(codes[c]);
+    }
+
+    previousStep = step;
+    for (uint8_t v = 0; v < values; v++)
+    {
+      previous[v] = sample.values[v] / quantum[v];
+    }
+    samples++;
+  }
+
+  if (samples == 0)
+  {
+    return 0;
+  }
+
+  // the real header is shorter than HEADER_MAX, it goes right before the bit stream
+  uint8_t header[HEADER_MAX];
+  size_t headerLength = 0;
+  header[headerLength++] = SAMPLE_CODEC_VERSION;
+  headerLength += putVarint(header + headerLength, series.at(0).time);
+  header[headerLength++] = values;
+  for (uint8_t v = 0; v < values; v++)
+  {
+    headerLength += putVarint(header + headerLength, quantum[v]);
+  }
+  headerLength += putVarint(header + headerLength, samples);
+  uint8_t *start = binary + HEADER_MAX - headerLength;
+  memcpy(start, header, headerLength);
+
+  return base64Encode(start, headerLength + writer.bytes(), text);
+}
+
+int sampleCodec_decode(const char *text, uint8_t &values, SeriesSample *samples, uint16_t maxSamples)
+{
+  static uint8_t data[SAMPLE_CODEC_BINARY_MAX];
+  int length = base64Decode(text, data, sizeof(data));
+  if (length < 3 or data[0] != SAMPLE_CODEC_VERSION)
+  {
+    return -1;
+  }
+
+  const uint8_t *in = data + 1;
+  const uint8_t *end = data + length;
+  uint32_t time;
+  if (not getVarint(in, end, time) or in >= end or *in > SAMPLE_SERIES_VALUES)
+  {
+    return -1;
+  }
+  values = *in++;
+  uint32_t quantum[SAMPLE_SERIES_VALUES];
+  for (uint8_t v = 0; v < values; v++)
+  {
+    if (not getVarint(in, end, quantum[v]))
+    {
+      return -1;
+    }
+  }
+  uint32_t sampleCount;
+  if (not getVarint(in, end, sampleCount))
+  {
+    return -1;
+  }
+
+  BitReader reader(in, end);
+  uint32_t step = 0;
+  int32_t previous[SAMPLE_SERIES_VALUES] = {0};
+  uint16_t decoded = 0;
+  for (uint32_t i = 0; i < sampleCount and decoded < maxSamples; i++)
+  {
+    uint32_t code;
+    if (not reader.getNumber(code))
+    {
+      return -1;
+    }
+    step += (uint32_t)unzigzag(code);
+    time += step;
+
+    SeriesSample &sample = samples[decoded++];
+    sample.time = time;
+    for (uint8_t v = 0; v < SAMPLE_SERIES_VALUES; v++)
+    {
+      if (v < values)
+      {
+        if (not reader.getNumber(code))
+        {
+          return -1;
+        }
+        previous[v] += unzigzag(code);
+      }
+      sample.values[v] = v < values ? previous[v] * (int32_t)quantum[v] : 0;
+    }
+  }
+  return decoded;
+}
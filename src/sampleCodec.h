@@ -0,0 +1,41 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Compact encoding of a SampleSeries batch for one publish, base64 so it's printable.
+//  Header, bytes (varints are LEB128):
+//    SAMPLE_CODEC_VERSION, t0 (varint, unix time of the first sample), values per sample,
+//    a quantum per value (varint, every reading of the batch is a multiple of it), sample count (varint)
+//  Then a bit stream, for every sample:
+//    change of the time step, (t[i] - t[i-1]) - (t[i-1] - t[i-2]), 0 for the first sample
+//    for every value, change from the previous sample in quanta (the first sample starts from 0)
+//  Every number is zig-zag encoded and written as a bit-level varint:
+//    0 -> '0', < 16 -> '10' + 4 bits, < 256 -> '110' + 8 bits, < 65536 -> '1110' + 16 bits, else '1111' + 32 bits
+//  so a steady time step costs one bit, and so does a reading that did not change.
+//  host/seriesDecode decodes it back to CSV.
+
+#pragma once
+
+#include "sampleSeries.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SAMPLE_CODEC_VERSION 1
+
+/*******************************************************************************
+ * Function Name  : sampleCodec_encode
+ * Description    : encodes as many of the oldest samples of series as fit in size characters (with the
+                    terminating 0), with the first `values` readings of each
+ * Return         : the length of the text, samples gets the number of samples encoded
+ *******************************************************************************/
+size_t sampleCodec_encode(const SampleSeries &series, uint8_t values, char *text, size_t size, uint16_t &samples);
+
+/*******************************************************************************
+ * Function Name  : sampleCodec_decode
+ * Description    : decodes a batch written by sampleCodec_encode(), up to maxSamples of it
+ * Return         : the number of samples decoded (values gets the readings per sample),
+                    -1 if the text is not a valid batch
+ *******************************************************************************/
+int sampleCodec_decode(const char *text, uint8_t &values, SeriesSample *samples, uint16_t maxSamples);
@@ -0,0 +1,128 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "sampleSeries.h"
+#include "fixedFormat.h"
+
+#include <string.h>
+
+// changes whenever the layout of SampleSeries changes, so old retained contents are discarded
+#define SAMPLE_SERIES_MAGIC (0x53455201UL ^ (SAMPLE_SERIES_CAPACITY << 8) ^ SAMPLE_SERIES_VALUES)
+
+/*******************************************************************************
+ * Function Name  : begin
+ * Description    : keeps the samples that survived a reset, clears the series if it's not valid
+ *******************************************************************************/
+void SampleSeries::begin()
+{
+  if (magic != SAMPLE_SERIES_MAGIC or head >= SAMPLE_SERIES_CAPACITY or count > SAMPLE_SERIES_CAPACITY)
+  {
+    clear();
+  }
+}
+
+void SampleSeries::clear()
+{
+  magic = SAMPLE_SERIES_MAGIC;
+  head = 0;
+  count = 0;
+  lost = 0;
+}
+
+/*******************************************************************************
+ * Function Name  : add
+ * Description    : appends a sample, overwriting the oldest one if the series is full
+ *******************************************************************************/
+void SampleSeries::add(uint32_t time, int16_t first, int16_t second)
+{
+  SeriesSample &sample = ring[head];
+  sample.time = time;
+  sample.values[0] = first;
+  sample.values[1] = second;
+
+  head = (head + 1) % SAMPLE_SERIES_CAPACITY;
+  if (count < SAMPLE_SERIES_CAPACITY)
+  {
+    count++;
+  }
+  else
+  {
+    lost++;
+  }
+}
+
+/*******************************************************************************
+ * Function Name  : drop
+ * Description    : removes the oldest samples, usually the ones format() just wrote
+ *******************************************************************************/
+void SampleSeries::drop(uint16_t samples)
+{
+  count = samples < count ? count - samples : 0;
+}
+
+const SeriesSample &SampleSeries::at(uint16_t index) const
+{
+  uint16_t oldest = (head + SAMPLE_SERIES_CAPACITY - count) % SAMPLE_SERIES_CAPACITY;
+  return ring[(oldest + index) % SAMPLE_SERIES_CAPACITY];
+}
+
+/*******************************************************************************
+ * Function Name  : format
+ * Description    : writes the oldest samples as {"t0":<unix time>,"d":[[<seconds since t0>,<value>,..],..]}
+                    with the first `values` readings of every sample, two decimals each,
+                    stopping at the last sample that fits in size
+ * Return         : the length written, samples gets the number of samples in it (0 if the series is empty)
+ *******************************************************************************/
+size_t SampleSeries::format(char *buffer, size_t size, uint8_t values, uint16_t &samples) const
+{
+  samples = 0;
+  if (size == 0)
+  {
+    return 0;
+  }
+  buffer[0] = 0;
+  if (count == 0)
+  {
+    return 0;
+  }
+  if (values > SAMPLE_SERIES_VALUES)
+  {
+    values = SAMPLE_SERIES_VALUES;
+  }
+
+  uint32_t t0 = at(0).time;
+  char number[16];
+  fixedFormat(number, sizeof(number), (int32_t)t0, 0);
+  size_t length = fixedAppend(buffer, size, "{\"t0\":");
+  length = fixedAppend(buffer, size, number);
+  length = fixedAppend(buffer, size, ",\"d\":[");
+
+  // each sample is added only if it fits together with the closing "]}"
+  char entry[64];
+  for (uint16_t i = 0; i < count; i++)
+  {
+    const SeriesSample &sample = at(i);
+    entry[0] = 0;
+    fixedAppend(entry, sizeof(entry), i == 0 ? "[" : ",[");
+    fixedFormat(number, sizeof(number), (int32_t)(sample.time - t0), 0);
+    fixedAppend(entry, sizeof(entry), number);
+    for (uint8_t v = 0; v < values; v++)
+    {
+      fixedFormat(number, sizeof(number), sample.values[v], 2);
+      fixedAppend(entry, sizeof(entry), ",");
+      fixedAppend(entry, sizeof(entry), number);
+    }
+    size_t entryLength = fixedAppend(entry, sizeof(entry), "]");
+
+    if (length + entryLength + 2 >= size)
+    {
+      break;
+    }
+    length = fixedAppend(buffer, size, entry);
+    samples++;
+  }
+
+  return fixedAppend(buffer, size, "]}");
+}
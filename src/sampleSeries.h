@@ -0,0 +1,49 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Fixed-capacity time series of sensor readings, meant to live in retained RAM.
+//  Every sample is a unix time plus up to SAMPLE_SERIES_VALUES readings in hundredths
+//   (e.g. temperature and humidity). When the series is full the oldest sample is overwritten.
+//  Samples are sent in batches: format() writes as many of the oldest samples as fit in one
+//   publish, and drop() removes them once the publish was queued.
+//  There is no constructor on purpose, so a retained instance keeps its contents across a reset:
+//   call begin() from setup(), it only clears the series if it doesn't look valid.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SAMPLE_SERIES_CAPACITY 64
+#define SAMPLE_SERIES_VALUES 2
+
+struct SeriesSample
+{
+  uint32_t time;
+  int16_t values[SAMPLE_SERIES_VALUES];
+};
+
+class SampleSeries
+{
+public:
+  void begin();
+  void clear();
+
+  void add(uint32_t time, int16_t first, int16_t second = 0);
+  void drop(uint16_t samples);
+
+  uint16_t size() const { return count; }
+  const SeriesSample &at(uint16_t index) const; // 0 is the oldest
+  uint32_t overwritten() const { return lost; }
+
+  size_t format(char *buffer, size_t size, uint8_t values, uint16_t &samples) const;
+
+private:
+  uint32_t magic;
+  uint16_t head; // next slot to write
+  uint16_t count;
+  uint32_t lost;
+  SeriesSample ring[SAMPLE_SERIES_CAPACITY];
+};
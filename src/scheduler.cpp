@@ -0,0 +1,215 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "scheduler.h"
+
+Scheduler::Scheduler() : taskCount(0), heapSize(0)
+{
+}
+
+/*******************************************************************************
+ * Function Name  : add
+ * Description    : registers a task, it won't run until start() is called
+                    if stats is given, every run of the task is timed into it
+ * Return         : the id of the task, SCHEDULER_NO_TASK if there is no room
+ *******************************************************************************/
+TaskId Scheduler::add(TaskCallback callback, LatencyHistogram *stats)
+{
+  if (taskCount >= SCHEDULER_MAX_TASKS)
+  {
+    return SCHEDULER_NO_TASK;
+  }
+
+  Task &task = tasks[taskCount];
+  task.callback = callback;
+  task.stats = stats;
+  task.deadline = 0;
+  task.period = 0;
+  task.heapIndex = SCHEDULER_NO_TASK;
+  return taskCount++;
+}
+
+/*******************************************************************************
+ * Function Name  : start
+ * Description    : arms (or re-arms) a task to run delayMillis from now,
+                    and then every periodMillis if that is not 0
+ *******************************************************************************/
+void Scheduler::start(TaskId id, unsigned long delayMillis, unsigned long periodMillis)
+{
+  if (id < 0 or id >= taskCount)
+  {
+    return;
+  }
+
+  remove(id);
+  tasks[id].deadline = millis() + delayMillis;
+  tasks[id].period = periodMillis;
+  push(id);
+}
+
+/*******************************************************************************
+ * Function Name  : stop
+ * Description    : disarms a task, it stays registered and can be started again
+ *******************************************************************************/
+void Scheduler::stop(TaskId id)
+{
+  if (id < 0 or id >= taskCount)
+  {
+    return;
+  }
+  remove(id);
+}
+
+bool Scheduler::active(TaskId id) const
+{
+  return id >= 0 and id < taskCount and tasks[id].heapIndex != SCHEDULER_NO_TASK;
+}
+
+unsigned long Scheduler::remaining(TaskId id) const
+{
+  if (not active(id))
+  {
+    return SCHEDULER_NEVER;
+  }
+  long left = (long)(tasks[id].deadline - millis());
+  return left > 0 ? left : 0;
+}
+
+/*******************************************************************************
+ * Function Name  : dispatch
+ * Description    : runs every task whose deadline has passed, call this from loop()
+                    periodic tasks that fell behind skip the missed runs instead of bursting
+ *******************************************************************************/
+void Scheduler::dispatch()
+{
+  unsigned long now = millis();
+
+  while (heapSize > 0)
+  {
+    TaskId id = heap[0];
+    Task &task = tasks[id];
+    if ((long)(now - task.deadline) < 0)
+    {
+      return;
+    }
+
+    // re-arm before running, so the task can stop or restart itself
+    remove(id);
+    if (task.period > 0)
+    {
+      task.deadline += task.period;
+      if ((long)(now - task.deadline) >= 0)
+      {
+        task.deadline = now + task.period;
+      }
+      push(id);
+    }
+
+    if (task.stats)
+    {
+      uint32_t start = loopStats_ticks();
+      task.callback();
+      task.stats->record(loopStats_elapsed(start));
+    }
+    else
+    {
+      task.callback();
+    }
+  }
+}
+
+/*******************************************************************************
+ * Function Name  : nextDeadline
+ * Description    : milliseconds until the next task is due
+ * Return         : 0 if a task is due now, SCHEDULER_NEVER if no task is armed
+ *******************************************************************************/
+unsigned long Scheduler::nextDeadline() const
+{
+  if (heapSize == 0)
+  {
+    return SCHEDULER_NEVER;
+  }
+
+  long remaining = (long)(tasks[heap[0]].deadline - millis());
+  return remaining > 0 ? remaining : 0;
+}
+
+bool Scheduler::earlier(int8_t a, int8_t b) const
+{
+  return (long)(tasks[heap[a]].deadline - tasks[heap[b]].deadline) < 0;
+}
+
+void Scheduler::swap(int8_t a, int8_t b)
+{
+  TaskId id = heap[a];
+  heap[a] = heap[b];
+  heap[b] = id;
+  tasks[heap[a]].heapIndex = a;
+  tasks[heap[b]].heapIndex = b;
+}
+
+void Scheduler::siftUp(int8_t index)
+{
+  while (index > 0)
+  {
+    int8_t parent = (index - 1) / 2;
+    if (not earlier(index, parent))
+    {
+      return;
+    }
+    swap(index, parent);
+    index = parent;
+  }
+}
+
+void Scheduler::siftDown(int8_t index)
+{
+  while (true)
+  {
+    int8_t smallest = index;
+    int8_t left = 2 * index + 1;
+    int8_t right = left + 1;
+    if (left < heapSize and earlier(left, smallest))
+    {
+      smallest = left;
+    }
+    if (right < heapSize and earlier(right, smallest))
+    {
+      smallest = right;
+    }
+    if (smallest == index)
+    {
+      return;
+    }
+    swap(index, smallest);
+    index = smallest;
+  }
+}
+
+void Scheduler::push(TaskId id)
+{
+  heap[heapSize] = id;
+  tasks[id].heapIndex = heapSize;
+  heapSize++;
+  siftUp(heapSize - 1);
+}
+
+void Scheduler::remove(TaskId id)
+{
+  int8_t index = tasks[id].heapIndex;
+  if (index == SCHEDULER_NO_TASK)
+  {
+    return;
+  }
+
+  heapSize--;
+  if (index != heapSize)
+  {
+    swap(index, heapSize);
+    siftDown(index);
+    siftUp(index);
+  }
+  tasks[id].heapIndex = SCHEDULER_NO_TASK;
+}
@@ -0,0 +1,60 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Deadline-driven cooperative scheduler.
+//  Tasks are registered once with add() and then armed with start(), either periodic or one-shot.
+//  Armed tasks sit in a min-heap ordered by deadline, so dispatch() only looks at the tasks
+//   that are due and nextDeadline() tells how long loop() can stay idle.
+//  Deadlines are millis() based and wrap fine as long as they are less than 24 days away.
+
+#pragma once
+
+#include "Particle.h"
+#include "loopStats.h"
+
+#define SCHEDULER_MAX_TASKS 16
+#define SCHEDULER_NO_TASK -1
+#define SCHEDULER_NEVER 0xFFFFFFFFUL
+
+typedef void (*TaskCallback)();
+typedef int8_t TaskId;
+
+class Scheduler
+{
+public:
+  Scheduler();
+
+  TaskId add(TaskCallback callback, LatencyHistogram *stats = nullptr);
+  void start(TaskId id, unsigned long delayMillis, unsigned long periodMillis = 0);
+  void stop(TaskId id);
+  bool active(TaskId id) const;
+  // milliseconds until the task runs, SCHEDULER_NEVER if it is not armed
+  unsigned long remaining(TaskId id) const;
+
+  void dispatch();
+  unsigned long nextDeadline() const;
+
+private:
+  struct Task
+  {
+    TaskCallback callback;
+    LatencyHistogram *stats;
+    unsigned long deadline;
+    unsigned long period;
+    int8_t heapIndex; // SCHEDULER_NO_TASK when not armed
+  };
+
+  bool earlier(int8_t a, int8_t b) const;
+  void swap(int8_t a, int8_t b);
+  void siftUp(int8_t index);
+  void siftDown(int8_t index);
+  void push(TaskId id);
+  void remove(TaskId id);
+
+  Task tasks[SCHEDULER_MAX_TASKS];
+  TaskId heap[SCHEDULER_MAX_TASKS];
+  int8_t taskCount;
+  int8_t heapSize;
+};
@@ -0,0 +1,393 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "sensorRegistry.h"
+
+#include <algorithm>
+#include <utility>
+
+SensorRegistry *SensorRegistry::instance = nullptr;
+
+namespace
+{
+
+// attachInterrupt() takes a plain function, so each sensor index gets its own
+template <uint8_t INDEX>
+void sensorIsr()
+{
+  SensorRegistry::interrupt(INDEX);
+}
+
+template <size_t... INDEX>
+raw_interrupt_handler_t isrFor(uint8_t index, std::index_sequence<INDEX...>)
+{
+  static const raw_interrupt_handler_t handlers[] = {sensorIsr<INDEX>...};
+  return handlers[index];
+}
+
+raw_interrupt_handler_t isrFor(uint8_t index)
+{
+  return isrFor(index, std::make_index_sequence<SENSOR_REGISTRY_INTERRUPTS>());
+}
+
+// periodic deadlines move one period at a time, or restart from now when they fell behind
+void advance(unsigned long &deadline, unsigned long period, unsigned long now)
+{
+  deadline += period;
+  if ((long)(now - deadline) >= 0)
+  {
+    deadline = now + period;
+  }
+}
+
+bool reached(unsigned long deadline, unsigned long now)
+{
+  return (long)(now - deadline) >= 0;
+}
+
+uint8_t eventBit(SensorEvent event)
+{
+  return 1 << event;
+}
+
+// the order collect() hands out the events held for a leak sensor: the water came last for a sensor
+//  wet by now, first for one that is dry by now
+const SensorEvent collectWet[] = {SENSOR_DRY, SENSOR_WET, SENSOR_ALARM, SENSOR_READING};
+const SensorEvent collectDry[] = {SENSOR_WET, SENSOR_ALARM, SENSOR_DRY, SENSOR_READING};
+
+} // namespace
+
+SensorRegistry::SensorRegistry(const SensorDescriptor *sensors, SensorState *states, uint8_t count, EventCallback onEvent)
+    : sensors(sensors), states(states), sensorCount(count), eventCallback(onEvent), edgeCallback(nullptr),
+      edgeSeen(false), scheduled(false), nextDue(0)
+{
+}
+
+/*******************************************************************************
+ * Function Name  : begin
+ * Description    : sets up the pins and interrupts, leak sensors watched by an interrupt are read
+                    on the first process(), the others after their period
+ *******************************************************************************/
+void SensorRegistry::begin()
+{
+  instance = this;
+  unsigned long now = millis();
+
+  for (uint8_t i = 0; i < sensorCount; i++)
+  {
+    const SensorDescriptor &sensor = sensors[i];
+    SensorState &state = states[i];
+    state.nextCheck = now + sensor.periodMillis;
+    state.nextAlarm = 0;
+    state.edge = false;
+    state.sinceValid = false;
+    state.since = 0;
+    state.active = false;
+    state.alarmArmed = false;
+    state.alarmIndex = 0;
+    state.reading = DHT_READ_NONE;
+    state.held = 0;
+
+    if (sensor.type == SENSOR_LEAK)
+    {
+      pinMode(sensor.pin, INPUT_PULLUP);
+      if ((sensor.flags & SENSOR_INTERRUPT) and i < SENSOR_REGISTRY_INTERRUPTS)
+      {
+        attachInterrupt(sensor.pin, isrFor(i), CHANGE);
+        state.nextCheck = now;
+      }
+    }
+  }
+
+  scheduled = sensorCount > 0;
+  nextDue = now;
+}
+
+/*******************************************************************************
+ * Function Name  : process
+ * Description    : reads the sensors that are due, fires the alarms that are due and hands out
+                    the DHT22 readings, call this from loop() when due()
+ *******************************************************************************/
+void SensorRegistry::process()
+{
+  unsigned long now = millis();
+
+  // cleared first, an interrupt during the pass sets it again
+  edgeSeen = false;
+  scheduled = false;
+  for (uint8_t i = 0; i < sensorCount; i++)
+  {
+    unsigned long next = sensors[i].type == SENSOR_LEAK ? processLeak(i, now) : processDht(i, now);
+    if (not scheduled or (long)(next - nextDue) < 0)
+    {
+      nextDue = next;
+      scheduled = true;
+    }
+  }
+}
+
+SensorMessage SensorRegistry::message(uint8_t index, SensorEvent event) const
+{
+  const DhtReader *dht = sensors[index].dht;
+  SensorMessage message;
+  message.index = index;
+  message.event = event;
+  message.reading = states[index].reading;
+  message.status = dht ? dht->status() : 0;
+  message.celsius = dht ? dht->celsius() : 0;
+  message.humidity = dht ? dht->humidity() : 0;
+  return message;
+}
+
+void SensorRegistry::hold(uint8_t index, SensorEvent event)
+{
+  ATOMIC_BLOCK()
+  {
+    states[index].held |= eventBit(event);
+  }
+}
+
+bool SensorRegistry::anyHeld() const
+{
+  for (uint8_t i = 0; i < sensorCount; i++)
+  {
+    if (states[i].held)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*******************************************************************************
+ * Function Name  : collect
+ * Description    : hands out the next event held by hold(), with what the sensor says now;
+                    a sensor that went wet and dry again while they were held gives them in an order
+                    that ends where the sensor is now
+ * Return         : false when no event is held
+ *******************************************************************************/
+bool SensorRegistry::collect(SensorMessage &message)
+{
+  for (uint8_t i = 0; i < sensorCount; i++)
+  {
+    SensorState &state = states[i];
+    if (state.held == 0)
+    {
+      continue;
+    }
+    // a sensor thread can not change the state or the reading while we take them
+    ATOMIC_BLOCK()
+    {
+      const SensorEvent *order = state.active ? collectWet : collectDry;
+      for (uint8_t k = 0; k < arraySize(collectWet); k++)
+      {
+        if (state.held & eventBit(order[k]))
+        {
+          state.held &= ~eventBit(order[k]);
+          message = this->message(i, order[k]);
+          break;
+        }
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+LeakAlarms SensorRegistry::leakAlarms(uint8_t index) const
+{
+  const SensorState &state = states[index];
+  LeakAlarms alarms;
+  alarms.active = state.active;
+  alarms.armed = state.alarmArmed;
+  alarms.index = state.alarmIndex;
+  long left = (long)(state.nextAlarm - millis());
+  alarms.nextInMillis = state.alarmArmed and left > 0 ? left : 0;
+  return alarms;
+}
+
+/*******************************************************************************
+ * Function Name  : restoreLeakAlarms
+ * Description    : takes back where the alarms of a leak sensor were before a reset; the next
+                    process() reads the sensor, if it is dry by now it raises SENSOR_DRY
+ *******************************************************************************/
+void SensorRegistry::restoreLeakAlarms(uint8_t index, const LeakAlarms &alarms)
+{
+  if (index >= sensorCount or sensors[index].type != SENSOR_LEAK or not alarms.active)
+  {
+    return;
+  }
+  const SensorDescriptor &sensor = sensors[index];
+  SensorState &state = states[index];
+  state.active = true;
+  state.alarmArmed = alarms.armed and sensor.alarmCount > 0;
+  state.alarmIndex = state.alarmArmed ? std::min<uint8_t>(alarms.index, sensor.alarmCount - 1) : 0;
+  state.nextAlarm = millis() + alarms.nextInMillis;
+  state.nextCheck = millis();
+  nextDue = millis();
+  scheduled = true;
+}
+
+/*******************************************************************************
+ * Function Name  : nextDueMillis
+ * Description    : lets loop() know how long nothing can happen here, unless an interrupt comes
+ * Return         : 0 when process() has work now, SENSOR_NEVER when nothing is scheduled
+ *******************************************************************************/
+unsigned long SensorRegistry::nextDueMillis() const
+{
+  if (edgeSeen)
+  {
+    return 0;
+  }
+  if (not scheduled)
+  {
+    return SENSOR_NEVER;
+  }
+  long remaining = (long)(nextDue - millis());
+  return remaining > 0 ? remaining : 0;
+}
+
+// returns when the sensor needs process() again
+unsigned long SensorRegistry::processLeak(uint8_t index, unsigned long now)
+{
+  const SensorDescriptor &sensor = sensors[index];
+  SensorState &state = states[index];
+
+  bool edge;
+  ATOMIC_BLOCK()
+  {
+    edge = state.edge;
+    state.edge = false;
+  }
+  // the pin moved: read it once it settles, the periodic reads go on from there
+  if (edge)
+  {
+    state.nextCheck = now + SENSOR_DEBOUNCE;
+  }
+
+  if (reached(state.nextCheck, now))
+  {
+    advance(state.nextCheck, sensor.periodMillis, now);
+    checkLeak(index, now);
+  }
+
+  if (state.alarmArmed and reached(state.nextAlarm, now))
+  {
+    // next alarm, or the last one again if there are no more
+    if (state.alarmIndex < sensor.alarmCount - 1)
+    {
+      state.alarmIndex++;
+    }
+    state.nextAlarm = now + sensor.alarms[state.alarmIndex];
+    eventCallback(index, SENSOR_ALARM);
+  }
+
+  if (state.alarmArmed and (long)(state.nextAlarm - state.nextCheck) < 0)
+  {
+    return state.nextAlarm;
+  }
+  return state.nextCheck;
+}
+
+void SensorRegistry::checkLeak(uint8_t index, unsigned long now)
+{
+  const SensorDescriptor &sensor = sensors[index];
+  SensorState &state = states[index];
+
+  if (not digitalRead(sensor.pin))
+  {
+    // already wet, the alarms are on their way
+    if (state.active)
+    {
+      return;
+    }
+    state.active = true;
+
+    // first alarm, counting from the moment the water showed up if the interrupt saw it
+    unsigned long sinceWater = 0;
+    ATOMIC_BLOCK()
+    {
+      if (state.sinceValid)
+      {
+        sinceWater = now - state.since;
+      }
+    }
+    state.alarmIndex = 0;
+    state.alarmArmed = sensor.alarmCount > 0;
+    if (state.alarmArmed)
+    {
+      unsigned long firstAlarm = sensor.alarms[0];
+      state.nextAlarm = now + (sinceWater < firstAlarm ? firstAlarm - sinceWater : 0);
+    }
+    eventCallback(index, SENSOR_WET);
+  }
+  else
+  {
+    bool wasActive = state.active;
+    state.active = false;
+    state.alarmArmed = false;
+    ATOMIC_BLOCK()
+    {
+      state.sinceValid = false;
+    }
+    if (wasActive)
+    {
+      eventCallback(index, SENSOR_DRY);
+    }
+  }
+}
+
+unsigned long SensorRegistry::processDht(uint8_t index, unsigned long now)
+{
+  const SensorDescriptor &sensor = sensors[index];
+  SensorState &state = states[index];
+
+  if (reached(state.nextCheck, now))
+  {
+    advance(state.nextCheck, sensor.periodMillis, now);
+    sensor.dht->start();
+  }
+
+  DhtReadResult reading = sensor.dht->poll();
+  if (reading != DHT_READ_NONE)
+  {
+    state.reading = reading;
+    eventCallback(index, SENSOR_READING);
+  }
+
+  unsigned long poll = sensor.dht->nextPollMillis();
+  if (poll != DHT_READER_NEVER and (long)(now + poll - state.nextCheck) < 0)
+  {
+    return now + poll;
+  }
+  return state.nextCheck;
+}
+
+/*******************************************************************************
+ * Function Name  : interrupt
+ * Description    : a leak sensor changed: takes note of when the water showed up, process() does the rest
+ *******************************************************************************/
+void SensorRegistry::interrupt(uint8_t index)
+{
+  SensorRegistry *registry = instance;
+  if (registry == nullptr or index >= registry->sensorCount)
+  {
+    return;
+  }
+
+  SensorState &state = registry->states[index];
+  int level = digitalRead(registry->sensors[index].pin);
+  if (not state.sinceValid and not level)
+  {
+    state.since = millis();
+    state.sinceValid = true;
+  }
+  state.edge = true;
+  registry->edgeSeen = true;
+  if (registry->edgeCallback)
+  {
+    registry->edgeCallback(index, level);
+  }
+}
@@ -0,0 +1,155 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Table of the sensors of the unit: adding a leak sensor or a DHT22 is one more line in the table.
+//  The descriptors are constant (they stay in flash) and the state of every sensor is one entry of a
+//   contiguous array. process() walks both in a single pass, and only has to run when due() says some
+//   sensor is due or an interrupt came in, so loop() pays next to nothing for the sensors in between.
+//
+//  Leak sensors (SENSOR_LEAK) read low when wet. They are read every periodMillis and, with
+//   SENSOR_INTERRUPT, SENSOR_DEBOUNCE after the last change seen by their interrupt, which also takes note
+//   of when the water showed up. Once wet, SENSOR_ALARM comes after each delay of the alarm schedule,
+//   counted from the water, the last delay repeats until the sensor is dry.
+//  DHT22 sensors (SENSOR_DHT22) start a reading of their DhtReader every periodMillis, SENSOR_READING
+//   comes with the outcome of every attempt (state().reading). Each one needs its own PietteTech_DHT,
+//   the library wants a wrapper function for its interrupt.
+//  process() can run in a thread of its own: message() copies what an event has to say, reading
+//   included, so the callback can hand it over to loop() (see SensorMessage). When the way to loop() is
+//   full the callback hold()s the event instead, one bit of the state of the sensor: the callback never
+//   waits and loop() collect()s it later. The readings of a DHT22 held back coalesce into its latest one.
+
+#pragma once
+
+#include "Particle.h"
+#include "dhtReader.h"
+
+// interrupt handlers available, sensors past them with SENSOR_INTERRUPT are only polled
+#define SENSOR_REGISTRY_INTERRUPTS 16
+#define SENSOR_DEBOUNCE 50
+#define SENSOR_NEVER 0xFFFFFFFFUL
+
+enum SensorType : uint8_t
+{
+  SENSOR_LEAK,
+  SENSOR_DHT22,
+};
+
+// descriptor flags
+#define SENSOR_INTERRUPT 0x01
+
+enum SensorEvent : uint8_t
+{
+  SENSOR_WET,
+  SENSOR_ALARM,
+  SENSOR_DRY,
+  SENSOR_READING,
+};
+
+struct SensorDescriptor
+{
+  const char *name;
+  pin_t pin;
+  SensorType type;
+  uint8_t flags;
+  unsigned long periodMillis;
+  // leak: delays of the alarms, in milliseconds
+  const unsigned long *alarms;
+  uint8_t alarmCount;
+  // DHT22: the reader of its PietteTech_DHT
+  DhtReader *dht;
+};
+
+struct SensorState
+{
+  unsigned long nextCheck;
+  unsigned long nextAlarm;
+  // set by the interrupt: a change is waiting to be debounced, and since when the sensor is wet
+  volatile bool edge;
+  volatile bool sinceValid;
+  volatile unsigned long since;
+  bool active;
+  bool alarmArmed;
+  uint8_t alarmIndex;
+  DhtReadResult reading;
+  // events held for collect(), one bit per SensorEvent
+  volatile uint8_t held;
+};
+
+// what a leak sensor must not forget across a reset: that it is wet and how far the alarms went
+struct LeakAlarms
+{
+  bool active;
+  bool armed;
+  uint8_t index;
+  unsigned long nextInMillis; // time to the next alarm, when armed
+};
+
+// an event and what goes with it, to read after the sensor has moved on (the DHT22 started the next reading)
+struct SensorMessage
+{
+  uint8_t index;
+  SensorEvent event;
+  // SENSOR_READING: the outcome, the status of the library and what the sensor said
+  DhtReadResult reading;
+  int status;
+  float celsius;
+  float humidity;
+};
+
+class SensorRegistry
+{
+public:
+  // process() context: loop(), or the thread that runs the registry
+  typedef void (*EventCallback)(uint8_t index, SensorEvent event);
+  // interrupt context, with the level the interrupt read
+  typedef void (*EdgeCallback)(uint8_t index, int level);
+
+  SensorRegistry(const SensorDescriptor *sensors, SensorState *states, uint8_t count, EventCallback onEvent);
+
+  void begin();
+  void onEdge(EdgeCallback callback) { edgeCallback = callback; }
+
+  // loop() checks this on every pass and calls process() only when it is true
+  bool due() const { return edgeSeen or (scheduled and (long)(millis() - nextDue) >= 0); }
+  void process();
+  // how long loop() can wait before process() has something to do, SENSOR_NEVER when nothing is scheduled
+  unsigned long nextDueMillis() const;
+
+  uint8_t count() const { return sensorCount; }
+  const SensorDescriptor &sensor(uint8_t index) const { return sensors[index]; }
+  const SensorState &state(uint8_t index) const { return states[index]; }
+  // for the event callback
+  SensorMessage message(uint8_t index, SensorEvent event) const;
+  // for the event callback when it cannot hand the event over; once a sensor has an event held its
+  //  next ones must be held too (held(index) is true), so they all reach collect() in order
+  void hold(uint8_t index, SensorEvent event);
+  bool held(uint8_t index) const { return states[index].held != 0; }
+  bool anyHeld() const;
+  // the other side (loop()): the next event held, false when there are none
+  bool collect(SensorMessage &message);
+
+  // leak sensors only, restore after begin(): a sensor still wet does not start the alarms over
+  LeakAlarms leakAlarms(uint8_t index) const;
+  void restoreLeakAlarms(uint8_t index, const LeakAlarms &alarms);
+
+  // called by the interrupt handler of a sensor
+  static void interrupt(uint8_t index);
+
+private:
+  unsigned long processLeak(uint8_t index, unsigned long now);
+  unsigned long processDht(uint8_t index, unsigned long now);
+  void checkLeak(uint8_t index, unsigned long now);
+
+  static SensorRegistry *instance;
+
+  const SensorDescriptor *sensors;
+  SensorState *states;
+  uint8_t sensorCount;
+  EventCallback eventCallback;
+  EdgeCallback edgeCallback;
+  volatile bool edgeSeen;
+  bool scheduled;
+  unsigned long nextDue;
+};
@@ -0,0 +1,146 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "sensorTrace.h"
+#include "fixedFormat.h"
+
+#include <string.h>
+
+namespace
+{
+
+// appends " <value>", times go over what fixedFormat() takes
+size_t appendNumber(char *line, size_t size, uint32_t value)
+{
+  char number[12];
+  char *digit = number + sizeof(number) - 1;
+  *digit = 0;
+  do
+  {
+    *--digit = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  *--digit = ' ';
+  return fixedAppend(line, size, digit);
+}
+
+size_t appendSigned(char *line, size_t size, int32_t value)
+{
+  char number[12] = " ";
+  fixedFormat(number + 1, sizeof(number) - 1, value, 0);
+  return fixedAppend(line, size, number);
+}
+
+} // namespace
+
+SensorTrace::SensorTrace() : lastMicros(0), started(false) {}
+
+// several producers (interrupts, the timer thread) share the ring, so pushes are serialized
+void SensorTrace::add(const Record &record)
+{
+  ATOMIC_BLOCK()
+  {
+    records.push(record);
+  }
+}
+
+void SensorTrace::digital(uint32_t micros, uint8_t pin, uint8_t level)
+{
+  add({micros, TRACE_DIGITAL, pin, level, 0});
+}
+
+void SensorTrace::analog(uint32_t micros, uint8_t pin, uint16_t value)
+{
+  add({micros, TRACE_ANALOG, pin, (int16_t)value, 0});
+}
+
+void SensorTrace::dht(uint32_t micros, int16_t celsius, int16_t humidity)
+{
+  add({micros, TRACE_DHT, 0, celsius, humidity});
+}
+
+void SensorTrace::dhtError(uint32_t micros, int16_t status)
+{
+  add({micros, TRACE_DHT_ERROR, 0, status, 0});
+}
+
+void SensorTrace::cloud(uint32_t micros, bool connected)
+{
+  add({micros, TRACE_CLOUD, 0, connected, 0});
+}
+
+/*******************************************************************************
+ * Function Name  : header
+ * Description    : first line of a trace, epoch is the unix time when micros() was 0
+ * Return         : the length of the line
+ *******************************************************************************/
+size_t SensorTrace::header(char *line, size_t size, uint32_t epoch)
+{
+  line[0] = 0;
+  fixedAppend(line, size, "homeCommander-trace");
+  appendNumber(line, size, SENSOR_TRACE_VERSION);
+  return appendNumber(line, size, epoch);
+}
+
+// "<dt> <kind>", dt from the previous line (the first one counts from micros() = 0)
+size_t SensorTrace::start(char *line, size_t size, uint32_t micros, char kind)
+{
+  uint32_t elapsed = started ? micros - lastMicros : micros;
+  started = true;
+  lastMicros = micros;
+
+  line[0] = 0;
+  // skip the space appendNumber() puts first
+  appendNumber(line, size, elapsed);
+  memmove(line, line + 1, strlen(line));
+  char tail[3] = {' ', kind, 0};
+  return fixedAppend(line, size, tail);
+}
+
+/*******************************************************************************
+ * Function Name  : nextLine
+ * Description    : formats the oldest queued record
+ * Return         : the length of the line, 0 if nothing was queued
+ *******************************************************************************/
+size_t SensorTrace::nextLine(char *line, size_t size)
+{
+  Record record;
+  if (not records.pop(record))
+  {
+    return 0;
+  }
+
+  start(line, size, record.micros, record.kind);
+  if (record.kind == TRACE_DIGITAL or record.kind == TRACE_ANALOG)
+  {
+    appendNumber(line, size, record.pin);
+  }
+  size_t length = appendSigned(line, size, record.first);
+  if (record.kind == TRACE_DHT)
+  {
+    length = appendSigned(line, size, record.second);
+  }
+  return length;
+}
+
+// "<dt> <kind> <name>\t<text>", names can have spaces but no tabs
+size_t SensorTrace::textLine(char *line, size_t size, uint32_t micros, char kind, const char *name, const char *text)
+{
+  start(line, size, micros, kind);
+  fixedAppend(line, size, " ");
+  fixedAppend(line, size, name);
+  fixedAppend(line, size, "\t");
+  return fixedAppend(line, size, text);
+}
+
+size_t SensorTrace::callLine(char *line, size_t size, uint32_t micros, const char *name, const char *argument)
+{
+  return textLine(line, size, micros, TRACE_CALL, name, argument);
+}
+
+size_t SensorTrace::publishLine(char *line, size_t size, uint32_t micros, const char *name, const char *data)
+{
+  return textLine(line, size, micros, TRACE_PUBLISH, name, data);
+}
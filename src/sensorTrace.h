@@ -0,0 +1,84 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Recorder of everything the firmware reads from its sensors, so a day (or a week) of the house
+//   can be replayed on the host by host/traceReplay and compared publish by publish.
+//  Records are queued from any context (interrupts, timer thread, loop()) and turned into text
+//   lines from loop(), one per record:
+//    homeCommander-trace 1 <unix time at micros() = 0>      header
+//    <dt> d <pin> <level>          digital level change
+//    <dt> a <pin> <value>          one analogRead()
+//    <dt> h <celsius> <humidity>   one DHT22 acquisition, hundredths
+//    <dt> e <status>               one DHT22 acquisition that failed (PietteTech_DHT status)
+//    <dt> c <0|1>                  the cloud connection went down/up
+//    <dt> f <name>\t<argument>     a cloud function was called
+//    <dt> p <name>\t<data>         what was published
+//  dt is the micros() elapsed since the previous line, so times wrap fine as long as there is a line
+//   at least every 71 minutes (the pool thermistor alone gives ten per second, a burst every minute
+//   with LOW_POWER).
+
+#pragma once
+
+#include "Particle.h"
+#include "spscRing.h"
+
+#define SENSOR_TRACE_VERSION 1
+// records queued between two loop() passes: a whole burst of the pool sampler (LOW_POWER) fits, 3 KB
+#define SENSOR_TRACE_SIZE 256
+// a publish line: time, name and data of the biggest event
+#define SENSOR_TRACE_LINE_MAX 720
+
+enum SensorTraceKind : char
+{
+  TRACE_DIGITAL = 'd',
+  TRACE_ANALOG = 'a',
+  TRACE_DHT = 'h',
+  TRACE_DHT_ERROR = 'e',
+  TRACE_CLOUD = 'c',
+  TRACE_CALL = 'f',
+  TRACE_PUBLISH = 'p',
+};
+
+class SensorTrace
+{
+public:
+  SensorTrace();
+
+  // any context, pass micros()
+  void digital(uint32_t micros, uint8_t pin, uint8_t level);
+  void analog(uint32_t micros, uint8_t pin, uint16_t value);
+  void dht(uint32_t micros, int16_t celsius, int16_t humidity);
+  void dhtError(uint32_t micros, int16_t status);
+  void cloud(uint32_t micros, bool connected);
+
+  // loop() side
+  size_t header(char *line, size_t size, uint32_t epoch);
+  // the oldest queued record, 0 when there is none
+  size_t nextLine(char *line, size_t size);
+  // cloud function calls and publishes go straight to a line, write the queued records before them
+  size_t callLine(char *line, size_t size, uint32_t micros, const char *name, const char *argument);
+  size_t publishLine(char *line, size_t size, uint32_t micros, const char *name, const char *data);
+
+  // records lost because loop() did not write them out fast enough
+  uint32_t dropped() const { return records.dropped(); }
+
+private:
+  struct Record
+  {
+    uint32_t micros;
+    char kind;
+    uint8_t pin;
+    int16_t first;
+    int16_t second;
+  };
+
+  void add(const Record &record);
+  size_t start(char *line, size_t size, uint32_t micros, char kind);
+  size_t textLine(char *line, size_t size, uint32_t micros, char kind, const char *name, const char *text);
+
+  SpscRing<Record, SENSOR_TRACE_SIZE> records;
+  uint32_t lastMicros;
+  bool started;
+};
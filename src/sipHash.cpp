@@ -0,0 +1,85 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+
+#include "sipHash.h"
+
+namespace
+{
+
+inline uint64_t rotate(uint64_t x, uint8_t bits) { return (x << bits) | (x >> (64 - bits)); }
+
+// little endian, whatever the CPU
+inline uint64_t load64(const uint8_t *p)
+{
+  uint64_t value = 0;
+  for (int8_t i = 7; i >= 0; i--)
+  {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+struct SipState
+{
+  uint64_t v0, v1, v2, v3;
+
+  void round()
+  {
+    v0 += v1;
+    v1 = rotate(v1, 13);
+    v1 ^= v0;
+    v0 = rotate(v0, 32);
+    v2 += v3;
+    v3 = rotate(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = rotate(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = rotate(v1, 17);
+    v1 ^= v2;
+    v2 = rotate(v2, 32);
+  }
+
+  void compress(uint64_t m)
+  {
+    v3 ^= m;
+    round();
+    round();
+    v0 ^= m;
+  }
+};
+
+} // namespace
+
+uint64_t sipHash24(const uint8_t key[SIP_HASH_KEY_SIZE], const void *data, size_t length)
+{
+  const uint8_t *bytes = (const uint8_t *)data;
+  uint64_t k0 = load64(key);
+  uint64_t k1 = load64(key + 8);
+  SipState state = {k0 ^ 0x736f6d6570736575ULL, k1 ^ 0x646f72616e646f6dULL,
+                    k0 ^ 0x6c7967656e657261ULL, k1 ^ 0x7465646279746573ULL};
+
+  size_t whole = length - length % 8;
+  for (size_t i = 0; i < whole; i += 8)
+  {
+    state.compress(load64(bytes + i));
+  }
+
+  // the last 0 to 7 bytes, with the length in the top byte
+  uint64_t last = (uint64_t)(length & 0xff) << 56;
+  for (size_t i = whole; i < length; i++)
+  {
+    last |= (uint64_t)bytes[i] << (8 * (i - whole));
+  }
+  state.compress(last);
+
+  state.v2 ^= 0xff;
+  for (uint8_t i = 0; i < 4; i++)
+  {
+    state.round();
+  }
+  return state.v0 ^ state.v1 ^ state.v2 ^ state.v3;
+}
@@ -0,0 +1,21 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  SipHash-2-4 (Aumasson and Bernstein): a keyed hash of short messages, used as the authentication code
+//   of the LAN control requests. 128 bit key, 64 bit result, a few hundred cycles for a short line.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIP_HASH_KEY_SIZE 16
+
+/*******************************************************************************
+ * Function Name  : sipHash24
+ * Description    : SipHash-2-4 of length bytes of data with the 16 byte key
+ * Return         : the 64 bit hash
+ *******************************************************************************/
+uint64_t sipHash24(const uint8_t key[SIP_HASH_KEY_SIZE], const void *data, size_t length);
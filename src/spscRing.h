@@ -0,0 +1,73 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  Lock-free single-producer/single-consumer ring buffer.
+//  One side (an interrupt handler or a thread) only calls push(), the other (loop()) only
+//   calls pop()/peek(), so no interrupts need to be disabled and nothing ever blocks.
+//  SIZE must be a power of two, one slot is kept empty to tell full from empty.
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+template <typename T, uint16_t SIZE>
+class SpscRing
+{
+  static_assert(SIZE >= 2 and (SIZE & (SIZE - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  SpscRing() : head(0), tail(0), overflows(0) {}
+
+  // producer side
+  bool push(const T &item)
+  {
+    uint16_t h = head.load(std::memory_order_relaxed);
+    uint16_t next = (h + 1) & (SIZE - 1);
+    if (next == tail.load(std::memory_order_acquire))
+    {
+      overflows.store(overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    items[h] = item;
+    head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side
+  bool pop(T &item)
+  {
+    if (not peek(item))
+    {
+      return false;
+    }
+    tail.store((tail.load(std::memory_order_relaxed) + 1) & (SIZE - 1), std::memory_order_release);
+    return true;
+  }
+
+  bool peek(T &item) const
+  {
+    uint16_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+    item = items[t];
+    return true;
+  }
+
+  bool empty() const { return tail.load(std::memory_order_relaxed) == head.load(std::memory_order_acquire); }
+  uint16_t size() const { return (head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed)) & (SIZE - 1); }
+  static uint16_t capacity() { return SIZE - 1; }
+
+  // number of items refused because the ring was full, written by the producer only
+  uint32_t dropped() const { return overflows.load(std::memory_order_relaxed); }
+
+private:
+  T items[SIZE];
+  std::atomic<uint16_t> head;
+  std::atomic<uint16_t> tail;
+  std::atomic<uint32_t> overflows;
+};
@@ -0,0 +1,141 @@
+// The MIT License (MIT)
+// Copyright (c) 2016 Gustavo Gonnet
+//
+//  github: https://github.com/gusgonnet/homeCommander
+//
+//  ADC reading to temperature for an NTC thermistor in a voltage divider, without floating point.
+//  The beta (simplified Steinhart-Hart) formula is evaluated by the compiler into a table with one
+//   entry every THERMISTOR_TABLE_STEP ADC counts, readings in between are linearly interpolated.
+//  The table is built for one output unit, so there is no Fahrenheit conversion at runtime.
+//  Temperatures are in hundredths of a degree and clamped to the range of the usual NTC parts,
+//   -55 to 150 degrees Celsius.
+//
+//  Wiring (same as the adafruit thermistor tutorial): 3V3 - SERIES_OHMS - ADC pin - thermistor - GND
+
+#pragma once
+
+#include <stdint.h>
+
+#define THERMISTOR_ADC_MAX 4095
+#define THERMISTOR_TABLE_SHIFT 4
+#define THERMISTOR_TABLE_STEP (1 << THERMISTOR_TABLE_SHIFT)
+#define THERMISTOR_TABLE_ENTRIES ((THERMISTOR_ADC_MAX + 1) / THERMISTOR_TABLE_STEP + 1)
+#define THERMISTOR_MIN_CELSIUS -55.0
+#define THERMISTOR_MAX_CELSIUS 150.0
+
+enum class TemperatureUnit
+{
+  CELSIUS,
+  FAHRENHEIT,
+};
+
+namespace thermistor_detail
+{
+
+// natural logarithm the compiler can evaluate: x = m * 2^k with m in [1, 2),
+//  then ln(m) = 2 * atanh((m - 1) / (m + 1)), which converges fast for that range
+constexpr double ln(double x)
+{
+  const double LN2 = 0.69314718055994530942;
+  int k = 0;
+  while (x >= 2.0)
+  {
+    x /= 2.0;
+    k++;
+  }
+  while (x < 1.0)
+  {
+    x *= 2.0;
+    k--;
+  }
+  double z = (x - 1.0) / (x + 1.0);
+  double z2 = z * z;
+  double term = z;
+  double sum = 0.0;
+  for (int n = 1; n < 40; n += 2)
+  {
+    sum += term / n;
+    term *= z2;
+  }
+  return 2.0 * sum + k * LN2;
+}
+
+// the exact temperature for an ADC reading (fractions allowed), this is what the table holds
+template <TemperatureUnit UNIT, long NOMINAL_OHMS, int NOMINAL_CELSIUS, int BETA, long SERIES_OHMS>
+constexpr double degrees(double adc)
+{
+  double celsius = THERMISTOR_MAX_CELSIUS;
+  if (adc >= THERMISTOR_ADC_MAX)
+  {
+    celsius = THERMISTOR_MIN_CELSIUS;
+  }
+  else if (adc > 0)
+  {
+    double ohms = (double)SERIES_OHMS * adc / (THERMISTOR_ADC_MAX - adc);
+    double inverseKelvin = ln(ohms / NOMINAL_OHMS) / BETA + 1.0 / (NOMINAL_CELSIUS + 273.15);
+    // beyond the hot end the formula wraps around, keep it at the maximum
+    if (inverseKelvin > 0)
+    {
+      celsius = 1.0 / inverseKelvin - 273.15;
+    }
+  }
+  if (celsius < THERMISTOR_MIN_CELSIUS)
+  {
+    celsius = THERMISTOR_MIN_CELSIUS;
+  }
+  if (celsius > THERMISTOR_MAX_CELSIUS)
+  {
+    celsius = THERMISTOR_MAX_CELSIUS;
+  }
+  return UNIT == TemperatureUnit::FAHRENHEIT ? celsius * 9.0 / 5.0 + 32.0 : celsius;
+}
+
+template <TemperatureUnit UNIT, long NOMINAL_OHMS, int NOMINAL_CELSIUS, int BETA, long SERIES_OHMS>
+struct Table
+{
+  int16_t entries[THERMISTOR_TABLE_ENTRIES];
+
+  constexpr Table() : entries()
+  {
+    for (int i = 0; i < THERMISTOR_TABLE_ENTRIES; i++)
+    {
+      double value = degrees<UNIT, NOMINAL_OHMS, NOMINAL_CELSIUS, BETA, SERIES_OHMS>(i * THERMISTOR_TABLE_STEP) * 100.0;
+      entries[i] = (int16_t)(value + (value >= 0 ? 0.5 : -0.5));
+    }
+  }
+};
+
+} // namespace thermistor_detail
+
+template <TemperatureUnit UNIT, long NOMINAL_OHMS, int NOMINAL_CELSIUS, int BETA, long SERIES_OHMS>
+class ThermistorTable
+{
+public:
+  static constexpr double degrees(double adc)
+  {
+    return thermistor_detail::degrees<UNIT, NOMINAL_OHMS, NOMINAL_CELSIUS, BETA, SERIES_OHMS>(adc);
+  }
+
+  // temperature in hundredths of a degree for a 12 bit ADC reading
+  static int16_t centi(uint16_t adc)
+  {
+    if (adc > THERMISTOR_ADC_MAX)
+    {
+      adc = THERMISTOR_ADC_MAX;
+    }
+    uint16_t index = adc >> THERMISTOR_TABLE_SHIFT;
+    int32_t fraction = adc & (THERMISTOR_TABLE_STEP - 1);
+    int32_t low = table.entries[index];
+    int32_t high = table.entries[index + 1];
+    return low + (high - low) * fraction / THERMISTOR_TABLE_STEP;
+  }
+
+  static constexpr const char *symbol() { return UNIT == TemperatureUnit::FAHRENHEIT ? "°F" : "°C"; }
+
+private:
+  static constexpr thermistor_detail::Table<UNIT, NOMINAL_OHMS, NOMINAL_CELSIUS, BETA, SERIES_OHMS> table{};
+};
+
+// needed before C++17, where static constexpr members are not implicitly inline
+template <TemperatureUnit UNIT, long NOMINAL_OHMS, int NOMINAL_CELSIUS, int BETA, long SERIES_OHMS>
+constexpr thermistor_detail::Table<UNIT, NOMINAL_OHMS, NOMINAL_CELSIUS, BETA, SERIES_OHMS> ThermistorTable<UNIT, NOMINAL_OHMS, NOMINAL_CELSIUS, BETA, SERIES_OHMS>::table;